@@ -75,4 +75,21 @@ extern void BackupChannelBmi160PrintGyro(struct bmi160_gyro_t * gyroData);
  */
 extern void BackupChannelBmi160PrintMag(struct bmi160_mag_t * magData);
 
+/*
+ * Sends one kernel trace record to back channel UART
+ * Param 'timestamp': Cycle counter when the event happened
+ * Param 'thread': Thread slot the event happened on
+ * Param 'type': Kind of event
+ * Param 'arg': Event argument
+ */
+extern void BackChannelPrintTraceRecord(uint32_t timestamp, uint8_t thread, uint8_t type, uint32_t arg);
+
+/*
+ * Sends the name of a thread slot in a kernel trace to back channel UART
+ * Param 'thread': Thread slot
+ * Param 'name': Thread name, does not need to be null-terminated
+ * Param 'length': Number of characters in name
+ */
+extern void BackChannelPrintTraceThread(uint8_t thread, const char * name, uint32_t length);
+
 #endif /* BACKCHANNELUART_H_ */
@@ -181,6 +181,31 @@ void BackupChannelBmi160PrintMag(struct bmi160_mag_t * magData)
 	BackChannelTransmitString(backChannelStringBuff);
 }
 
+/*
+ * Sends one kernel trace record to back channel UART
+ * Param 'timestamp': Cycle counter when the event happened
+ * Param 'thread': Thread slot the event happened on
+ * Param 'type': Kind of event
+ * Param 'arg': Event argument
+ */
+void BackChannelPrintTraceRecord(uint32_t timestamp, uint8_t thread, uint8_t type, uint32_t arg)
+{
+	snprintf(backChannelStringBuff, SBUFF_SIZE, "{ \"trace\" : [ %u, %u, %u, %u ] }\r\n", timestamp, thread, type, arg);
+	BackChannelTransmitString(backChannelStringBuff);
+}
+
+/*
+ * Sends the name of a thread slot in a kernel trace to back channel UART
+ * Param 'thread': Thread slot
+ * Param 'name': Thread name, does not need to be null-terminated
+ * Param 'length': Number of characters in name
+ */
+void BackChannelPrintTraceThread(uint8_t thread, const char * name, uint32_t length)
+{
+	snprintf(backChannelStringBuff, SBUFF_SIZE, "{ \"trace_thread\" : { \"id\" : %u, \"name\" : \"%.*s\" } }\r\n", thread, (int)length, name);
+	BackChannelTransmitString(backChannelStringBuff);
+}
+
 /******************************************* Public Functions ****************************/
 
 
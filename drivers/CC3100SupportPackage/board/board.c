@@ -37,6 +37,7 @@
 #include "simplelink.h"
 #include "board.h"
 #include "driverlib.h"
+#include "G8RTOS_Deferred.h"
 
 #define XT1_XT2_PORT_SEL0            PJSEL0
 #define XT1_XT2_PORT_SEL1            PJSEL1
@@ -46,6 +47,18 @@
 
 P_EVENT_HANDLER                pIraEventHandler = 0;
 
+/*
+ * Bottom half of the CC3100 host interrupt. Runs the SimpleLink
+ * interrupt handler on the G8RTOS deferred work thread.
+ */
+static void CC3100IrqDeferred(uint32_t arg)
+{
+    if (pIraEventHandler)
+    {
+        pIraEventHandler(0);
+    }
+}
+
 unsigned char IntIsMasked;
 
 
@@ -338,13 +351,20 @@ void Delay(unsigned long interval)
 //__interrupt
 void PORT2_IRQHandler(void)
 {
+    uint32_t start = G8RTOS_CYCLES();
+    TRACE_ISR_ENTER();
+
     if (P2IFG & BIT5)
     {
 
 #ifndef SL_IF_TYPE_UART
         if (pIraEventHandler)
         {
-            pIraEventHandler(0);
+            // run it here only if the kernel can't take it yet
+            if (G8RTOS_DeferWork(&CC3100IrqDeferred, 0) != 0)
+            {
+                pIraEventHandler(0);
+            }
         }
 #else
         if(puartFlowctrl->bRtsSetByFlowControl == FALSE)
@@ -355,6 +375,9 @@ void PORT2_IRQHandler(void)
 #endif
         P2IFG &= ~ BIT5;
     }
+
+    TRACE_ISR_EXIT();
+    G8RTOS_RecordIsrCycles(start);
 }
 
 /*!
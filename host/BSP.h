@@ -0,0 +1,52 @@
+/*
+ * BSP.h
+ *
+ * Host board stand-in for the uP2 board support package. The sensors are
+ * left out. The back channel UART prints to stdout, the clock runs at
+ * 1 GHz so G8RTOS_CYCLES (ns on the host) reads like cycles, and the
+ * joystick and buttons are scripted.
+ */
+
+#ifndef BSP_H_
+#define BSP_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include "msp.h"
+#include "BackChannelUart.h"
+
+/********************************** Public Functions **************************************/
+
+/* Initializes the entire board */
+extern void BSP_InitBoard();
+
+/* Clock */
+extern void ClockSys_SetMaxFreq();
+extern uint32_t ClockSys_GetSysFreq();
+
+/* Joystick */
+void Joystick_Init_Without_Interrupt();
+void GetJoystickCoordinates(int16_t *x_coord, int16_t *y_coord);
+
+/* LP3943 RGB LEDs, only their last setting is kept */
+typedef enum
+{
+    RED,    // 0x0
+    GREEN,  // 0x1
+    BLUE    // 0x2
+} rgb_t;
+
+void setLedPwm_lp3943( rgb_t rgb_unit, uint8_t led_pwm );
+void setLedMode_lp3943( rgb_t rgb_unit, uint16_t led_mode);
+void config_pwm_lp3943( void );
+
+/*
+ * Called by the host port every ms, before launch too. Raises the button
+ * presses G8RTOS_HOST_PRESS scheduled for this ms.
+ * Param "ms": ms since launch, 0 before it
+ */
+void HostBoard_Tick(uint32_t ms);
+
+/********************************** Public Functions **************************************/
+
+#endif /* BSP_H_ */
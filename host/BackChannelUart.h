@@ -0,0 +1,55 @@
+/*
+ * BackChannelUart.h
+ *
+ * Host board stand-in for the back channel UART. Lines are written to
+ * stdout in the same JSON format, so the tools that read UART logs read
+ * host runs too.
+ */
+
+#ifndef BACKCHANNELUART_H_
+#define BACKCHANNELUART_H_
+
+#include <stdint.h>
+
+typedef enum
+{
+	BackChannel_Info,
+	BackChannel_Warning,
+	BackChannel_Error
+} BackChannelTextStyle_t;
+
+/* Initializes back channel UART */
+extern void BackChannelInit();
+
+/*
+ * Prints string to the back channel UART
+ * Param 'string': String to be displayed
+ * Param 'textStyle': Style of the the text to be written
+ */
+extern void BackChannelPrint(const char * string, BackChannelTextStyle_t textStyle);
+
+/*
+ * Prints the value of an integer to the back channel UART
+ * Param 'name': Name of the integer variable
+ * Param 'value': Value of integer variable
+ */
+extern void BackChannelPrintIntVariable(const char * name, int32_t value);
+
+/*
+ * Sends one kernel trace record to back channel UART
+ * Param 'timestamp': Cycle counter when the event happened
+ * Param 'thread': Thread slot the event happened on
+ * Param 'type': Kind of event
+ * Param 'arg': Event argument
+ */
+extern void BackChannelPrintTraceRecord(uint32_t timestamp, uint8_t thread, uint8_t type, uint32_t arg);
+
+/*
+ * Sends the name of a thread slot in a kernel trace to back channel UART
+ * Param 'thread': Thread slot
+ * Param 'name': Thread name, does not need to be null-terminated
+ * Param 'length': Number of characters in name
+ */
+extern void BackChannelPrintTraceThread(uint8_t thread, const char * name, uint32_t length);
+
+#endif /* BACKCHANNELUART_H_ */
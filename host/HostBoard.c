@@ -0,0 +1,208 @@
+/*
+ * HostBoard.c
+ *
+ * Host board: GPIO ports, clock, joystick, scripted buttons and the
+ * back channel UART on stdout.
+ *
+ * G8RTOS_HOST_PRESS lists button presses as <button>@<ms>, separated by
+ * commas, e.g. "B0@0,B0@20000". B0 and B1 are P4.4 and P4.5, B2 and B3
+ * are P5.4 and P5.5, like on the daughter board. The ms counts from
+ * launch. Presses at 0 happen before launch, which is where the main
+ * menu waits for B0 (host) or B2 (client).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "BSP.h"
+#include "G8RTOS_CriticalSection.h"
+
+/*********************************************** Sizes and Limits *********************************************************************/
+#define MAX_PRESSES         32
+#define JOYSTICK_SWEEP_MS   4000    // one full left-right-left sweep of the scripted joystick
+#define JOYSTICK_MAX        8000
+/*********************************************** Sizes and Limits *********************************************************************/
+
+
+/*********************************************** Data Structures Used *****************************************************************/
+
+DIO_PORT_Interruptable_Type HostPorts[6];
+WDT_A_Type HostWatchdog;
+
+typedef struct
+{
+    uint8_t button;     // 0-3
+    uint32_t ms;
+    bool done;
+} press_t;
+
+static press_t Presses[MAX_PRESSES];
+static uint32_t NumberOfPresses;
+static uint32_t JoystickReads;
+static uint16_t LedMode[3];
+static uint8_t LedPwm[3];
+
+/*********************************************** Data Structures Used *****************************************************************/
+
+
+/*********************************************** Private Functions ********************************************************************/
+
+/*
+ * Reads G8RTOS_HOST_PRESS
+ */
+static void ReadPresses(void)
+{
+    const char *list = getenv("G8RTOS_HOST_PRESS");
+    unsigned button, ms;
+    int used;
+
+    while ( list != 0 && NumberOfPresses < MAX_PRESSES
+            && sscanf(list, " B%u@%u%n", &button, &ms, &used) == 2 )
+    {
+        if ( button < 4 )
+        {
+            Presses[NumberOfPresses].button = button;
+            Presses[NumberOfPresses].ms = ms;
+            Presses[NumberOfPresses].done = false;
+            NumberOfPresses++;
+        }
+
+        list += used;
+        if ( *list != ',' )
+            break;
+        list++;
+    }
+}
+
+/*
+ * Raises the port interrupt of a button like a high-to-low edge would
+ */
+static void PressButton(uint8_t button)
+{
+    DIO_PORT_Interruptable_Type *port = (button < 2) ? P4 : P5;
+    uint8_t pin = (button & 1) ? BIT5 : BIT4;
+
+    if ( port->IE & pin )
+    {
+        port->IFG |= pin;
+        NVIC_SetPendingIRQ( (button < 2) ? PORT4_IRQn : PORT5_IRQn );
+    }
+}
+
+/*********************************************** Private Functions ********************************************************************/
+
+
+/*********************************************** Public Functions *********************************************************************/
+
+void BSP_InitBoard()
+{
+    memset(HostPorts, 0, sizeof(HostPorts));
+    NumberOfPresses = 0;
+    JoystickReads = 0;
+    ReadPresses();
+}
+
+void ClockSys_SetMaxFreq()
+{
+}
+
+/*
+ * 1 GHz, so the ns the host counts read as cycles
+ */
+uint32_t ClockSys_GetSysFreq()
+{
+    return 1000000000;
+}
+
+void Joystick_Init_Without_Interrupt()
+{
+}
+
+/*
+ * Sweeps x back and forth, the same way on every run
+ */
+void GetJoystickCoordinates(int16_t *x_coord, int16_t *y_coord)
+{
+    uint32_t phase = (JoystickReads++ * 16) % JOYSTICK_SWEEP_MS;
+    int32_t x = (phase < JOYSTICK_SWEEP_MS / 2) ? (int32_t)phase : (int32_t)(JOYSTICK_SWEEP_MS - phase);
+
+    *x_coord = (int16_t)((x - JOYSTICK_SWEEP_MS / 4) * (2 * JOYSTICK_MAX) / (JOYSTICK_SWEEP_MS / 2));
+    *y_coord = 0;
+}
+
+void setLedPwm_lp3943( rgb_t rgb_unit, uint8_t led_pwm )
+{
+    LedPwm[rgb_unit] = led_pwm;
+}
+
+void setLedMode_lp3943( rgb_t rgb_unit, uint16_t led_mode)
+{
+    LedMode[rgb_unit] = led_mode;
+}
+
+void config_pwm_lp3943( void )
+{
+    memset(LedMode, 0, sizeof(LedMode));
+    memset(LedPwm, 0, sizeof(LedPwm));
+}
+
+void HostBoard_Tick(uint32_t ms)
+{
+    for (uint32_t i = 0; i < NumberOfPresses; i++)
+    {
+        if ( !Presses[i].done && Presses[i].ms <= ms )
+        {
+            // the button is ignored until its interrupt is enabled, like on the board
+            if ( (Presses[i].button < 2 ? P4 : P5)->IE == 0 )
+                continue;
+
+            Presses[i].done = true;
+            PressButton(Presses[i].button);
+        }
+    }
+}
+
+/*
+ * Back channel UART. Lines are printed whole, so a thread switch in the
+ * middle of one can't mix two lines.
+ */
+void BackChannelInit()
+{
+}
+
+void BackChannelPrint(const char * string, BackChannelTextStyle_t textStyle)
+{
+    const char *topic = "info";
+
+    if ( textStyle == BackChannel_Warning )
+        topic = "warning";
+    else if ( textStyle == BackChannel_Error )
+        topic = "error";
+
+    int32_t primask = StartCriticalSection();
+    printf("{ \"%s\" : \"%s\" }\r\n", topic, string);
+    EndCriticalSection(primask);
+}
+
+void BackChannelPrintIntVariable(const char * name, int32_t value)
+{
+    int32_t primask = StartCriticalSection();
+    printf("{ \"variable\" : { \"name\" : \"%s\", \"value\" : %d } }\r\n", name, value);
+    EndCriticalSection(primask);
+}
+
+void BackChannelPrintTraceRecord(uint32_t timestamp, uint8_t thread, uint8_t type, uint32_t arg)
+{
+    int32_t primask = StartCriticalSection();
+    printf("{ \"trace\" : [ %u, %u, %u, %u ] }\r\n", timestamp, thread, type, arg);
+    EndCriticalSection(primask);
+}
+
+void BackChannelPrintTraceThread(uint8_t thread, const char * name, uint32_t length)
+{
+    int32_t primask = StartCriticalSection();
+    printf("{ \"trace_thread\" : { \"id\" : %u, \"name\" : \"%.*s\" } }\r\n", thread, (int)length, name);
+    EndCriticalSection(primask);
+}
+
+/*********************************************** Public Functions *********************************************************************/
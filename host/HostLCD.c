@@ -0,0 +1,70 @@
+/*
+ * HostLCD.c
+ *
+ * Host board LCD. Drawing goes into a frame buffer in memory so the
+ * game does the same work it does on the board, and text is also
+ * printed to the back channel so a run can be followed.
+ */
+
+#include <string.h>
+#include "BSP.h"
+#include "LCD_empty.h"
+
+/*********************************************** Data Structures Used *****************************************************************/
+
+static uint16_t FrameBuffer[MAX_SCREEN_Y][MAX_SCREEN_X];
+
+/*********************************************** Data Structures Used *****************************************************************/
+
+
+/*********************************************** Public Functions *********************************************************************/
+
+void LCD_Init(bool usingTP)
+{
+    (void)usingTP;
+    LCD_Clear(LCD_BLACK);
+}
+
+void LCD_Clear(uint16_t Color)
+{
+    for (int y = 0; y < MAX_SCREEN_Y; y++)
+        for (int x = 0; x < MAX_SCREEN_X; x++)
+            FrameBuffer[y][x] = Color;
+}
+
+void LCD_SetPoint(uint16_t Xpos, uint16_t Ypos, uint16_t color)
+{
+    if ( Xpos < MAX_SCREEN_X && Ypos < MAX_SCREEN_Y )
+        FrameBuffer[Ypos][Xpos] = color;
+}
+
+uint16_t LCD_ReadPixelColor( uint16_t x, uint16_t y )
+{
+    if ( x < MAX_SCREEN_X && y < MAX_SCREEN_Y )
+        return FrameBuffer[y][x];
+    return 0;
+}
+
+void LCD_DrawRectangle(int16_t xStart, int16_t xEnd, int16_t yStart, int16_t yEnd, uint16_t Color)
+{
+    if ( xStart < 0 ) xStart = 0;
+    if ( yStart < 0 ) yStart = 0;
+    if ( xEnd >= MAX_SCREEN_X ) xEnd = MAX_SCREEN_X - 1;
+    if ( yEnd >= MAX_SCREEN_Y ) yEnd = MAX_SCREEN_Y - 1;
+
+    for (int y = yStart; y <= yEnd; y++)
+        for (int x = xStart; x <= xEnd; x++)
+            FrameBuffer[y][x] = Color;
+}
+
+void LCD_Text(uint16_t Xpos, uint16_t Ypos, uint8_t *str, uint16_t Color)
+{
+    (void)Xpos;
+    (void)Ypos;
+
+    // an empty string is how the game erases text
+    if ( Color != LCD_BLACK && str[0] != 0 )
+        BackChannelPrint((const char *)str, BackChannel_Info);
+}
+
+/*********************************************** Public Functions *********************************************************************/
@@ -0,0 +1,82 @@
+/*
+ * HostWifi.c
+ *
+ * Host board WiFi. UDP sockets on the loopback interface stand in for
+ * the CC3100, see cc3100_usage.h.
+ */
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "cc3100_usage.h"
+
+/*********************************************** Data Structures Used *****************************************************************/
+
+static int Socket = -1;
+static _u32 LocalIP;
+
+/*********************************************** Data Structures Used *****************************************************************/
+
+
+/*********************************************** Public Functions *********************************************************************/
+
+/*
+ * Opens the player's socket. Like the CC3100 without an access point,
+ * a failure here stops the program.
+ */
+void initCC3100(playerType playerRole)
+{
+    struct sockaddr_in local;
+
+    LocalIP = (playerRole == Host) ? HOST_IP_ADDR : CLIENT_IP_ADDR;
+
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_port = htons(PORT_NUM);
+    local.sin_addr.s_addr = htonl(LocalIP);
+
+    Socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if ( Socket < 0 || bind(Socket, (struct sockaddr *)&local, sizeof(local)) < 0 )
+    {
+        perror("initCC3100");
+        while(1);
+    }
+
+    fcntl(Socket, F_SETFL, O_NONBLOCK);
+}
+
+/*
+ * Sends one datagram to a player
+ */
+void SendData(_u8 *data, _u32 IP, _u16 BUF_SIZE)
+{
+    struct sockaddr_in remote;
+
+    memset(&remote, 0, sizeof(remote));
+    remote.sin_family = AF_INET;
+    remote.sin_port = htons(PORT_NUM);
+    remote.sin_addr.s_addr = htonl(IP);
+
+    sendto(Socket, data, BUF_SIZE, 0, (struct sockaddr *)&remote, sizeof(remote));
+}
+
+/*
+ * Reads one datagram without waiting
+ * Returns: bytes read, NOTHING_RECEIVED if none was waiting
+ */
+_i32 ReceiveData(_u8 *data, _u16 BUF_SIZE)
+{
+    ssize_t read = recv(Socket, data, BUF_SIZE, 0);
+    return (read < 0) ? NOTHING_RECEIVED : (_i32)read;
+}
+
+_u32 getLocalIP()
+{
+    return LocalIP;
+}
+
+/*********************************************** Public Functions *********************************************************************/
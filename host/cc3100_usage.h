@@ -0,0 +1,40 @@
+/*
+ * cc3100_usage.h
+ *
+ * Host board stand-in for the CC3100 WiFi interface. Packets are UDP
+ * datagrams on the loopback interface: the host player is 127.0.0.1 and
+ * the client is 127.0.0.2, both on PORT_NUM. Start the host process
+ * first, then the client, on the same machine.
+ */
+
+#ifndef CC3100_USAGE_H_
+#define CC3100_USAGE_H_
+
+#include <stdint.h>
+
+typedef uint8_t     _u8;
+typedef uint16_t    _u16;
+typedef uint32_t    _u32;
+typedef int8_t      _i8;
+typedef int16_t     _i16;
+typedef int32_t     _i32;
+
+typedef enum
+{
+    Client = 0,
+    Host = 1,
+    None = 2
+}playerType;
+
+#define HOST_IP_ADDR           0x7F000001               // 127.0.0.1
+#define CLIENT_IP_ADDR         0x7F000002               // 127.0.0.2
+#define PORT_NUM               5001                     // Port number to be used
+
+#define NOTHING_RECEIVED -1
+
+void SendData(_u8 *data, _u32 IP, _u16 BUF_SIZE);
+_i32 ReceiveData(_u8 *data, _u16 BUF_SIZE);
+void initCC3100(playerType playerRole);
+_u32 getLocalIP();
+
+#endif /* CC3100_USAGE_H_ */
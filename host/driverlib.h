@@ -0,0 +1,13 @@
+/*
+ * driverlib.h
+ *
+ * Host board stand-in for the MSP432 DriverLib. Nothing above the
+ * board support package calls it, so it only pulls in msp.h.
+ */
+
+#ifndef HOST_DRIVERLIB_H_
+#define HOST_DRIVERLIB_H_
+
+#include "msp.h"
+
+#endif /* HOST_DRIVERLIB_H_ */
@@ -0,0 +1,99 @@
+/*
+ * msp.h
+ *
+ * Host board stand-in for the MSP432P401R device header. Only holds the
+ * peripherals the game and kernel touch outside of G8RTOS_HOST guards:
+ * the GPIO ports, the watchdog, the NVIC (implemented in G8RTOS_Host.c)
+ * and the CLZ instruction.
+ */
+
+#ifndef HOST_MSP_H_
+#define HOST_MSP_H_
+
+#include <stdint.h>
+
+/*********************************************** Interrupt Numbers ********************************************************************/
+typedef enum
+{
+    NonMaskableInt_IRQn = -14,
+    HardFault_IRQn      = -13,
+    SVCall_IRQn         = -5,
+    PendSV_IRQn         = -2,
+    SysTick_IRQn        = -1,
+    PSS_IRQn            = 0,
+    FPU_IRQn            = 4,
+    T32_INT1_IRQn       = 25,
+    PORT1_IRQn          = 35,
+    PORT2_IRQn          = 36,
+    PORT3_IRQn          = 37,
+    PORT4_IRQn          = 38,
+    PORT5_IRQn          = 39,
+    PORT6_IRQn          = 40
+} IRQn_Type;
+/*********************************************** Interrupt Numbers ********************************************************************/
+
+
+/*********************************************** Peripherals **************************************************************************/
+#define BIT0    (0x0001)
+#define BIT1    (0x0002)
+#define BIT2    (0x0004)
+#define BIT3    (0x0008)
+#define BIT4    (0x0010)
+#define BIT5    (0x0020)
+#define BIT6    (0x0040)
+#define BIT7    (0x0080)
+
+typedef struct
+{
+    volatile uint8_t IN;
+    volatile uint8_t OUT;
+    volatile uint8_t DIR;
+    volatile uint8_t REN;
+    volatile uint8_t DS;
+    volatile uint8_t SEL0;
+    volatile uint8_t SEL1;
+    volatile uint8_t IES;
+    volatile uint8_t IE;
+    volatile uint8_t IFG;
+} DIO_PORT_Interruptable_Type;
+
+typedef struct
+{
+    volatile uint16_t CTL;
+} WDT_A_Type;
+
+#define WDT_A_CTL_PW        0x5A00
+#define WDT_A_CTL_HOLD      0x0080
+
+extern DIO_PORT_Interruptable_Type HostPorts[6];
+extern WDT_A_Type HostWatchdog;
+
+#define P1      (&HostPorts[0])
+#define P2      (&HostPorts[1])
+#define P3      (&HostPorts[2])
+#define P4      (&HostPorts[3])
+#define P5      (&HostPorts[4])
+#define P6      (&HostPorts[5])
+#define WDT_A   (&HostWatchdog)
+/*********************************************** Peripherals **************************************************************************/
+
+
+/*********************************************** NVIC *********************************************************************************/
+void __NVIC_SetVector(IRQn_Type IRQn, uint32_t vector);
+void __NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority);
+void __NVIC_EnableIRQ(IRQn_Type IRQn);
+void __NVIC_DisableIRQ(IRQn_Type IRQn);
+void __NVIC_SetPendingIRQ(IRQn_Type IRQn);
+
+#define NVIC_SetPriority        __NVIC_SetPriority
+#define NVIC_EnableIRQ          __NVIC_EnableIRQ
+#define NVIC_DisableIRQ         __NVIC_DisableIRQ
+#define NVIC_SetPendingIRQ      __NVIC_SetPendingIRQ
+/*********************************************** NVIC *********************************************************************************/
+
+/*********************************************** Core Instructions ********************************************************************/
+/* CMSIS __CLZ: count leading zeros, 32 for 0 like the instruction */
+#define __CLZ(value)            ((value) ? (uint32_t)__builtin_clz(value) : 32)
+/*********************************************** Core Instructions ********************************************************************/
+
+#endif /* HOST_MSP_H_ */
@@ -0,0 +1,152 @@
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+/*
+ * Benchmark.h
+ *
+ * Workloads used to time the kernel on the board. To run one:
+ *  1. Uncomment the BENCH_ directive for it in G8RTOS_Scheduler.h
+ *  2. Change "#define MAIN" to "#define BENCHMARK" at the top of main.c
+ *  3. Open the back channel UART (115200 8N1). Results print once a second.
+ *     Every run also prints IDLE_PERCENT and SUPPRESSED_TICKS (G8RTOS_GetCpuUsage).
+ *
+ * BENCH_SCHEDULER : BENCH_THREADS threads, most of them sleeping or blocked at
+ *                   high priority, plus a few spinning at low priority. Prints the
+ *                   cycles spent picking the next thread. Rebuild with ORIG, OPT
+ *                   and BITMAP selected in G8RTOS_Scheduler.c to compare them.
+ *
+ * BENCH_TICK      : Starts with only the reporter and idle thread, then grows to 8 and BENCH_THREADS
+ *                   threads that sleep 2 - 35 ms. Prints the SysTick_Handler cost for
+ *                   each thread count. Run it without BENCH_SCHEDULER.
+ *
+ * BENCH_MUTEX     : Priority inversion. A low priority thread holds a lock for
+ *                   BENCH_LOCK_HOLD_MS, a medium priority thread wakes up and spins
+ *                   for BENCH_MEDIUM_BUSY_MS, and a high priority thread waits for
+ *                   the lock. Prints the high priority thread's blocking time in
+ *                   cycles. Run once with BENCH_MUTEX_AS_SEMAPHORE (before: the
+ *                   medium thread's spin adds to the max) and once without (after:
+ *                   the max stays near the hold time).
+ *
+ * BENCH_PERIODIC  : BENCH_PERIODIC_EVENTS periodic events with periods of 1 to
+ *                   BENCH_PERIODIC_EVENTS ms. Prints every event's release delay,
+ *                   jitter and handler run time, and the SysTick cost if BENCH_TICK
+ *                   is also on.
+ *
+ * BENCH_IPC       : A producer sends a BENCH_IPC_WORDS word message every ms
+ *                   through FIFO 0 (one writeFIFO per word) and through a ring
+ *                   (one record). A lower priority consumer reads both back.
+ *                   Prints the write and read cycles of each.
+ *
+ * BENCH_DEFERRED  : A thread pends BENCH_DEFERRED_IRQn every ms. Its top half
+ *                   posts a bottom half to the deferred work thread. Prints the
+ *                   max ISR duration, max deferral latency and bottom half run
+ *                   time. Add other workloads to see latency under load.
+ *
+ * BENCH_IRQ_LATENCY: Timer32 1 interrupts every BENCH_IRQ_PERIOD cycles at NVIC
+ *                   priority 0 and never calls the kernel. Its handler reads how
+ *                   long ago the timer hit zero. Churn threads keep adding and
+ *                   killing threads meanwhile. Prints the interrupt latency and
+ *                   whether KERNEL_BASEPRI is on. With PRIMASK the max includes
+ *                   the longest kernel critical section; with BASEPRI it should
+ *                   stay near the exception entry cost.
+ *
+ * BENCH_SWITCH    : Two ping-pong pairs. Each ping stamps the cycle counter and
+ *                   signals a higher priority pong, which records the cycles
+ *                   until it runs. One pair only does integer work, the other
+ *                   does float math on both sides, so PendSV also saves and
+ *                   restores the FPU registers. Prints SWITCH_INT and SWITCH_FPU.
+ *
+ * BENCH_KILL      : A thread fills every free tcb slot with sleepers and blockers,
+ *                   waits BENCH_KILL_PERIOD ms, then kills them all with
+ *                   G8RTOS_KillAllOthers, like the end of a round. Prints how
+ *                   many threads were killed and how long interrupts stayed masked.
+ *                   The reporter is persistent, other workloads' threads are killed,
+ *                   so run it alone.
+ *
+ * BENCH_FAIRNESS  : BENCH_SPINNERS threads spin at BENCH_FAIR_HOG_PRIORITY with a
+ *                   BENCH_FAIR_QUANTUM tick time slice, so nothing below them
+ *                   runs unless aging lets it. Below them, BENCH_FAIR_AGED sleepers
+ *                   have a starvation age of BENCH_FAIR_AGE ticks and one sleeper
+ *                   has none. Prints every low priority thread's worst case wait
+ *                   in ms. With OPT the aged ones should stay under BENCH_FAIR_AGE
+ *                   + MAX_THREADS, the one without aging waits forever.
+ *
+ * On the Linux host port (G8RTOS_HOST, see G8RTOS_Host.h) results are in ns and
+ * print to stdout. BENCH_IRQ_LATENCY needs Timer32 and is board only. With
+ * G8RTOS_HOST_VIRTUAL, BENCH_SCHEDULER and BENCH_FAIRNESS never get past their
+ * spinning threads and busy loops take no time, so run those in real time.
+ */
+
+/*********************************************** Includes ********************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "G8RTOS.h"
+/*********************************************** Includes ********************************************************************/
+
+/*********************************************** Global Defines ********************************************************************/
+
+/* Total number of threads added by a benchmark, including the reporter */
+#define BENCH_THREADS           MAX_THREADS
+
+/* Number of low priority threads that round robin while the others sleep */
+#define BENCH_SPINNERS          2
+
+/* Time between result prints in ms */
+#define BENCH_REPORT_PERIOD     1000
+
+/* Stack size in words of every benchmark thread except the reporter */
+#define BENCH_STACKSIZE         128
+
+/* BENCH_PERIODIC: number of periodic events added */
+#define BENCH_PERIODIC_EVENTS   16
+
+/* Loop count for about 1 ms of CPU time at 48 MHz (see BenchBusy) */
+#define BENCH_LOOPS_PER_MS      4000
+
+/* BENCH_MUTEX: how long the low priority thread holds the lock */
+#define BENCH_LOCK_HOLD_MS      2
+
+/* BENCH_MUTEX: how long the medium priority thread spins every time it wakes */
+#define BENCH_MEDIUM_BUSY_MS    5
+
+/* BENCH_IPC: words per message and ring capacity in bytes (power of two) */
+#define BENCH_IPC_WORDS         4
+#define BENCH_RING_SIZE         256
+
+/* BENCH_DEFERRED: otherwise unused interrupt the benchmark pends in software */
+#define BENCH_DEFERRED_IRQn     PORT6_IRQn
+
+/* BENCH_IRQ_LATENCY: timer period in cycles, prime so it drifts across the tick */
+#define BENCH_IRQ_PERIOD        48017
+#define BENCH_CHURN_THREADS     4       // threads each churn thread adds per ms
+
+#if defined BENCH_IRQ_LATENCY && defined G8RTOS_HOST
+#error "BENCH_IRQ_LATENCY needs Timer32, it can't run on the host port"
+#endif
+
+/* BENCH_KILL: ms the victims get to go to sleep or block before they are killed */
+#define BENCH_KILL_PERIOD       50
+
+/* BENCH_FAIRNESS: priority and time slice of the spinning threads, number of
+ * aged sleepers below them and their starvation age in ticks */
+#define BENCH_FAIR_HOG_PRIORITY 30
+#define BENCH_FAIR_QUANTUM      5
+#define BENCH_FAIR_AGED         3
+#define BENCH_FAIR_AGE          20
+
+/* Uncomment to also print every thread's run time accounting each period */
+// #define BENCH_PRINT_THREADS
+
+/*********************************************** Global Defines ********************************************************************/
+
+/*********************************************** Public Functions *********************************************************************/
+
+/*
+ * Adds the threads for every enabled benchmark. Call between
+ * G8RTOS_Init and G8RTOS_Launch_Priority.
+ */
+void Benchmark_Init(void);
+
+/*********************************************** Public Functions *********************************************************************/
+
+#endif /* BENCHMARK_H_ */
@@ -16,12 +16,13 @@
 /*********************************************** Externs ********************************************************************/
 
 /* Semaphores here */ 
-extern semaphore_t CC3100_SEMAPHORE;
-extern semaphore_t GAMESTATE_SEMAPHORE;
-extern semaphore_t LCDREADY;
-extern semaphore_t LEDREADY;
+extern mutex_t CC3100_SEMAPHORE;
+extern mutex_t GAMESTATE_SEMAPHORE;
+extern mutex_t LCDREADY;
+extern mutex_t LEDREADY;
+extern event_group_t GameEvents;
 
-extern playerType  myPlayerType;    // undefined to avoid launching threads
+extern volatile playerType myPlayerType;    // undefined to avoid launching threads
 extern uint8_t     GameInitMode;    // determines if the buttons are used as game controls or menu navigation
 
 /*********************************************** Externs ********************************************************************/
@@ -30,6 +31,43 @@ extern uint8_t     GameInitMode;    // determines if the buttons are used as gam
 #define MENU_TEXT_COLOR     LCD_YELLOW
 #define MENU_BG_COLOR       LCD_BLACK
 
+/* Run ball lifetimes and end of game processing as jobs on a pool of
+ * worker threads instead of adding and killing a thread for each one */
+#define WORKER_POOL
+
+/* Run the host's game on a fixed timestep simulation thread: paddles, ball
+ * spawns and one physics step for every ball over a structure of arrays
+ * store (Physics.h), instead of a MoveBall thread or job per ball, a
+ * joystick periodic event and GenerateBall. DrawObjects and
+ * SendDataToClient read tick stamped snapshots of the gamestate. */
+#define PHYSICS_ENGINE
+
+/* Uncomment to print the round restart time over the back channel UART.
+ * Build with and without WORKER_POOL to compare. Also uncomment BENCH_KILL
+ * in G8RTOS_Scheduler.h to print how long the kill keeps interrupts masked. */
+// #define BENCH_ROUND_RESTART
+
+/* Uncomment to print the cost of one physics step for every ball count
+ * seen, every PHYSICS_REPORT_STEPS steps (PHYSICS_ENGINE only) */
+// #define BENCH_PHYSICS
+
+/* Balls bounce off each other, for a harder game (PHYSICS_ENGINE only).
+ * Pairs to test come from a uniform grid over the arena, see Physics.h. */
+// #define BALL_COLLISIONS
+
+/* Uncomment to print how many ball pairs the grid tested against all the
+ * pairs there are, for every ball count seen, every PHYSICS_REPORT_STEPS
+ * steps (BALL_COLLISIONS only) */
+// #define BENCH_COLLISIONS
+
+/* Uncomment to fill the arena with BALL_STRESS_COUNT balls, one more every
+ * simulation tick, and print the frame and simulation times every
+ * STRESS_REPORT_FRAMES frames (PHYSICS_ENGINE only). Missed balls don't
+ * score, so the round never ends and the arena stays full. The gamestate no
+ * longer fits one CC3100 datagram at that size, so run it on the host
+ * port (G8RTOS_Host.h). */
+// #define BENCH_BALL_STRESS
+
 /*********************************************** Global Defines ********************************************************************/
 #define RED_ON              P2->OUT |= BIT0
 #define RED_OFF             P2->OUT &= ~BIT0
@@ -39,12 +77,50 @@ extern uint8_t     GameInitMode;    // determines if the buttons are used as gam
 #define BLUE_OFF            P2->OUT &= ~BIT2
 
 #define MAX_NUM_OF_PLAYERS  2
+#ifdef BENCH_BALL_STRESS
+#define MAX_NUM_OF_BALLS    BALL_STRESS_COUNT
+#else
 #define MAX_NUM_OF_BALLS    8
+#endif
+#define BALL_STRESS_COUNT   256
+#define STRESS_REPORT_FRAMES 40 // BENCH_BALL_STRESS: frames between prints, about a second
+
+/* Ball slots are kept in bitmasks, slot 0 in the MSB of word 0 like the
+ * scheduler's ReadyMap. Physics_NextBall walks the set bits. */
+#define BALL_MASK_WORDS     ((MAX_NUM_OF_BALLS + 31) >> 5)
+#define BALL_BIT(i)         (0x80000000 >> ((i) & 31))
 #define BALL_GEN_SLEEP      200 // 10 second increments increasing linearly
+#define PHYSICS_PERIOD      35  // ms between physics steps, MoveBall's old sleep
+#define PHYSICS_REPORT_STEPS 30 // BENCH_PHYSICS: steps between prints, about a second
+
+/* PHYSICS_ENGINE: the simulation runs in SIM_TICK_MS ticks. Paddles and
+ * balls move every few ticks, at the periods the threads used to sleep. */
+#define SIM_TICK_MS         5
+#define PADDLE_STEP_TICKS   (JOYSTICK_PERIOD_HOST / SIM_TICK_MS)
+#define BALL_STEP_TICKS     (PHYSICS_PERIOD / SIM_TICK_MS)
+#define SIM_MAX_CATCHUP     8   // ticks run back to back after a late wake, the rest is dropped
+#define KILL_HOLD_TICKS     10  // ticks a dead ball stays in the kill state so both boards erase it
 
 #define DEFAULT_PRIORITY    15
 #define AGING_PRIORITY      10
 
+/* Thread stack sizes in words. Threads that call into the LCD or CC3100
+ * drivers get the full STACKSIZE. Check stack_used from
+ * G8RTOS_PrintThreadStats before shrinking either one. */
+#define SMALL_STACK         128
+#define LARGE_STACK         STACKSIZE
+
+/* WORKER_POOL: one worker per ball plus one for the end of game job, only
+ * the end of game job with PHYSICS_ENGINE. Workers run at MoveBall's
+ * priority with stacks big enough for the LCD. */
+#ifdef PHYSICS_ENGINE
+#define HOST_WORKERS        1
+#else
+#define HOST_WORKERS        (MAX_NUM_OF_BALLS + 1)
+#endif
+#define CLIENT_WORKERS      1
+#define WORKER_PRIORITY     10
+
 // This game can actually be played with 4 players... a little bit more challenging, but doable! 
 #define NUM_OF_PLAYERS_PLAYING 2
 
@@ -84,12 +160,30 @@ extern uint8_t     GameInitMode;    // determines if the buttons are used as gam
 #define JOYSTICK_BIAS_HOST           720
 #define JOYSTICK_BIAS_CLIENT         350
 
+/* Bytes in the ring carrying client input records to ReadJoystickHost (power of two) */
+#define CLIENT_INPUT_RING_SIZE       128
+
+/* Client: pool buffers for packets from the host. One is being received into,
+ * one is being drawn and the rest can wait in the packet queue. */
+#define PACKET_BUFFERS               4
+
+/* Joystick sampling periods in ms (periodic events) */
+#define JOYSTICK_PERIOD_HOST         15
+#define JOYSTICK_PERIOD_CLIENT       10
+
+/* GameEvents flags */
+#define BUTTON_EVENT                 0x01    // ButtonPress picked the next game state
+
+/* MoveLEDs notification bits */
+#define LED_NOTIFY_SCORE             0x01    // LEDScores changed
+
 /* Value for velocities from contact with paddles */
 #define _1_3_PADDLE                  11
 
-/* Defines for Minkowski Alg. for collision */
-#define WIDTH_TOP_OR_BOTTOM          ((PADDLE_LEN + BALL_SIZE) >> 1) + WIGGLE_ROOM
-#define HEIGHT_TOP_OR_BOTTOM         ((PADDLE_WID + BALL_SIZE) >> 1) + WIGGLE_ROOM
+/* Defines for Minkowski Alg. for collision: half extents of a paddle grown
+ * by a ball, so a ball center inside them touches the paddle */
+#define WIDTH_TOP_OR_BOTTOM          ((PADDLE_LEN + BALL_SIZE) >> 1)
+#define HEIGHT_TOP_OR_BOTTOM         ((PADDLE_WID + BALL_SIZE) >> 1)
 
 /* Edge limitations for ball's center coordinate */
 #define HORIZ_CENTER_MAX_BALL        (ARENA_MAX_X - BALL_SIZE_D2)
@@ -188,11 +282,13 @@ typedef struct
     SpecificPlayerInfo_t player;
     GeneralPlayerInfo_t players[MAX_NUM_OF_PLAYERS];
     Ball_t balls[MAX_NUM_OF_BALLS];
+    uint32_t ballMask[BALL_MASK_WORDS]; // slots DrawObjects looks at, every slot without PHYSICS_ENGINE
     uint16_t numberOfBalls;
     bool winner;
     bool gameDone;
     uint8_t LEDScores[2];
     uint8_t overallScores[2];
+    uint32_t tick;              // simulation tick the state is from (PHYSICS_ENGINE)
 } GameState_t;
 #pragma pack ( pop )
 
@@ -249,7 +345,7 @@ void ReceiveDataFromHost();
 void SendDataToHost();
 
 /*
- * Thread to read client's joystick
+ * Periodic event to read client's joystick
  */
 void ReadJoystickClient();
 
@@ -283,7 +379,7 @@ void ReceiveDataFromClient();
 void GenerateBall();
 
 /*
- * Thread to read host's joystick
+ * Periodic event to read host's joystick
  */
 void ReadJoystickHost();
 
@@ -292,6 +388,11 @@ void ReadJoystickHost();
  */
 void MoveBall();
 
+/*
+ * Fixed timestep simulation of the host's game (PHYSICS_ENGINE)
+ */
+void PhysicsEngine();
+
 /*
  * End of game for the host
  */
@@ -349,5 +450,6 @@ void InitBoardState();
 
 /* ============================== APERIODIC THREADS ===================================== */
 void ButtonPress ( void );
+void ButtonPressDeferred ( uint32_t flags );
 
 #endif /* GAME_H_ */
@@ -0,0 +1,142 @@
+#ifndef PHYSICS_H_
+#define PHYSICS_H_
+
+/*
+ * Physics.h
+ *
+ * Ball physics for the host. Every live ball is stepped in one pass over
+ * a structure of arrays store, with the wall and paddle rules of MoveBall.
+ * The store only holds the simulation; PhysicsEngine in Game.c copies it
+ * into the gamestate and handles scoring.
+ *
+ * Collisions are swept. Each step the ball's path is tested against the
+ * side walls and the paddle lines, and it reflects at the exact time of
+ * the first impact, then moves for the rest of the step. The paddle test
+ * is the Minkowski sum of paddle and ball (WIDTH_TOP_OR_BOTTOM), taken at
+ * the x where the ball reaches the paddle, so no speed can skip a hit.
+ * Positions are fixed point with PHYSICS_FRAC_BITS fraction bits.
+ * tools/PhysicsTest.c checks the tricky cases on the host.
+ *
+ * The store is a pool. Free slots are on a stack, and the live and used
+ * slots are bitmasks, so adding a ball, stepping every ball and emptying
+ * the store take time in proportion to the balls in play, not to
+ * MAX_NUM_OF_BALLS.
+ *
+ * With BALL_COLLISIONS the balls also bounce off each other after they
+ * move. Each ball is put in the grid cell of its top left corner. A cell
+ * is at least a ball wide, so touching balls are in the same or
+ * neighbouring cells, and only those pairs are tested.
+ */
+
+/*********************************************** Includes ********************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "Game.h"
+/*********************************************** Includes ********************************************************************/
+
+/*********************************************** Sizes and Limits *********************************************************************/
+
+#define PHYSICS_FRAC_BITS   8   // fraction bits of positions and of the time within a step
+#define PHYSICS_ONE         (1 << PHYSICS_FRAC_BITS)
+#define PHYSICS_MAX_HITS    4   // impacts handled in one step, a corner is two
+
+/* BALL_COLLISIONS: uniform grid over the arena, GRID_CELL pixel squares */
+#define GRID_CELL_SHIFT     4
+#define GRID_CELL           (1 << GRID_CELL_SHIFT)  // must be at least BALL_SIZE
+#define GRID_COLS           ((ARENA_MAX_X - ARENA_MIN_X + GRID_CELL - 1) >> GRID_CELL_SHIFT)
+#define GRID_ROWS           ((ARENA_MAX_Y - ARENA_MIN_Y + GRID_CELL - 1) >> GRID_CELL_SHIFT)
+#define GRID_CELLS          (GRID_COLS * GRID_ROWS)
+
+#define PHYSICS_TO_PIXEL(v)     ((int16_t)((v) >> PHYSICS_FRAC_BITS))
+#define PHYSICS_FROM_PIXEL(v)   ((int32_t)(v) << PHYSICS_FRAC_BITS)
+
+/*********************************************** Sizes and Limits *********************************************************************/
+
+/*********************************************** Data Structures ********************************************************************/
+
+/* Where a ball left the arena in the last step */
+typedef enum
+{
+    EXIT_NONE = 0,
+    EXIT_BOTTOM = 1,    // past the host's paddle
+    EXIT_TOP = 2        // past the client's paddle
+}ballExit;
+
+/*
+ * Ball store, one array per field so a step walks each field in order.
+ * Positions are the top left corner of the ball like Ball_t's centers,
+ * in fixed point (PHYSICS_TO_PIXEL gives the pixel).
+ * A ball that dies stays used until Physics_FreeBall, so the caller can
+ * finish with it before its slot is handed out again.
+ */
+typedef struct
+{
+    int32_t  x[MAX_NUM_OF_BALLS];
+    int32_t  y[MAX_NUM_OF_BALLS];
+    int16_t  xvel[MAX_NUM_OF_BALLS];    // pixels per step
+    int16_t  yvel[MAX_NUM_OF_BALLS];
+    uint16_t color[MAX_NUM_OF_BALLS];
+    uint8_t  exited[MAX_NUM_OF_BALLS];  // ballExit, set when the ball dies
+    uint32_t alive[BALL_MASK_WORDS];    // BALL_BIT of every ball that moves
+    uint32_t used[BALL_MASK_WORDS];     // alive, or dead and not freed yet
+    uint16_t freeSlots[MAX_NUM_OF_BALLS];   // stack of the slots that aren't used
+    uint16_t numFree;
+    uint16_t numAlive;
+    uint16_t exits[MAX_NUM_OF_BALLS];   // slots that died in the last step
+    uint16_t numExits;
+#ifdef BALL_COLLISIONS
+    int16_t  cellHead[GRID_CELLS];      // first ball in each cell, -1 if empty
+    int16_t  cellNext[MAX_NUM_OF_BALLS];// next ball in the same cell
+    uint16_t cell[MAX_NUM_OF_BALLS];
+    uint32_t pairsTested;               // ball pairs tested in the last step
+#endif
+} ball_store_t;
+
+/*********************************************** Data Structures ********************************************************************/
+
+/*********************************************** Public Functions *********************************************************************/
+
+/*
+ * Empties the store and puts every slot on the free stack. Call once
+ * before the first game, Physics_Reset after that.
+ */
+void Physics_Init(ball_store_t *store);
+
+/*
+ * Empties the store by freeing the slots in use
+ */
+void Physics_Reset(ball_store_t *store);
+
+/*
+ * Puts a white ball with a random position and velocity in a free slot,
+ * like MoveBall does when it starts
+ * Returns: the slot, -1 if every slot is used
+ */
+int32_t Physics_AddBall(ball_store_t *store);
+
+/*
+ * Gives the slot of a dead ball back to the pool
+ */
+void Physics_FreeBall(ball_store_t *store, uint32_t slot);
+
+/*
+ * Finds the next set bit of a BALL_MASK_WORDS long ball mask
+ * Param "after": slot to start after, -1 for the first one
+ * Returns: the slot, -1 if there are no more
+ */
+int32_t Physics_NextBall(const uint32_t *mask, int32_t after);
+
+/*
+ * Moves every live ball one step. Balls bounce off the side walls and
+ * the paddles, and die with "exited" set on the line of a paddle they
+ * missed. Their slots are listed in "exits". With BALL_COLLISIONS the
+ * balls left bounce off each other.
+ * Param "hostCenter": center of the bottom paddle (players[0])
+ * Param "clientCenter": center of the top paddle (players[1])
+ * Returns: number of balls that left the arena
+ */
+uint32_t Physics_Step(ball_store_t *store, int16_t hostCenter, int16_t clientCenter);
+
+/*********************************************** Public Functions *********************************************************************/
+
+#endif /* PHYSICS_H_ */
@@ -17,5 +17,10 @@
 #include "G8RTOS_Scheduler.h"
 #include "G8RTOS_IPC.h"
 #include "G8RTOS_CriticalSection.h"
+#include "G8RTOS_Statistics.h"
+#include "G8RTOS_WorkerPool.h"
+#include "G8RTOS_MemPool.h"
+#include "G8RTOS_Deferred.h"
+#include "G8RTOS_Trace.h"
 
 #endif /* G8RTOS_H_ */
@@ -6,6 +6,23 @@
 #ifndef G8RTOS_CRITICALSECTION_H_
 #define G8RTOS_CRITICALSECTION_H_
 
+/*
+ * Uncomment to mask interrupts with BASEPRI instead of PRIMASK in kernel
+ * critical sections. Only interrupts at KERNEL_IRQ_PRIORITY or lower
+ * (larger numbers) are held off, so interrupts above it are never delayed
+ * by the kernel. Those interrupts must not call any G8RTOS function.
+ */
+// #define KERNEL_BASEPRI
+
+#ifdef KERNEL_BASEPRI
+#define KERNEL_IRQ_PRIORITY     2       // highest NVIC priority allowed to call the kernel
+#else
+#define KERNEL_IRQ_PRIORITY     0       // every interrupt is masked, so any may call the kernel
+#endif
+
+// MSP432 implements the top 3 bits of each 8 bit priority field
+#define KERNEL_BASEPRI_MASK     ((KERNEL_IRQ_PRIORITY) << 5)
+
 /*
  * Starts a critical section
  * 	- Saves the state of the current PRIMASK (I-bit)
@@ -21,5 +38,31 @@ extern int32_t StartCriticalSection();
  */
 extern void EndCriticalSection(int32_t IBit_State);
 
+/*
+ * Starts a critical section that only masks some interrupts
+ * 	- Saves the state of the current BASEPRI
+ * 	- Raises BASEPRI to the given mask, never lowers it (BASEPRI_MAX)
+ * Param "BasePri_Mask": priority field value, interrupts at or below it are held off
+ * Returns: The current BASEPRI State
+ */
+extern int32_t StartCriticalSectionMasked(int32_t BasePri_Mask);
+
+/*
+ * Ends a critical section started by StartCriticalSectionMasked
+ * 	- Restores the state of BASEPRI given an input
+ * Param "BasePri_State": BASEPRI State to update
+ */
+extern void EndCriticalSectionMasked(int32_t BasePri_State);
+
+// the host port implements these in C and maps the interrupt intrinsics onto them
+#ifdef G8RTOS_HOST
+#include "G8RTOS_Host.h"
+#endif
+
+#ifdef KERNEL_BASEPRI
+#define StartCriticalSection()          StartCriticalSectionMasked(KERNEL_BASEPRI_MASK)
+#define EndCriticalSection(state)       EndCriticalSectionMasked(state)
+#endif
+
 
 #endif /* G8RTOS_CRITICALSECTION_H_ */
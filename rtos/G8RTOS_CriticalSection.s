@@ -4,6 +4,7 @@
 
 	; Functions Defined
 	.def StartCriticalSection, EndCriticalSection
+	.def StartCriticalSectionMasked, EndCriticalSectionMasked
 	
 	.thumb		; Set to thumb mode
 	.align 2	; Align by 2 bytes (thumb mode uses allignment by 2 or 4)
@@ -32,4 +33,30 @@ EndCriticalSection:
 	MSR PRIMASK, R0		; Save R0 (Param) to PRIMASK
 	BX LR				; Return
 	
+	.endasmfunc
+
+; Starts a critical section that only masks some interrupts
+; 	- Saves the state of the current BASEPRI
+; 	- Raises BASEPRI to the given mask, never lowers it
+; Param R0: priority field value to mask at
+; Returns: The current BASEPRI State
+StartCriticalSectionMasked:
+	.asmfunc
+
+	MRS R1, BASEPRI		; Save BASEPRI to R1
+	MSR BASEPRI_MAX, R0	; Mask interrupts at R0 (Param) and below, only if it raises BASEPRI
+	MOV R0, R1			; Return the saved BASEPRI
+	BX LR				; Return
+
+	.endasmfunc
+
+; Ends a critical section started by StartCriticalSectionMasked
+; 	- Restores the state of BASEPRI given an input
+; Param R0: BASEPRI State to update
+EndCriticalSectionMasked:
+	.asmfunc
+
+	MSR BASEPRI, R0		; Save R0 (Param) to BASEPRI
+	BX LR				; Return
+
 	.endasmfunc
\ No newline at end of file
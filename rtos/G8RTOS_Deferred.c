@@ -0,0 +1,178 @@
+/*
+ * G8RTOS_Deferred.c
+ */
+
+/*********************************************** Dependencies and Externs *************************************************************/
+#include "G8RTOS_Deferred.h"
+#include "G8RTOS_Semaphores.h"
+#include "G8RTOS_CriticalSection.h"
+#include "BackChannelUart.h"
+
+/*********************************************** Dependencies and Externs *************************************************************/
+
+
+/*********************************************** Data Structures Used *****************************************************************/
+
+/*
+ * One posted bottom half
+ */
+typedef struct
+{
+    deferred_handler_t handler;
+    uint32_t arg;
+    uint32_t posted;        // G8RTOS_CYCLES when the ISR posted it
+} deferred_work_t;
+
+/*
+ * Work queue. Several ISRs at different NVIC priorities can post, so
+ * pushes take a (short) critical section instead of using a ring.
+ */
+static deferred_work_t DeferredQueue[DEFERRED_QUEUE_SIZE];
+static uint32_t DeferredHead;
+static uint32_t DeferredTail;
+static uint32_t DeferredCount;
+static semaphore_t DeferredPending;
+static bool DeferredReady = false;
+
+static deferred_stats_t DeferredStats;
+
+/*********************************************** Data Structures Used *****************************************************************/
+
+
+/*********************************************** Private Functions ********************************************************************/
+
+/*
+ * Deferred work thread. Runs bottom halves in the order they were posted.
+ */
+static void DeferredWorkThread(void)
+{
+    G8RTOS_MakePersistent();
+
+    while(1)
+    {
+        G8RTOS_WaitSemaphore(&DeferredPending);
+
+        uint32_t primask = StartCriticalSection();
+        deferred_work_t work = DeferredQueue[DeferredHead];
+        DeferredHead = (DeferredHead + 1) % DEFERRED_QUEUE_SIZE;
+        DeferredCount--;
+        EndCriticalSection(primask);
+        __enable_interrupts();
+
+        uint32_t start = G8RTOS_CYCLES();
+        G8RTOS_RecordCycleStat(&DeferredStats.latency, start - work.posted);
+
+        work.handler(work.arg);
+
+        G8RTOS_RecordCycleStat(&DeferredStats.run, G8RTOS_CYCLES() - start);
+    }
+}
+
+/*********************************************** Private Functions ********************************************************************/
+
+
+/*********************************************** Public Functions *********************************************************************/
+
+/*
+ * Adds the deferred work thread
+ */
+sched_err_code_t G8RTOS_InitDeferredWork(void)
+{
+    DeferredHead = 0;
+    DeferredTail = 0;
+    DeferredCount = 0;
+    G8RTOS_InitSemaphore(&DeferredPending, 0);
+    G8RTOS_ResetDeferredStats();
+
+    sched_err_code_t err = G8RTOS_AddThread( &DeferredWorkThread, DEFERRED_PRIORITY, 0xFFFFFFFF, DEFERRED_STACKSIZE, "KERNEL_DEFERRED_" );
+    DeferredReady = ( err == NO_ERROR );
+    return err;
+}
+
+/*
+ * Queues a bottom half
+ * THIS IS A CRITICAL SECTION
+ */
+int G8RTOS_DeferWork(deferred_handler_t handler, uint32_t arg)
+{
+    // nothing can run the work before the kernel starts
+    if ( !DeferredReady || CurrentlyRunningThread == 0 )
+    {
+        DeferredStats.inline_runs++;
+        return -1;
+    }
+
+    uint32_t primask = StartCriticalSection();
+
+    if ( DeferredCount >= DEFERRED_QUEUE_SIZE )
+    {
+        DeferredStats.inline_runs++;
+        EndCriticalSection(primask);
+        __enable_interrupts();
+        return -1;
+    }
+
+    DeferredQueue[DeferredTail].handler = handler;
+    DeferredQueue[DeferredTail].arg = arg;
+    DeferredQueue[DeferredTail].posted = G8RTOS_CYCLES();
+    DeferredTail = (DeferredTail + 1) % DEFERRED_QUEUE_SIZE;
+    DeferredCount++;
+
+    EndCriticalSection(primask);
+    __enable_interrupts();
+
+    // preempts whatever the ISR interrupted as soon as the ISR returns
+    G8RTOS_SignalSemaphore(&DeferredPending);
+    return 0;
+}
+
+/*
+ * Records one top half's run time
+ */
+void G8RTOS_RecordIsrCycles(uint32_t start)
+{
+    uint32_t primask = StartCriticalSection();
+    G8RTOS_RecordCycleStat(&DeferredStats.isr, G8RTOS_CYCLES() - start);
+    EndCriticalSection(primask);
+}
+
+/*
+ * Copies the deferred work statistics
+ */
+void G8RTOS_GetDeferredStats(deferred_stats_t *stats)
+{
+    uint32_t primask = StartCriticalSection();
+    *stats = DeferredStats;
+    EndCriticalSection(primask);
+    __enable_interrupts();
+}
+
+/*
+ * Clears the deferred work statistics
+ */
+void G8RTOS_ResetDeferredStats(void)
+{
+    uint32_t primask = StartCriticalSection();
+    G8RTOS_ResetCycleStat(&DeferredStats.isr);
+    G8RTOS_ResetCycleStat(&DeferredStats.latency);
+    G8RTOS_ResetCycleStat(&DeferredStats.run);
+    DeferredStats.inline_runs = 0;
+    EndCriticalSection(primask);
+    __enable_interrupts();
+}
+
+/*
+ * Prints the deferred work statistics
+ */
+void G8RTOS_PrintDeferredStats(void)
+{
+    deferred_stats_t stats;
+    G8RTOS_GetDeferredStats(&stats);
+
+    G8RTOS_PrintCycleStat("ISR", &stats.isr);
+    G8RTOS_PrintCycleStat("DEFER_LATENCY", &stats.latency);
+    G8RTOS_PrintCycleStat("DEFERRED_RUN", &stats.run);
+    BackChannelPrintIntVariable("DEFER_INLINE", stats.inline_runs);
+}
+
+/*********************************************** Public Functions *********************************************************************/
@@ -0,0 +1,89 @@
+/*
+ * G8RTOS_Deferred.h
+ */
+
+#ifndef G8RTOS_G8RTOS_DEFERRED_H_
+#define G8RTOS_G8RTOS_DEFERRED_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "G8RTOS_Structures.h"
+#include "G8RTOS_Scheduler.h"
+
+/*********************************************** Sizes and Limits *********************************************************************/
+#define DEFERRED_QUEUE_SIZE     16      // posted work that can wait for the deferred work thread
+#define DEFERRED_PRIORITY       0       // priority of the deferred work thread. Keep it above every other thread.
+#define DEFERRED_STACKSIZE      128     // words. Bottom halves must stay small.
+/*********************************************** Sizes and Limits *********************************************************************/
+
+
+/*********************************************** Data Structure Definitions ***********************************************************/
+
+/*
+ * Bottom half of an interrupt. Runs on the deferred work thread with
+ * interrupts enabled, so it may take mutexes and call any kernel function
+ * except sleep. "arg" is whatever the ISR posted (usually the flags it read).
+ */
+typedef void (*deferred_handler_t)(uint32_t arg);
+
+/*
+ *  Deferred Work Statistics:
+ *      - isr: cycles spent in top halves that call G8RTOS_RecordIsrCycles
+ *      - latency: cycles from G8RTOS_DeferWork to the bottom half starting
+ *      - run: cycles spent in bottom halves
+ */
+typedef struct
+{
+    cycle_stat_t isr;
+    cycle_stat_t latency;
+    cycle_stat_t run;
+    uint32_t inline_runs;   // posts that ran in the ISR (kernel not running or queue full)
+} deferred_stats_t;
+
+/*********************************************** Data Structure Definitions ***********************************************************/
+
+
+/*********************************************** Public Functions *********************************************************************/
+
+/*
+ * Adds the deferred work thread. It is persistent, so
+ * G8RTOS_KillAllOthers leaves it running. Call before G8RTOS_Launch_Priority.
+ * Returns: error code from G8RTOS_AddThread
+ */
+sched_err_code_t G8RTOS_InitDeferredWork(void);
+
+/*
+ * Queues a bottom half from an ISR (or anywhere else). Never blocks.
+ * Param "handler": bottom half to run
+ * Param "arg": value passed to it
+ * Returns: 0 if queued. -1 if the kernel isn't running yet or the queue is
+ *          full. The caller should then run the handler itself.
+ */
+int G8RTOS_DeferWork(deferred_handler_t handler, uint32_t arg);
+
+/*
+ * Records one top half's run time. Call at the end of the ISR.
+ * Param "start": G8RTOS_CYCLES read on entry to the ISR
+ */
+void G8RTOS_RecordIsrCycles(uint32_t start);
+
+/*
+ * Copies the deferred work statistics
+ * Param "stats": where to copy them
+ */
+void G8RTOS_GetDeferredStats(deferred_stats_t *stats);
+
+/*
+ * Clears the deferred work statistics
+ */
+void G8RTOS_ResetDeferredStats(void);
+
+/*
+ * Prints the max ISR duration, max deferral latency and bottom half
+ * run times to the back channel UART
+ */
+void G8RTOS_PrintDeferredStats(void);
+
+/*********************************************** Public Functions *********************************************************************/
+
+#endif /* G8RTOS_G8RTOS_DEFERRED_H_ */
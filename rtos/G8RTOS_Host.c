@@ -0,0 +1,486 @@
+/*
+ * G8RTOS_Host.c
+ *
+ * Linux port of G8RTOS. See G8RTOS_Host.h.
+ */
+
+#ifdef G8RTOS_HOST
+
+/*********************************************** Dependencies and Externs *************************************************************/
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <ucontext.h>
+#include "G8RTOS_Host.h"
+#include "G8RTOS_Scheduler.h"
+#include "BSP.h"
+
+extern tcb_t * CurrentlyRunningThread;
+extern void SysTick_Handler(void);
+extern void G8RTOS_Scheduler_Priority(void);
+
+/*********************************************** Dependencies and Externs *************************************************************/
+
+
+/*********************************************** Data Structures Used *****************************************************************/
+
+/*
+ * Interrupt state
+ *  - "Masked" is PRIMASK. Outside virtual mode SIGALRM is blocked while it is set.
+ *  - "IsrDepth" counts handlers running. PendSV and other interrupts wait
+ *    for it to reach 0, like they wait for an exception to return.
+ *  - "Exception" is the exception number of the running handler
+ */
+static volatile sig_atomic_t Masked;
+static volatile uint32_t IsrDepth;
+static volatile uint32_t Exception;
+static volatile bool PendSVPending;
+static volatile bool TickPending;
+static volatile bool Launched;
+static sigset_t AlarmSet;
+
+/*
+ * Host NVIC
+ */
+static void (*Vectors[HOST_IRQS])(void);
+static volatile bool IrqEnabled[HOST_IRQS];
+static volatile bool IrqPending[HOST_IRQS];
+static volatile bool AnyIrqPending;
+
+/*
+ * Threads. Stacks and entry points are kept per tcb slot, the kernel's
+ * idle thread uses the last one.
+ */
+static char Stacks[MAX_THREADS + 1][HOST_STACK_BYTES] __attribute__((aligned(16)));
+static void (*Entries[MAX_THREADS + 1])(void);
+
+/*
+ * Time
+ *  - "Ticks" counts ticks since launch, it follows SystemTime
+ *  - "TickDueTime" is when the last tick was due, in G8RTOS_CYCLES
+ *  - "VirtualNs" and "NextTickNs" drive virtual mode
+ */
+static uint32_t Ticks;
+static uint32_t RunLimit;
+static uint32_t TickDueTime;
+#ifdef G8RTOS_HOST_VIRTUAL
+static uint64_t VirtualNs;
+static uint64_t NextTickNs;
+#endif
+
+/*********************************************** Data Structures Used *****************************************************************/
+
+
+/*********************************************** Private Functions ********************************************************************/
+
+/*
+ * Slot of a thread's stack and entry point
+ */
+static uint32_t ContextSlot(tcb_t *thread)
+{
+    uint8_t slot = G8RTOS_ThreadSlot(thread);
+    return (slot < MAX_THREADS) ? slot : MAX_THREADS;
+}
+
+/*
+ * Sets PRIMASK
+ */
+static void Mask(void)
+{
+    // block first, so the handler never sees the flag set on a thread
+#ifndef G8RTOS_HOST_VIRTUAL
+    sigprocmask(SIG_BLOCK, &AlarmSet, 0);
+#endif
+    Masked = 1;
+}
+
+/*
+ * PendSV. Picks the next thread and swaps to it. Returns when this
+ * thread is switched back in. Runs with PRIMASK set.
+ */
+static void ContextSwitch(void)
+{
+    tcb_t *outgoing = CurrentlyRunningThread;
+
+    G8RTOS_Scheduler_Priority();
+
+    if ( CurrentlyRunningThread != outgoing )
+        swapcontext(&outgoing->context, &CurrentlyRunningThread->context);
+}
+
+/*
+ * SysTick. Also polls the host board for button presses.
+ */
+static void Tick(void)
+{
+    Exception = 15;
+    IsrDepth++;
+
+    if ( Launched )
+    {
+        TickDueTime = G8RTOS_CYCLES();
+        SysTick_Handler();
+        Ticks++;
+    }
+    HostBoard_Tick(Ticks);
+
+    IsrDepth--;
+    Exception = 0;
+
+    if ( RunLimit != 0 && Ticks >= RunLimit )
+    {
+        fflush(stdout);
+        exit(0);
+    }
+}
+
+/*
+ * Runs everything that became pending while PRIMASK was set: the tick,
+ * raised interrupts, then PendSV, in the order of their priorities.
+ * Runs with PRIMASK set.
+ */
+static void Service(void)
+{
+    while ( IsrDepth == 0 )
+    {
+        if ( TickPending )
+        {
+            TickPending = false;
+            Tick();
+        }
+        else if ( AnyIrqPending )
+        {
+            AnyIrqPending = false;
+            for (int32_t irq = 0; irq < HOST_IRQS; irq++)
+            {
+                if ( IrqPending[irq] && IrqEnabled[irq] && Vectors[irq] != 0 )
+                {
+                    IrqPending[irq] = false;
+                    Exception = irq + 16;
+                    IsrDepth++;
+                    Vectors[irq]();
+                    IsrDepth--;
+                    Exception = 0;
+                }
+            }
+        }
+        else if ( PendSVPending && Launched )
+        {
+            PendSVPending = false;
+            ContextSwitch();
+        }
+        else
+            break;
+    }
+}
+
+/*
+ * Clears PRIMASK. Pending work runs first, still masked, so this is
+ * where threads get preempted. Handlers never unmask.
+ */
+static void Unmask(void)
+{
+    if ( IsrDepth != 0 )
+        return;
+
+#ifdef G8RTOS_HOST_VIRTUAL
+    // every kernel call costs a little virtual time, so threads that
+    // never block still see ticks
+    VirtualNs += HOST_VIRTUAL_NS_PER_CALL;
+    if ( Launched && VirtualNs >= NextTickNs )
+    {
+        NextTickNs += HOST_NS_PER_TICK;
+        TickPending = true;
+    }
+
+    // no ticks before launch, the host board is polled here instead
+    if ( !Launched )
+        HostBoard_Tick(0);
+#endif
+
+    Service();
+    Masked = 0;
+#ifndef G8RTOS_HOST_VIRTUAL
+    sigprocmask(SIG_UNBLOCK, &AlarmSet, 0);
+#endif
+}
+
+#ifndef G8RTOS_HOST_VIRTUAL
+/*
+ * SIGALRM handler. Only runs while PRIMASK is clear.
+ */
+static void AlarmHandler(int sig)
+{
+    (void)sig;
+
+    if ( Masked || IsrDepth != 0 )
+    {
+        TickPending = true;
+        return;
+    }
+
+    Masked = 1;
+    TickPending = true;
+    Service();
+    Masked = 0;
+}
+#endif
+
+/*
+ * First code every thread runs. Ends the switch in like PendSV returning.
+ */
+static void ThreadStart(void)
+{
+    void (*entry)(void) = Entries[ContextSlot(CurrentlyRunningThread)];
+
+    Unmask();
+    entry();
+
+    // returning from a thread function is a bug on the board. End it cleanly here.
+    G8RTOS_KillSelf();
+    while(1);
+}
+
+/*********************************************** Private Functions ********************************************************************/
+
+
+/*********************************************** Public Functions *********************************************************************/
+
+/*
+ * Starts a critical section. Returns: the previous PRIMASK
+ * The names are in parentheses here and below so KERNEL_BASEPRI's macros
+ * leave them alone; G8RTOS_Idle calls these directly in that build.
+ */
+int32_t (StartCriticalSection)()
+{
+    int32_t state = Masked;
+    if ( !state )
+        Mask();
+    return state;
+}
+
+/*
+ * Ends a critical section by restoring PRIMASK
+ */
+void (EndCriticalSection)(int32_t IBit_State)
+{
+    if ( !IBit_State && Masked )
+        Unmask();
+}
+
+/*
+ * BASEPRI is not modelled, these mask everything
+ */
+int32_t StartCriticalSectionMasked(int32_t BasePri_Mask)
+{
+    (void)BasePri_Mask;
+    return (StartCriticalSection)();
+}
+
+void EndCriticalSectionMasked(int32_t BasePri_State)
+{
+    (EndCriticalSection)(BasePri_State);
+}
+
+/*
+ * Clears PRIMASK and runs whatever became pending
+ */
+void G8RTOS_HostEnableInterrupts(void)
+{
+    if ( Masked )
+        Unmask();
+}
+
+/*
+ * Stands in for WFI. Returns once the next tick is pending.
+ */
+void G8RTOS_HostWaitForInterrupt(void)
+{
+#ifdef G8RTOS_HOST_VIRTUAL
+    // nothing can happen before the next tick
+    if ( VirtualNs < NextTickNs )
+        VirtualNs = NextTickNs;
+    NextTickNs += HOST_NS_PER_TICK;
+    TickPending = true;
+#else
+    int sig;
+    sigwait(&AlarmSet, &sig);
+    TickPending = true;
+#endif
+}
+
+/*
+ * Requests a context switch. Runs now unless PRIMASK is set or a handler is running.
+ */
+void G8RTOS_HostPendSV(void)
+{
+    PendSVPending = true;
+
+    if ( !Masked && IsrDepth == 0 )
+    {
+        Mask();
+        Unmask();
+    }
+}
+
+bool G8RTOS_HostPendSVPending(void)
+{
+    return PendSVPending;
+}
+
+uint32_t G8RTOS_HostTickElapsed(void)
+{
+    return G8RTOS_CYCLES() - TickDueTime;
+}
+
+uint32_t G8RTOS_HostVirtualTime(void)
+{
+#ifdef G8RTOS_HOST_VIRTUAL
+    return (uint32_t)VirtualNs;
+#else
+    return 0;
+#endif
+}
+
+uint32_t G8RTOS_HostActiveException(void)
+{
+    return Exception;
+}
+
+void G8RTOS_HostSetVector(int32_t irq, void (*handler)(void))
+{
+    if ( irq >= 0 && irq < HOST_IRQS )
+        Vectors[irq] = handler;
+}
+
+/*
+ * Sets up the first context of a thread
+ */
+void G8RTOS_HostInitContext(void *thread, void (*entry)(void))
+{
+    tcb_t *tcb = (tcb_t *)thread;
+    uint32_t slot = ContextSlot(tcb);
+
+    Entries[slot] = entry;
+
+    getcontext(&tcb->context);
+    tcb->context.uc_stack.ss_sp = Stacks[slot];
+    tcb->context.uc_stack.ss_size = HOST_STACK_BYTES;
+    tcb->context.uc_link = 0;
+    sigaddset(&tcb->context.uc_sigmask, SIGALRM);      // switched in masked, like PendSV
+    makecontext(&tcb->context, ThreadStart, 0);
+}
+
+/*
+ * Installs the SIGALRM handler. Ticks before launch only poll the host board.
+ */
+void G8RTOS_HostInit(void)
+{
+    sigemptyset(&AlarmSet);
+    sigaddset(&AlarmSet, SIGALRM);
+
+    const char *limit = getenv("G8RTOS_HOST_RUN_MS");
+    RunLimit = limit ? (uint32_t)strtoul(limit, 0, 10) : 0;
+
+    setvbuf(stdout, 0, _IOLBF, 0);
+
+#ifndef G8RTOS_HOST_VIRTUAL
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = AlarmHandler;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGALRM, &action, 0);
+
+    struct itimerval timer;
+    timer.it_interval.tv_sec = 0;
+    timer.it_interval.tv_usec = HOST_NS_PER_TICK / 1000;
+    timer.it_value = timer.it_interval;
+    setitimer(ITIMER_REAL, &timer, 0);
+#endif
+}
+
+/*
+ * Switches to the first thread. Only returns if the main context is
+ * resumed, which never happens.
+ */
+void G8RTOS_Start(tcb_t *first)
+{
+    static ucontext_t mainContext;
+
+    Mask();
+    Launched = true;
+    TickDueTime = G8RTOS_CYCLES();
+#ifdef G8RTOS_HOST_VIRTUAL
+    NextTickNs = VirtualNs + HOST_NS_PER_TICK;
+#endif
+
+    swapcontext(&mainContext, &first->context);
+}
+
+/*
+ * Host NVIC
+ */
+void __NVIC_SetVector(IRQn_Type IRQn, uint32_t vector)
+{
+    // vectors only fit 32 bits on the board. Use G8RTOS_HostSetVector on the host.
+    (void)IRQn;
+    (void)vector;
+}
+
+void __NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority)
+{
+    (void)IRQn;
+    (void)priority;
+}
+
+void __NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+    if ( IRQn < 0 || IRQn >= HOST_IRQS )
+        return;
+
+    IrqEnabled[IRQn] = true;
+
+    // an interrupt raised while the line was off runs now
+    if ( IrqPending[IRQn] )
+    {
+        AnyIrqPending = true;
+        if ( !Masked && IsrDepth == 0 )
+        {
+            Mask();
+            Unmask();
+        }
+    }
+}
+
+void __NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+    if ( IRQn >= 0 && IRQn < HOST_IRQS )
+        IrqEnabled[IRQn] = false;
+}
+
+/*
+ * Raises an interrupt. It runs right away unless PRIMASK is set or a
+ * handler is running, then it runs when that ends.
+ */
+void __NVIC_SetPendingIRQ(IRQn_Type IRQn)
+{
+    if ( IRQn < 0 || IRQn >= HOST_IRQS )
+        return;
+
+    IrqPending[IRQn] = true;
+    AnyIrqPending = true;
+
+    if ( !Masked && IsrDepth == 0 )
+    {
+        Mask();
+        Unmask();
+    }
+}
+
+/*********************************************** Public Functions *********************************************************************/
+
+#endif /* G8RTOS_HOST */
@@ -0,0 +1,131 @@
+/*
+ * G8RTOS_Host.h
+ *
+ * Linux port of G8RTOS, used when G8RTOS_HOST is defined. The kernel
+ * files build unchanged on top of it, so scheduling, benchmarks and the
+ * game threads can run as a desktop process.
+ *
+ *  - every thread is a ucontext with its own host stack
+ *  - PRIMASK is a flag plus SIGALRM blocked with sigprocmask. BASEPRI is
+ *    not modelled: with KERNEL_BASEPRI every critical section masks all
+ *    interrupts, so the build works but priorities above the kernel's
+ *    are not tested
+ *  - SIGALRM from a 1 ms interval timer stands in for SysTick
+ *  - PendSV is a pending flag. The switch runs when the last critical
+ *    section ends or when the tick handler returns, like on the board.
+ *  - interrupts added with G8RTOS_AddAperiodicEvent_Priority run when
+ *    NVIC_SetPendingIRQ (or the host board) raises them
+ *  - G8RTOS_CYCLES counts ns. Thread stacks still come from the stack
+ *    pool, but nothing runs on them, so stack_used reads 0.
+ *
+ * The board is replaced by the headers and sources in host/ (see BSP.h
+ * there): stdout for the back channel UART, UDP on loopback for the
+ * CC3100, scripted buttons and joystick, and an LCD frame buffer.
+ *
+ * With G8RTOS_HOST_VIRTUAL, time is virtual and no signals are used. Each
+ * critical section exit costs HOST_VIRTUAL_NS_PER_CALL and the idle thread
+ * jumps straight to the next tick, so a run is repeatable. Threads that spin
+ * without ever calling the kernel never let virtual time move.
+ *
+ * Environment:
+ *  G8RTOS_HOST_RUN_MS      exit after this many ms of SystemTime
+ *  G8RTOS_HOST_PRESS       button presses for the host board, see host/HostBoard.c
+ *
+ * Build from the repository root. Select MAIN or BENCHMARK at the top of
+ * main.c as on the board, BENCH_ flags can be passed with -D:
+ *  gcc -O2 -fcommon -DG8RTOS_HOST -Ihost -Irtos -Iinc -Idrivers \
+ *      rtos/G8RTOS_Host.c rtos/G8RTOS_Scheduler.c rtos/G8RTOS_Semaphores.c rtos/G8RTOS_IPC.c \
+ *      rtos/G8RTOS_Statistics.c rtos/G8RTOS_WorkerPool.c rtos/G8RTOS_MemPool.c \
+ *      rtos/G8RTOS_Deferred.c rtos/G8RTOS_Trace.c host/HostBoard.c host/HostLCD.c host/HostWifi.c \
+ *      src/Game.c src/Physics.c src/Benchmark.c src/main.c -lm -o ping_host
+ */
+
+#ifndef G8RTOS_G8RTOS_HOST_H_
+#define G8RTOS_G8RTOS_HOST_H_
+
+#ifdef G8RTOS_HOST
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*********************************************** Sizes and Limits *********************************************************************/
+#define HOST_STACK_BYTES            (64 * 1024)     // host stack of each thread, signal handlers run on it too
+#define HOST_NS_PER_TICK            1000000         // G8RTOS_CYCLES counts ns on the host
+#define HOST_VIRTUAL_NS_PER_CALL    1000            // virtual time charged per critical section exit
+#define HOST_IRQS                   64              // interrupt lines the host NVIC keeps
+/*********************************************** Sizes and Limits *********************************************************************/
+
+
+/*********************************************** Intrinsics ***************************************************************************/
+#define __enable_interrupt()        G8RTOS_HostEnableInterrupts()
+#define __enable_interrupts()       G8RTOS_HostEnableInterrupts()
+#define __disable_interrupt()       ((void)StartCriticalSection())
+#define __WFI()                     G8RTOS_HostWaitForInterrupt()
+#define __DSB()
+#define __ISB()
+#define __DMB()                     __sync_synchronize()
+/*********************************************** Intrinsics ***************************************************************************/
+
+
+/*********************************************** Public Functions *********************************************************************/
+
+/*
+ * Clears PRIMASK and runs whatever became pending while it was set
+ */
+void G8RTOS_HostEnableInterrupts(void);
+
+/*
+ * Stands in for WFI inside a critical section. Returns once the next
+ * tick is pending. The tick itself runs when the critical section ends.
+ */
+void G8RTOS_HostWaitForInterrupt(void);
+
+/*
+ * Requests a context switch (PENDSVSET)
+ */
+void G8RTOS_HostPendSV(void);
+
+/*
+ * Returns: true while a context switch is pending
+ */
+bool G8RTOS_HostPendSVPending(void);
+
+/*
+ * Returns: ns since the current tick was due, for release delays
+ */
+uint32_t G8RTOS_HostTickElapsed(void);
+
+/*
+ * Returns: low 32 bits of virtual time in ns
+ */
+uint32_t G8RTOS_HostVirtualTime(void);
+
+/*
+ * Returns: exception number being handled (IRQn + 16, SysTick is 15), 0 in a thread
+ */
+uint32_t G8RTOS_HostActiveException(void);
+
+/*
+ * Installs the handler of an interrupt line
+ */
+void G8RTOS_HostSetVector(int32_t irq, void (*handler)(void));
+
+/*
+ * Sets up the first context of a thread so it starts at "entry"
+ * Param "thread": tcb of the new thread
+ * Param "entry": thread function
+ */
+void G8RTOS_HostInitContext(void *thread, void (*entry)(void));
+
+/*
+ * Installs the SIGALRM handler and starts the 1 ms timer, which polls
+ * the host board until launch (virtual time polls it on every critical
+ * section exit instead). Called by G8RTOS_Init.
+ */
+void G8RTOS_HostInit(void);
+
+/*********************************************** Public Functions *********************************************************************/
+
+#endif /* G8RTOS_HOST */
+
+#endif /* G8RTOS_G8RTOS_HOST_H_ */
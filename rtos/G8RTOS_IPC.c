@@ -8,6 +8,16 @@
 #define FIFOSIZE 100
 #define MAX_NUMBER_OF_FIFOS 6
 
+/*
+ * Orders the ring's data copy before the index store that publishes it
+ * (and the index load before the data copy on the other side)
+ */
+#ifdef G8RTOS_HOST
+#define RING_BARRIER()      __sync_synchronize()
+#else
+#define RING_BARRIER()      __DMB()
+#endif
+
 /*********************************************** Defines ******************************************************************************/
 
 
@@ -110,10 +120,12 @@ int writeFIFO(uint32_t FIFOChoice, uint32_t Data)
     // WAIT(mutex) in case fifo is being read or written to from another thread
      G8RTOS_WaitSemaphore( &FIFOs[FIFOChoice].mutex );
 
+    bool overflow = false;
+
     // check if the current size is too large
     // and return error code if it is. Also
     // overwrite old data into the queue
-    if ( FIFOs[FIFOChoice].current_size > FIFOSIZE-1 )
+    if ( FIFOs[FIFOChoice].current_size.count > FIFOSIZE-1 )
     {
         // overwrite old data here...
         FIFOs[FIFOChoice].head++;   // old data is lost here
@@ -123,6 +135,7 @@ int writeFIFO(uint32_t FIFOChoice, uint32_t Data)
 
         // keep track of the lost data
         FIFOs[FIFOChoice].lost_data++;
+        overflow = true;
     }
 
     // update tail pointer to new data
@@ -138,13 +151,189 @@ int writeFIFO(uint32_t FIFOChoice, uint32_t Data)
     // SIGNAL(mutex) in case fifo so other threads can read or write to the fifo
      G8RTOS_SignalSemaphore( &FIFOs[FIFOChoice].mutex );
 
+    // the new item took the dropped item's place, so the number of
+    // items (current_size) doesn't change on an overflow
+    if ( overflow )
+        return -1;
+
     // SIGNAL(current_size)
     G8RTOS_SignalSemaphore( &FIFOs[FIFOChoice].current_size );
+    return 0;
+}
+
+/*
+ * Copies bytes into a ring starting at a free running index
+ */
+static void RingCopyIn(ring_t *r, uint32_t index, const uint8_t *data, uint32_t length)
+{
+    for (uint32_t i = 0; i < length; i++)
+        r->buffer[(index + i) & r->mask] = data[i];
+}
+
+/*
+ * Copies bytes out of a ring starting at a free running index
+ */
+static void RingCopyOut(ring_t *r, uint32_t index, uint8_t *data, uint32_t length)
+{
+    for (uint32_t i = 0; i < length; i++)
+        data[i] = r->buffer[(index + i) & r->mask];
+}
 
-    // determine if there was an error or not
-    if ( FIFOs[FIFOChoice].current_size > FIFOSIZE-1 )
+/*
+ * Initializes an empty ring buffer
+ */
+int G8RTOS_InitRing(ring_t *r, uint8_t *buffer, uint32_t capacity)
+{
+    if ( capacity == 0 || (capacity & (capacity - 1)) != 0 )
         return -1;
-    else
-        return 0;
+
+    r->buffer = buffer;
+    r->mask = capacity - 1;
+    r->head = 0;
+    r->tail = 0;
+    r->dropped = 0;
+    return 0;
+}
+
+/*
+ * Copies one record into a ring
+ *  - Reads head once. The consumer can only free more space meanwhile.
+ *  - Publishes the record by storing tail after the copy
+ */
+int G8RTOS_RingWrite(ring_t *r, const void *record, uint16_t length)
+{
+    uint32_t tail = r->tail;
+    uint32_t used = tail - r->head;
+
+    if ( length == 0 || RING_RECORD_SIZE(length) > r->mask + 1 - used )
+    {
+        r->dropped++;
+        return -1;
+    }
+
+    RingCopyIn(r, tail, (const uint8_t *)&length, sizeof(length));
+    RingCopyIn(r, tail + sizeof(length), (const uint8_t *)record, length);
+
+    RING_BARRIER();
+    r->tail = tail + RING_RECORD_SIZE(length);
+    return 0;
+}
+
+/*
+ * Copies the oldest record out of a ring
+ *  - Reads tail once. The producer can only add more records meanwhile.
+ *  - Frees the space by storing head after the copy
+ */
+int32_t G8RTOS_RingRead(ring_t *r, void *record, uint16_t maxLength)
+{
+    uint32_t head = r->head;
+
+    if ( r->tail == head )
+        return -1;
+
+    RING_BARRIER();
+
+    uint16_t length;
+    RingCopyOut(r, head, (uint8_t *)&length, sizeof(length));
+    RingCopyOut(r, head + sizeof(length), (uint8_t *)record, (length < maxLength) ? length : maxLength);
+
+    RING_BARRIER();
+    r->head = head + RING_RECORD_SIZE(length);
+    return length;
+}
+
+/*
+ * Returns the number of bytes waiting in a ring
+ */
+uint32_t G8RTOS_RingUsed(ring_t *r)
+{
+    return r->tail - r->head;
+}
+
+/*
+ * Takes the front pointer off a queue. Call inside a critical section
+ * after taking one count from q->items.
+ */
+static void * QueuePop(ptr_queue_t *q)
+{
+    void *item = q->slots[q->head];
+    q->head = (q->head + 1) % q->size;
+    q->count--;
+    return item;
 }
 
+/*
+ * Initializes an empty pointer queue
+ */
+void G8RTOS_InitQueue(ptr_queue_t *q, void **slots, uint32_t size)
+{
+    q->slots = slots;
+    q->size = size;
+    q->head = 0;
+    q->tail = 0;
+    q->count = 0;
+    G8RTOS_InitSemaphore(&q->items, 0);
+}
+
+/*
+ * Adds a pointer to the back of a queue
+ * THIS IS A CRITICAL SECTION
+ */
+int G8RTOS_QueueSend(ptr_queue_t *q, void *item)
+{
+    uint32_t primask = StartCriticalSection();
+
+    if ( q->count >= q->size )
+    {
+        EndCriticalSection(primask);
+        __enable_interrupts();
+        return -1;
+    }
+
+    q->slots[q->tail] = item;
+    q->tail = (q->tail + 1) % q->size;
+    q->count++;
+
+    EndCriticalSection(primask);
+    __enable_interrupts();
+
+    G8RTOS_SignalSemaphore(&q->items);
+    return 0;
+}
+
+/*
+ * Takes the front pointer, blocking while the queue is empty
+ * THIS IS A CRITICAL SECTION
+ */
+void * G8RTOS_QueueReceive(ptr_queue_t *q)
+{
+    G8RTOS_WaitSemaphore(&q->items);
+
+    uint32_t primask = StartCriticalSection();
+    void *item = QueuePop(q);
+    EndCriticalSection(primask);
+    __enable_interrupts();
+
+    return item;
+}
+
+/*
+ * Takes the front pointer without blocking
+ * THIS IS A CRITICAL SECTION
+ */
+void * G8RTOS_QueueTryReceive(ptr_queue_t *q)
+{
+    void *item = 0;
+    uint32_t primask = StartCriticalSection();
+
+    // a positive count means a pointer is queued that no receiver has claimed
+    if ( q->items.count > 0 )
+    {
+        q->items.count--;
+        item = QueuePop(q);
+    }
+
+    EndCriticalSection(primask);
+    __enable_interrupts();
+    return item;
+}
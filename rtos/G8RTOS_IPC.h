@@ -14,6 +14,51 @@
 
 /*********************************************** Error Codes **************************************************************************/
 
+/*********************************************** Data Structure Definitions ***********************************************************/
+
+/*
+ * Single producer, single consumer ring buffer
+ *  - Holds variable length records, each stored as a 16 bit length and its bytes
+ *  - Capacity in bytes is a power of two so indices wrap with a mask
+ *  - head and tail run freely and only wrap at 2^32. tail - head is the
+ *    number of bytes in use.
+ *  - Only the producer writes tail and only the consumer writes head.
+ *    Neither side takes a semaphore or a critical section, so one side
+ *    can be an ISR or periodic event. Two producers (or two consumers)
+ *    must not share a ring.
+ */
+typedef struct ring
+{
+    uint8_t *buffer;            // capacity bytes, supplied by the caller
+    uint32_t mask;              // capacity - 1
+    volatile uint32_t head;     // next byte to read, consumer owned
+    volatile uint32_t tail;     // next byte to write, producer owned
+    uint32_t dropped;           // records the producer couldn't fit
+} ring_t;
+
+/* Bytes a record of "length" bytes takes in a ring */
+#define RING_RECORD_SIZE(length)    ((length) + sizeof(uint16_t))
+
+/*
+ * Pointer queue
+ *  - Bounded FIFO of pointers, normally to G8RTOS_MemPool blocks, so a
+ *    message changes owner without being copied
+ *  - Any number of senders and receivers. Sending never blocks, so
+ *    ISRs and periodic events can send. Receivers can block.
+ *  - Whoever receives a pointer owns the block and frees it
+ */
+typedef struct ptr_queue
+{
+    void **slots;               // size pointers, supplied by the caller
+    uint32_t size;              // number of slots
+    uint32_t head;              // next slot to receive from
+    uint32_t tail;              // next slot to send to
+    uint32_t count;             // pointers in the queue
+    semaphore_t items;          // receivers wait here for a pointer
+} ptr_queue_t;
+
+/*********************************************** Data Structure Definitions ***********************************************************/
+
 /*********************************************** Public Functions *********************************************************************/
 
 /*
@@ -40,6 +85,69 @@ uint32_t readFIFO(uint32_t FIFO);
  */
 int writeFIFO(uint32_t FIFO, uint32_t data);
 
+/*
+ * Initializes an empty ring buffer
+ * Param "r": ring to initialize
+ * Param "buffer": storage for the ring, used only through the ring afterwards
+ * Param "capacity": size of buffer in bytes, must be a power of two
+ * Returns: 0, or -1 if capacity is not a power of two
+ */
+int G8RTOS_InitRing(ring_t *r, uint8_t *buffer, uint32_t capacity);
+
+/*
+ * Copies one record into a ring. Producer side only.
+ * Param "r": ring to write
+ * Param "record": bytes to copy
+ * Param "length": number of bytes, 1 or more
+ * Returns: 0, or -1 if there isn't room (the record is dropped and counted)
+ */
+int G8RTOS_RingWrite(ring_t *r, const void *record, uint16_t length);
+
+/*
+ * Copies the oldest record out of a ring. Consumer side only.
+ * Param "r": ring to read
+ * Param "record": where to copy the record
+ * Param "maxLength": size of "record" in bytes. A longer record is
+ *                    truncated to maxLength and the rest is skipped.
+ * Returns: the record's full length, or -1 if the ring is empty
+ */
+int32_t G8RTOS_RingRead(ring_t *r, void *record, uint16_t maxLength);
+
+/*
+ * Returns: number of bytes waiting in a ring, records and lengths included
+ */
+uint32_t G8RTOS_RingUsed(ring_t *r);
+
+/*
+ * Initializes an empty pointer queue
+ * Param "q": queue to initialize
+ * Param "slots": storage for "size" pointers
+ * Param "size": most pointers the queue holds
+ */
+void G8RTOS_InitQueue(ptr_queue_t *q, void **slots, uint32_t size);
+
+/*
+ * Adds a pointer to the back of a queue and wakes a waiting receiver
+ * Param "q": queue to send to
+ * Param "item": pointer to send, ownership passes to the receiver
+ * Returns: 0, or -1 if the queue is full (the sender still owns item)
+ */
+int G8RTOS_QueueSend(ptr_queue_t *q, void *item);
+
+/*
+ * Takes the pointer at the front of a queue, blocking while it is empty
+ * Param "q": queue to receive from
+ * Returns: the pointer
+ */
+void * G8RTOS_QueueReceive(ptr_queue_t *q);
+
+/*
+ * Takes the pointer at the front of a queue without blocking
+ * Param "q": queue to receive from
+ * Returns: the pointer, or 0 if the queue is empty
+ */
+void * G8RTOS_QueueTryReceive(ptr_queue_t *q);
+
 /*********************************************** Public Functions *********************************************************************/
 
 
@@ -0,0 +1,120 @@
+/*
+ * G8RTOS_MemPool.c
+ */
+
+/*********************************************** Dependencies and Externs *************************************************************/
+#include "G8RTOS_MemPool.h"
+#include "BackChannelUart.h"
+
+/*********************************************** Dependencies and Externs *************************************************************/
+
+
+/*********************************************** Public Functions *********************************************************************/
+
+/*
+ * Splits storage into blocks and frees all of them
+ * THIS IS A CRITICAL SECTION
+ */
+void G8RTOS_InitPool(mem_pool_t *pool, uint32_t *storage, uint32_t blockSize, uint32_t blocks)
+{
+    uint32_t primask = StartCriticalSection();
+
+    pool->block_words = (blockSize + 3) / 4;
+    pool->blocks = blocks;
+    pool->free_list = 0;
+
+    // link the blocks back to front so the first allocation gets the first block
+    for (int32_t i = blocks - 1; i >= 0; i--)
+    {
+        void *block = storage + i * pool->block_words;
+        *(void **)block = pool->free_list;
+        pool->free_list = block;
+    }
+
+    pool->free = blocks;
+    pool->min_free = blocks;
+    pool->allocs = 0;
+    pool->failures = 0;
+
+    EndCriticalSection(primask);
+    __enable_interrupts();
+}
+
+/*
+ * Takes a block from a pool
+ * THIS IS A CRITICAL SECTION
+ */
+void * G8RTOS_PoolAlloc(mem_pool_t *pool)
+{
+    uint32_t primask = StartCriticalSection();
+
+    void *block = pool->free_list;
+
+    if ( block == 0 )
+        pool->failures++;
+    else
+    {
+        pool->free_list = *(void **)block;
+        pool->free--;
+        pool->allocs++;
+
+        if ( pool->free < pool->min_free )
+            pool->min_free = pool->free;
+    }
+
+    EndCriticalSection(primask);
+    __enable_interrupts();
+    return block;
+}
+
+/*
+ * Gives a block back to its pool
+ * THIS IS A CRITICAL SECTION
+ */
+void G8RTOS_PoolFree(mem_pool_t *pool, void *block)
+{
+    if ( block == 0 )
+        return;
+
+    uint32_t primask = StartCriticalSection();
+
+    *(void **)block = pool->free_list;
+    pool->free_list = block;
+    pool->free++;
+
+    EndCriticalSection(primask);
+    __enable_interrupts();
+}
+
+/*
+ * Clears a pool's statistics
+ */
+void G8RTOS_ResetPoolStats(mem_pool_t *pool)
+{
+    uint32_t primask = StartCriticalSection();
+
+    pool->min_free = pool->free;
+    pool->allocs = 0;
+    pool->failures = 0;
+
+    EndCriticalSection(primask);
+    __enable_interrupts();
+}
+
+/*
+ * Prints a pool's statistics
+ */
+void G8RTOS_PrintPoolStats(const char *name, mem_pool_t *pool)
+{
+    BackChannelPrint(name, BackChannel_Info);
+    BackChannelPrintIntVariable("blocks", pool->blocks);
+    BackChannelPrintIntVariable("free", pool->free);
+    BackChannelPrintIntVariable("min_free", pool->min_free);
+    BackChannelPrintIntVariable("allocs", pool->allocs);
+    BackChannelPrintIntVariable("failures", pool->failures);
+
+    if ( pool->min_free == 0 )
+        BackChannelPrint("pool was exhausted", BackChannel_Warning);
+}
+
+/*********************************************** Public Functions *********************************************************************/
@@ -0,0 +1,85 @@
+/*
+ * G8RTOS_MemPool.h
+ */
+
+#ifndef G8RTOS_G8RTOS_MEMPOOL_H_
+#define G8RTOS_G8RTOS_MEMPOOL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "G8RTOS_CriticalSection.h"
+
+/*********************************************** Defines ******************************************************************************/
+
+/* Words of storage a pool of "blocks" blocks of "blockSize" bytes needs */
+#define MEM_POOL_WORDS(blockSize, blocks)   ((((blockSize) + 3) / 4) * (blocks))
+
+/*********************************************** Defines ******************************************************************************/
+
+
+/*********************************************** Data Structure Definitions ***********************************************************/
+
+/*
+ *  Fixed Block Memory Pool:
+ *      - Hands out equal sized, word aligned blocks from storage given at init
+ *      - Free blocks are linked through their first word, so allocating
+ *        and freeing are O(1) and never fragment
+ *      - Safe to use from threads, ISRs and periodic events
+ *      - Keeps allocation statistics. An allocation from an empty pool
+ *        returns 0 and is counted in "failures".
+ */
+typedef struct mem_pool
+{
+    void *free_list;        // first free block, 0 when the pool is empty
+    uint32_t block_words;   // size of one block in words
+    uint32_t blocks;        // total number of blocks
+    uint32_t free;          // blocks free right now
+    uint32_t min_free;      // fewest blocks ever free (low-water mark)
+    uint32_t allocs;        // successful allocations
+    uint32_t failures;      // allocations refused because the pool was empty
+} mem_pool_t;
+
+/*********************************************** Data Structure Definitions ***********************************************************/
+
+
+/*********************************************** Public Functions *********************************************************************/
+
+/*
+ * Splits storage into blocks and frees all of them
+ * Param "pool": pool to initialize
+ * Param "storage": MEM_POOL_WORDS(blockSize, blocks) words, used only through the pool afterwards
+ * Param "blockSize": size of one block in bytes, rounded up to whole words
+ * Param "blocks": number of blocks
+ */
+void G8RTOS_InitPool(mem_pool_t *pool, uint32_t *storage, uint32_t blockSize, uint32_t blocks);
+
+/*
+ * Takes a block from a pool
+ * Param "pool": pool to allocate from
+ * Returns: the block, or 0 if the pool is exhausted
+ */
+void * G8RTOS_PoolAlloc(mem_pool_t *pool);
+
+/*
+ * Gives a block back to the pool it came from
+ * Param "pool": pool the block was allocated from
+ * Param "block": block to free, 0 is ignored
+ */
+void G8RTOS_PoolFree(mem_pool_t *pool, void *block);
+
+/*
+ * Clears a pool's statistics. The low-water mark restarts at the current free count.
+ * Param "pool": pool to reset
+ */
+void G8RTOS_ResetPoolStats(mem_pool_t *pool);
+
+/*
+ * Prints a pool's statistics to the back channel UART
+ * Param "name": label printed before the values
+ * Param "pool": pool to print
+ */
+void G8RTOS_PrintPoolStats(const char *name, mem_pool_t *pool);
+
+/*********************************************** Public Functions *********************************************************************/
+
+#endif /* G8RTOS_G8RTOS_MEMPOOL_H_ */
@@ -10,6 +10,14 @@
  *
  *  OPT  -  Automatically sorts the priority of threads on AddThread.
  *          Manages highest priority thread with head thread pointer.
+ *          Threads of one priority take turns of a time slice set per
+ *          priority (G8RTOS_SetQuantum), and aging checks one thread per
+ *          tick so low priority threads can't starve.
+ *
+ *  BITMAP - Keeps the sorted list from OPT, but also keeps one ready list
+ *          per priority level and a two level bitmap of the non-empty
+ *          lists. The next thread is picked with count leading zeros, so
+ *          the cost of a switch does not grow with the number of threads.
  *
  * -------------------------------------------------------------------------
  */
@@ -26,29 +34,33 @@
  */
 extern void G8RTOS_Start();
 
-// ID counter to produce unique thread ID's
-static uint16_t IDCounter;
-
 /* System Core Clock From system_msp432p401r.c */
 extern uint32_t SystemCoreClock;
 
 /*
  * Pointer to the currently running Thread Control Block
  */
-#ifdef OPT
+#if defined OPT || defined BITMAP
 tcb_t * head;
 #endif
 
 extern tcb_t * CurrentlyRunningThread;
-ptcb_t * CurrentlyRunningPeriodicThread;
 
 /*********************************************** Dependencies and Externs *************************************************************/
 
 
 /*********************************************** Defines ******************************************************************************/
 
+/* Cycles since the current tick was due */
+#ifdef G8RTOS_HOST
+#define TICK_ELAPSED()      G8RTOS_HostTickElapsed()
+#else
+#define TICK_ELAPSED()      (SysTick->LOAD - SysTick->VAL)
+#endif
+
 /* Status Register with the Thumb-bit Set */
 #define THUMBBIT 0x01000000
+#define EXC_RETURN_THREAD 0xFFFFFFF9    // thread mode, main stack, no FPU state
 
 /*********************************************** Defines ******************************************************************************/
 
@@ -60,16 +72,84 @@ ptcb_t * CurrentlyRunningPeriodicThread;
  */
 static tcb_t threadControlBlocks[MAX_THREADS];
 
-/* Thread Stacks
- *	- An array of arrays that will act as invdividual stacks for each thread
+/* Stack Pool
+ *  - Every thread stack is carved out of this pool in STACK_CHUNK word pieces
+ *  - StackChunkMap has one bit per chunk, set while the chunk is in use
+ *  - Stacks are filled with STACK_CANARY so the high-water mark can be found later
+ */
+#define STACK_CHUNKS    (STACK_POOL_SIZE / STACK_CHUNK)
+static int32_t StackPool[STACK_POOL_SIZE];
+static uint32_t StackChunkMap[(STACK_CHUNKS + 31) / 32];
+
+/* Fallback Idle Thread
+ *  - Not part of the tcb list and can't be killed
+ *  - Runs whenever every thread in the list is asleep or blocked, so
+ *    the scheduler never has to hand the CPU to a sleeping thread
  */
-static int32_t threadStacks[MAX_THREADS][STACKSIZE];
+static tcb_t IdleTcb;
 
 /* Periodic Event Threads
  * - An array of periodic events to hold pertinent information for each thread
  */
 static ptcb_t Pthread[MAXPTHREADS];
 
+/* Periodic Event Heap
+ *  - Min-heap of the events in Pthread ordered by exec_time, so the
+ *    next event due is always PeriodicHeap[0]
+ *  - Holds NumberOfPthreads entries
+ */
+static ptcb_t * PeriodicHeap[MAXPTHREADS];
+
+#ifdef OPT
+/* Time Slices
+ *  - Ticks a thread of each priority runs before the next ready thread
+ *    of the same priority gets a turn
+ *  - DEF_QUANT_COUNT until changed with G8RTOS_SetQuantum
+ */
+static uint8_t QuantumTicks[NUM_PRIORITIES];
+
+/* Aging
+ *  - AgingSlot is the tcb slot SysTick checks for starvation next
+ *  - Starved is the one thread boosted to DONT_STARVE_PRIORITY, 0 if none
+ */
+static uint32_t AgingSlot;
+static tcb_t * Starved;
+#endif
+
+#ifdef BITMAP
+/* Ready Lists
+ *  - One circular list of ready threads for each priority level
+ *  - ReadyGroup bit (31 - n) is set when any priority in 32*n .. 32*n+31 is ready
+ *  - ReadyMap[n] bit (31 - (priority & 31)) is set when that priority's list is not empty
+ *  - Leading zero counts on both words give the highest ready priority (lowest number)
+ */
+static tcb_t * ReadyList[NUM_PRIORITIES];
+static uint32_t ReadyMap[NUM_PRIORITIES >> 5];
+static uint32_t ReadyGroup;
+#endif
+
+/* Sleep List
+ *  - Singly linked list of sleeping threads sorted by wake up time (sleep_count)
+ *  - SysTick only looks at the front of the list, so a tick costs nothing
+ *    for threads that are still sleeping
+ */
+static tcb_t * SleepList;
+
+#ifdef BENCH_SCHEDULER
+/* Cycles spent in G8RTOS_Scheduler_Priority per context switch */
+cycle_stat_t SchedulerCycles;
+#endif
+
+#ifdef BENCH_TICK
+/* Cycles spent in SysTick_Handler per tick */
+cycle_stat_t TickCycles;
+#endif
+
+#ifdef BENCH_KILL
+/* Cycles G8RTOS_KillAllOthers keeps interrupts masked */
+cycle_stat_t KillAllCycles;
+#endif
+
 /*********************************************** Data Structures Used *****************************************************************/
 
 
@@ -80,6 +160,12 @@ static ptcb_t Pthread[MAXPTHREADS];
  */
 static uint32_t NumberOfThreads;
 
+/*
+ * Generation of each tcb slot, bumped every time a thread is added to
+ * it. Never cleared, so an id can't come back while its slot is reused.
+ */
+static uint32_t SlotGeneration[MAX_THREADS];
+
 /*
  * Current Number of Periodic Threads currently in the scheduler
  */
@@ -88,6 +174,15 @@ static uint32_t NumberOfPthreads;
 /* Holds the current time for the whole System */
 uint32_t SystemTime;
 
+/* Number of SysTick clock cycles in one 1 ms system tick */
+static uint32_t CyclesPerTick;
+
+/* Idle and busy time bookkeeping for G8RTOS_GetCpuUsage */
+static uint64_t IdleCycles;
+static uint32_t IdleSleeps;
+static uint32_t SuppressedTicks;
+static uint32_t UsageStartTime;
+
 extern void PendSV_Handler(void);
 
 /*********************************************** Private Variables ********************************************************************/
@@ -102,11 +197,362 @@ extern void PendSV_Handler(void);
  */
 static void InitSysTick(void)
 {
+#ifdef G8RTOS_HOST
+    CyclesPerTick = HOST_NS_PER_TICK;               // the host port's timer is already running
+#else
     uint32_t clockSysFreq = ClockSys_GetSysFreq();  // find system clock frequency*************
-    SysTick_Config(clockSysFreq/1000);                // configure interrupt to 1ms
+    CyclesPerTick = clockSysFreq/1000;
+    SysTick_Config(CyclesPerTick);                    // configure interrupt to 1ms
     SysTick_enableInterrupt();                      // enable interrupt at normal level priority
+#endif
 };
 
+/* Priority scheduler algorithm selected by the ORIG / OPT / BITMAP directive */
+static void SelectNextThread(void);
+
+#ifdef OPT
+/* Checks one tcb slot for a starved thread every tick */
+static void AgeNextThread(void);
+#endif
+
+/*
+ * Returns true once SystemTime has reached the given tick.
+ * Compares the signed difference so it keeps working when SystemTime wraps.
+ */
+static inline bool TimeReached(uint32_t tick)
+{
+    return (int32_t)(SystemTime - tick) >= 0;
+}
+
+/*
+ * Returns true if the thread is alive, awake and not blocked
+ */
+static inline bool CanRun(tcb_t *thread)
+{
+    return thread->alive && thread->asleep == 0 && thread->blocked == 0;
+}
+
+/*
+ * Adds a thread to the sleep list in wake up order. Threads that
+ * wake on the same tick stay in the order they went to sleep.
+ * Must be called inside a critical section.
+ */
+static void SleepInsert(tcb_t *thread)
+{
+    tcb_t **link = &SleepList;
+
+    while ( *link != 0 && (int32_t)((*link)->sleep_count - thread->sleep_count) <= 0 )
+        link = &(*link)->sleep_next;
+
+    thread->sleep_next = *link;
+    *link = thread;
+}
+
+/*
+ * Takes a thread off the sleep list (used when a sleeping thread is killed).
+ * Must be called inside a critical section.
+ */
+static void SleepRemove(tcb_t *thread)
+{
+    tcb_t **link = &SleepList;
+
+    while ( *link != 0 && *link != thread )
+        link = &(*link)->sleep_next;
+
+    if ( *link != 0 )
+        *link = thread->sleep_next;
+
+    thread->sleep_next = 0;
+}
+
+/*
+ * Returns true if event a is due before event b.
+ * Compares the signed difference so it keeps working when exec_time wraps.
+ */
+static inline bool PeriodicBefore(ptcb_t *a, ptcb_t *b)
+{
+    return (int32_t)(a->exec_time - b->exec_time) < 0;
+}
+
+/*
+ * Stores an event in a heap slot and remembers the slot in the event
+ */
+static inline void HeapSet(uint32_t i, ptcb_t *event)
+{
+    PeriodicHeap[i] = event;
+    event->heap_index = i;
+}
+
+/*
+ * Moves the event in slot i up until its parent is due before it.
+ * Must be called inside a critical section.
+ */
+static void HeapSiftUp(uint32_t i)
+{
+    ptcb_t *event = PeriodicHeap[i];
+
+    while ( i > 0 )
+    {
+        uint32_t parent = (i - 1) >> 1;
+        if ( !PeriodicBefore(event, PeriodicHeap[parent]) )
+            break;
+
+        HeapSet(i, PeriodicHeap[parent]);
+        i = parent;
+    }
+
+    HeapSet(i, event);
+}
+
+/*
+ * Moves the event in slot i down until both children are due after it.
+ * Must be called inside a critical section.
+ */
+static void HeapSiftDown(uint32_t i)
+{
+    ptcb_t *event = PeriodicHeap[i];
+
+    while ( 1 )
+    {
+        uint32_t child = (i << 1) + 1;
+        if ( child >= NumberOfPthreads )
+            break;
+
+        // pick the child that is due first
+        if ( child + 1 < NumberOfPthreads && PeriodicBefore(PeriodicHeap[child + 1], PeriodicHeap[child]) )
+            child++;
+
+        if ( !PeriodicBefore(PeriodicHeap[child], event) )
+            break;
+
+        HeapSet(i, PeriodicHeap[child]);
+        i = child;
+    }
+
+    HeapSet(i, event);
+}
+
+/*
+ * Takes the first run of free chunks big enough for "words" out of the
+ * stack pool and fills it with the canary pattern.
+ * Must be called inside a critical section.
+ * Returns: lowest address of the stack, 0 if the pool has no room
+ */
+static int32_t * StackAlloc(uint32_t words)
+{
+    uint32_t chunks = (words + STACK_CHUNK - 1) / STACK_CHUNK;
+    uint32_t run = 0;
+
+    for (uint32_t i = 0; i < STACK_CHUNKS; i++)
+    {
+        if ( StackChunkMap[i >> 5] & (1u << (i & 31)) )
+        {
+            run = 0;
+            continue;
+        }
+
+        if ( ++run == chunks )
+        {
+            uint32_t first = i + 1 - chunks;
+            for (uint32_t j = first; j <= i; j++)
+                StackChunkMap[j >> 5] |= 1u << (j & 31);
+
+            int32_t *stack = &StackPool[first * STACK_CHUNK];
+            for (uint32_t j = 0; j < chunks * STACK_CHUNK; j++)
+                stack[j] = STACK_CANARY;
+
+            return stack;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Gives a stack's chunks back to the pool.
+ * Must be called inside a critical section.
+ */
+static void StackFree(int32_t *stack, uint32_t words)
+{
+    uint32_t first = (stack - StackPool) / STACK_CHUNK;
+
+    for (uint32_t j = first; j < first + words / STACK_CHUNK; j++)
+        StackChunkMap[j >> 5] &= ~(1u << (j & 31));
+}
+
+/*
+ * Returns the most words a thread has ever had on its stack. Stacks
+ * grow down, so this counts the untouched canary words at the bottom.
+ */
+static uint32_t StackUsed(tcb_t *thread)
+{
+    uint32_t unused = 0;
+
+    while ( unused < thread->stack_size && thread->stack[unused] == STACK_CANARY )
+        unused++;
+
+    return thread->stack_size - unused;
+}
+
+#ifndef G8RTOS_HOST
+/*
+ * Builds the "fake context" a new thread is started from at the top
+ * of its stack and returns the stack pointer to store in its tcb.
+ * New threads start without FPU state. PendSV saves S16-S31 (and the
+ * hardware stacks S0-S15) only once a thread has used the FPU, which
+ * costs it 34 more words of stack.
+ * Param "stackEnd": one past the last word of the stack
+ */
+static int32_t * InitStackFrame(int32_t *stackEnd, void (*threadToAdd)(void))
+{
+    stackEnd[-1] = THUMBBIT;                    // thumb bit
+    stackEnd[-2] = (uint32_t)threadToAdd;       // PC value for the function
+    stackEnd[-3] = 0x14141414;                  // R14
+    stackEnd[-4] = 0x12121212;                  // R12
+    stackEnd[-5] = 0x03030303;                  // R3    -- function parameters
+    stackEnd[-6] = 0x02020202;                  // R2    -- function parameters
+    stackEnd[-7] = 0x01010101;                  // R1    -- function parameters
+    stackEnd[-8] = 0x00000000;                  // R0    -- function parameters
+    stackEnd[-9] = EXC_RETURN_THREAD;           // EXC_RETURN PendSV returns with
+    stackEnd[-10] = 0x11111111;                 // R11
+    stackEnd[-11] = 0x10101010;                 // R10
+    stackEnd[-12] = 0x09090909;                 // R9
+    stackEnd[-13] = 0x08080808;                 // R8
+    stackEnd[-14] = 0x07070707;                 // R7
+    stackEnd[-15] = 0x06060606;                 // R6
+    stackEnd[-16] = 0x05050505;                 // R5
+    stackEnd[-17] = 0x04040404;                 // R4
+
+    return &stackEnd[-17];
+}
+#endif
+
+/*
+ * Entry point of the fallback idle thread
+ */
+static void KernelIdle(void)
+{
+    while(1)
+    {
+        G8RTOS_Idle();
+    }
+}
+
+/*
+ * Blocks the current thread until SystemTime reaches wakeTime.
+ * Must be called inside a critical section. The switch happens as
+ * soon as interrupts are enabled again, and the scheduler won't pick
+ * the thread until SysTick takes it off the sleep list.
+ */
+static void BlockUntil(uint32_t wakeTime)
+{
+    CurrentlyRunningThread->sleep_count = wakeTime;
+    CurrentlyRunningThread->asleep = 0x1;
+    G8RTOS_ReadyRemove(CurrentlyRunningThread);
+    SleepInsert(CurrentlyRunningThread);
+    StartContextSwitch();
+}
+
+#ifdef TICKLESS
+/*
+ * Returns the number of ticks until the next sleeping thread or periodic
+ * event is due, limited to what one SysTick period (24 bits) can hold.
+ * Must be called inside a critical section.
+ */
+static uint32_t TicksUntilNextEvent(void)
+{
+    uint32_t ticks = (SysTick_LOAD_RELOAD_Msk / CyclesPerTick) - 1;
+
+    if ( SleepList != 0 && SleepList->sleep_count - SystemTime < ticks )
+        ticks = SleepList->sleep_count - SystemTime;
+
+    if ( NumberOfPthreads > 0 && PeriodicHeap[0]->exec_time - SystemTime < ticks )
+        ticks = PeriodicHeap[0]->exec_time - SystemTime;
+
+    return ticks;
+}
+
+/*
+ * Stretches the current SysTick period to end on the tick that is
+ * idleTicks away, sleeps, then puts SysTick back on 1 ms ticks. Ticks
+ * that went by without an interrupt are added to SystemTime here.
+ * Must be called inside a critical section.
+ * Returns: cycles spent asleep
+ */
+static uint32_t SuppressedSleep(uint32_t idleTicks)
+{
+    uint32_t elapsed;
+
+    // cycles left in the tick that is running now
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+    uint32_t remaining = SysTick->VAL;
+    if ( remaining == 0 )
+        remaining = CyclesPerTick;
+
+    // the last tick of the sleep is left to the SysTick interrupt
+    uint32_t sleepCycles = remaining + (idleTicks - 1) * CyclesPerTick;
+    SysTick->LOAD = sleepCycles - 1;
+    SysTick->VAL = 0;                           // reload now + clear COUNTFLAG
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+
+    __DSB();
+    __WFI();
+
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+
+    if ( SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk )
+    {
+        // slept the whole way. The SysTick interrupt is pending and counts
+        // the last tick when the critical section ends.
+        elapsed = sleepCycles;
+        SystemTime += idleTicks - 1;
+        SuppressedTicks += idleTicks - 1;
+
+        SysTick->LOAD = CyclesPerTick - 1;
+        SysTick->VAL = 0;
+        SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+    }
+    else
+    {
+        // another interrupt woke the CPU up early. Count the ticks that
+        // already went by and line SysTick up with the next tick edge.
+        uint32_t nextTick;
+        elapsed = (sleepCycles - 1) - SysTick->VAL;
+
+        if ( elapsed < remaining )
+        {
+            nextTick = remaining - elapsed;
+        }
+        else
+        {
+            uint32_t ticks = 1 + (elapsed - remaining) / CyclesPerTick;
+            nextTick = CyclesPerTick - (elapsed - remaining) % CyclesPerTick;
+            SystemTime += ticks;
+            SuppressedTicks += ticks;
+        }
+
+        if ( nextTick > 1 )
+        {
+            SysTick->LOAD = nextTick - 1;
+            SysTick->VAL = 0;
+            SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+            SysTick->LOAD = CyclesPerTick - 1;  // used from the reload after the next tick
+        }
+        else
+        {
+            // a LOAD of 0 never raises the interrupt. The edge is a cycle
+            // away, so pend the tick now and start the next one whole.
+            SCB->ICSR |= SCB_ICSR_PENDSTSET_Msk;
+            SysTick->LOAD = CyclesPerTick - 1;
+            SysTick->VAL = 0;
+            SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+        }
+    }
+
+    return elapsed;
+}
+#endif
+
 /*
  * Chooses the next thread to run.
  * Lab 2 Scheduling Algorithm:
@@ -123,7 +569,7 @@ void G8RTOS_Scheduler(void)
 
 // Scheduling algorithm using priority instead of round robin
 #if defined ORIG
-void G8RTOS_Scheduler_Priority(void)
+static void SelectNextThread(void)
 {
     uint8_t max_priority = 255;
     tcb_t* tempThreadPtr = CurrentlyRunningThread;
@@ -149,7 +595,9 @@ void G8RTOS_Scheduler_Priority(void)
 
             // Because only one thread should ever change its priority due to starvation
             // at a time, I can immediately run the starved thread and reset it to orig priority
-            if ( CurrentlyRunningThread->priority < CurrentlyRunningThread->priority_perm )
+            // (a priority raised by a mutex is kept until the mutex is released)
+            if (    CurrentlyRunningThread->priority < CurrentlyRunningThread->priority_perm
+                &&  CurrentlyRunningThread->mutexes_held == 0 )
             {
                 CurrentlyRunningThread->priority = CurrentlyRunningThread->priority_perm;
                 break;
@@ -183,44 +631,75 @@ void G8RTOS_Scheduler_Priority(void)
  */
 void SysTick_Handler()
 {
+#ifdef BENCH_TICK
+    uint32_t start = G8RTOS_CYCLES();
+#endif
+    TRACE_ISR_ENTER();
 
     // increment the system time
     SystemTime++;
 
-    // check each ptcb to see if the system time is equal to the periodic
-    // count. If it is, run the Pthread
-    for (int i = 0; i < NumberOfPthreads; i++)
+    // run every periodic event that is due. The heap keeps the next
+    // event due on top, so the first one that isn't due ends the loop.
+    while ( NumberOfPthreads > 0 && TimeReached(PeriodicHeap[0]->exec_time) )
     {
-        CurrentlyRunningPeriodicThread = CurrentlyRunningPeriodicThread->next;
+        ptcb_t* event = PeriodicHeap[0];
+        void (*handler)(void) = event->handler;
+
+        // release delay: whole ticks late plus how far into this tick the handler starts
+        uint32_t start = G8RTOS_CYCLES();
+        G8RTOS_RecordCycleStat( &event->release_delay,
+                (SystemTime - event->exec_time) * CyclesPerTick + TICK_ELAPSED() );
 
-        // run the periodic function if it meets the correct system time
-        if ( CurrentlyRunningPeriodicThread->exec_time <= SystemTime )
+        handler();
+        G8RTOS_RecordCycleStat(&event->exec_cycles, G8RTOS_CYCLES() - start);
+
+        // the handler may have killed its own event
+        if ( event->handler != handler )
+            continue;
+
+        // stay on the period grid. If a whole period was missed, skip
+        // the missed releases instead of running them back to back.
+        event->exec_time += event->period;
+        if ( TimeReached(event->exec_time) )
         {
-            CurrentlyRunningPeriodicThread->exec_time = SystemTime + CurrentlyRunningPeriodicThread->period;
-            CurrentlyRunningPeriodicThread->handler();
+            event->overruns++;
+            event->exec_time = SystemTime + event->period;
         }
+        HeapSiftDown(event->heap_index);
     }
 
-    // check each tcb to see if system time equals sleep-count. Wake up.
-    // Because this goes to the number of threads, the linked list should
-    // wrap all the way back around to the beginning.
+    // wake up every thread at the front of the sleep list whose
+    // sleep-count has been reached. The list is sorted, so the first
+    // thread that is still sleeping ends the search.
     // NOTE: CONTEXT NEVER SWITCHES HERE
-    for (int i = 0; i <  NumberOfThreads; i++)
+    while ( SleepList != 0 && TimeReached(SleepList->sleep_count) )
     {
-        // check the next thread's data
-        CurrentlyRunningThread = CurrentlyRunningThread->next;
+        tcb_t* wakeThread = SleepList;
+        SleepList = wakeThread->sleep_next;
 
-        // clear the sleep statement if it is the correct time
-        if ( CurrentlyRunningThread->sleep_count <= SystemTime )
-        {
-            CurrentlyRunningThread->asleep = 0x0;
-            CurrentlyRunningThread->sleep_count = 0x0;
-        }
+        wakeThread->sleep_next = 0;
+        wakeThread->asleep = 0x0;
+        wakeThread->sleep_count = 0x0;
+        G8RTOS_ReadyInsert(wakeThread);
     }
 
+#ifdef OPT
+    // the running thread used up one more tick of its time slice
+    if ( CurrentlyRunningThread->quantum > 0 )
+        CurrentlyRunningThread->quantum--;
+
+    AgeNextThread();
+#endif
+
     // trigger the PendSV interrupt to switch context
     // after running periodic threads + waking threads
     StartContextSwitch();
+
+    TRACE_ISR_EXIT();
+#ifdef BENCH_TICK
+    G8RTOS_RecordCycleStat(&TickCycles, G8RTOS_CYCLES() - start);
+#endif
 }
 
 /*
@@ -230,16 +709,75 @@ void SysTick_Handler()
 void G8RTOS_Init()
 {
     // variable init ------------------------------------
-    IDCounter = 0;
     SystemTime = 0;         // initialize system time to 0
     NumberOfThreads = 0;    // set the number of threads to 0
     NumberOfPthreads = 0;
+    for (int i = 0; i < MAXPTHREADS; i++)
+        Pthread[i].handler = 0;
+    SleepList = 0;
+    IdleCycles = 0;
+    IdleSleeps = 0;
+    SuppressedTicks = 0;
+    UsageStartTime = 0;
+
+    for (uint32_t i = 0; i < sizeof(StackChunkMap) / sizeof(StackChunkMap[0]); i++)
+        StackChunkMap[i] = 0;
+
+#ifdef OPT
+    for (int i = 0; i < NUM_PRIORITIES; i++)
+        QuantumTicks[i] = DEF_QUANT_COUNT;
+    AgingSlot = 0;
+    Starved = 0;
+#endif
+
+    // fallback idle thread. Its next and prev are pointed into the
+    // tcb list whenever it is switched to.
+    IdleTcb.stack = StackAlloc(IDLE_STACKSIZE);
+    IdleTcb.stack_size = (IDLE_STACKSIZE + STACK_CHUNK - 1) / STACK_CHUNK * STACK_CHUNK;
+#ifdef G8RTOS_HOST
+    G8RTOS_HostInitContext(&IdleTcb, &KernelIdle);
+#else
+    IdleTcb.sp = InitStackFrame(IdleTcb.stack + IdleTcb.stack_size, &KernelIdle);
+#endif
+    IdleTcb.priority = 255;
+    IdleTcb.priority_perm = 255;
+    IdleTcb.alive = true;
+    IdleTcb.starvation_age = 0xFFFFFFFF;
+    for (int i = 0; i < MAX_NAME_LENGTH; i++)
+        IdleTcb.name[i] = "KERNEL_IDLE_____"[i];
+
     BSP_InitBoard();        // initialize all hardware on the board
+    G8RTOS_InitCycleCounter();
+#ifdef G8RTOS_TRACE
+    G8RTOS_InitTrace();
+#endif
+
+#ifdef G8RTOS_HOST
+    G8RTOS_HostInit();
+#else
+    // FPU on, with lazy stacking so S0-S15 are only saved for threads that use it
+    SCB->CPACR |= (0xF << 20);                                  // CP10 and CP11 full access
+    FPU->FPCCR |= FPU_FPCCR_ASPEN_Msk | FPU_FPCCR_LSPEN_Msk;
+    __DSB();
+    __ISB();
+#endif
+
+#ifdef BENCH_SCHEDULER
+    G8RTOS_ResetCycleStat(&SchedulerCycles);
+#endif
+#ifdef BENCH_TICK
+    G8RTOS_ResetCycleStat(&TickCycles);
+#endif
+#ifdef BENCH_KILL
+    G8RTOS_ResetCycleStat(&KillAllCycles);
+#endif
 
+#ifndef G8RTOS_HOST
     // move interrupt vector into SRAM ------------------
     uint32_t newVTORTable = 0x20000000;
     memcpy( (uint32_t*)newVTORTable, (uint32_t*)SCB->VTOR, 57*4); //57 int vectors to copy
     SCB->VTOR = newVTORTable;
+#endif
 }
 
 /*
@@ -250,7 +788,6 @@ void G8RTOS_Init()
  */
 int G8RTOS_Launch()
 {
-    CurrentlyRunningPeriodicThread = &Pthread[0];     // set the first periodic event even if there is no data yet
     CurrentlyRunningThread = &threadControlBlocks[0]; // set the first tcb as the currently running thread
     InitSysTick();
 
@@ -258,6 +795,7 @@ int G8RTOS_Launch()
     NVIC_SetPriority(SysTick_IRQn, 7);  // set SysTick to low priority
     NVIC_SetPriority(PendSV_IRQn, 7);   // set PendSV to low priority
 
+    threadControlBlocks[0].switch_in_time = G8RTOS_CYCLES();
     G8RTOS_Start(&threadControlBlocks[0]); // load the first thread and jump to program + interrupts enabled
     return -1;      // scheduler failed
 }
@@ -276,8 +814,6 @@ sched_err_code_t G8RTOS_Launch_Priority()
     }
     else
     {
-        ptcb_t* maxPThread = &Pthread[0];
-
 #ifdef ORIG
         uint8_t max_thread_priority = 255;
         tcb_t* tempThread = &threadControlBlocks[0];
@@ -295,12 +831,11 @@ sched_err_code_t G8RTOS_Launch_Priority()
             tempThread = tempThread->next;
         }
 #endif
-#ifdef OPT
+#if defined OPT || defined BITMAP
         tcb_t* maxThread = head;
 #endif
 
         // set the currently running threads based on priority
-        CurrentlyRunningPeriodicThread = maxPThread;
         CurrentlyRunningThread = maxThread;
         InitSysTick();
 
@@ -308,106 +843,163 @@ sched_err_code_t G8RTOS_Launch_Priority()
         NVIC_SetPriority(SysTick_IRQn, 7);  // set SysTick to low priority
         NVIC_SetPriority(PendSV_IRQn, 7);   // set PendSV to low priority
 
+        maxThread->switch_in_time = G8RTOS_CYCLES();
         G8RTOS_Start(maxThread);  // load the first thread and jump to program + interrupts enabled
         return THREAD_LIMIT_REACHED;
     }
 }
 
+/*
+ * Takes a live thread out of the scheduler: off the ready, sleep and
+ * wait lists, out of the tcb list, stack back to the pool. Switches
+ * away if it is the running thread. Must be called inside a critical section.
+ */
+static void KillTcb(tcb_t *tempTcb)
+{
+    // stops this tcb from being used again.
+    // force to be the lowest priority so the
+    // PendSV handler is allowed to switch if there
+    // are no other high priority threads to kill
+    G8RTOS_ReadyRemove(tempTcb);
+    if ( tempTcb->asleep )
+        SleepRemove(tempTcb);
+
+#ifdef OPT
+    if ( Starved == tempTcb )
+        Starved = 0;
+#endif
+
+    // a thread killed while waiting on a semaphore or mutex
+    // gives up its place in the queue and the count
+    if ( tempTcb->blocked != 0 )
+    {
+        G8RTOS_WaitQueueRemove(tempTcb->blocked, tempTcb);
+        tempTcb->blocked->count++;
+        tempTcb->blocked = 0;
+    }
+
+    // mutexes it owns go to their next waiters, and owners it was
+    // lending its priority to get theirs back
+    G8RTOS_MutexThreadKilled(tempTcb);
+    // give the stack back. A thread killing itself keeps running on
+    // it until the switch, which can't reach AddThread first.
+    StackFree(tempTcb->stack, tempTcb->stack_size);
+    tempTcb->stack = 0;
+
+    TRACE(TRACE_THREAD_KILL, G8RTOS_ThreadSlot(tempTcb));
+
+    tempTcb->priority = 255;    // min priority to allow thread deletion
+    tempTcb->asleep = 0;
+    tempTcb->id = 0;
+    tempTcb->alive = false;
+    NumberOfThreads--;
+
+    // if this is the head pointer, redefine the
+    // head pointer
+#if defined OPT || defined BITMAP
+    if (tempTcb == head)
+        head = head->next;
+#endif
+
+    // update next + previous tcb pointers to point at each other
+    if (tempTcb == CurrentlyRunningThread){
+        StartContextSwitch();
+    }
+    tempTcb->next->prev = tempTcb->prev;
+    tempTcb->prev->next = tempTcb->next;
+}
+
 // KillThread function takes in a threadId and removes it from the linked list
 // of threads
-
-uint8_t threadNUM = 0;
 sched_err_code_t G8RTOS_KillThread( threadId_t id )
 {
     uint32_t primask = StartCriticalSection();
     // variable declaration
     sched_err_code_t err = NO_ERROR;
-    tcb_t* tempTcb = CurrentlyRunningThread;
+    tcb_t* tempTcb = G8RTOS_FindThread(id);
 
     // Cannot kill a thread if it is the only one available
     // because the OS will end
     if ( NumberOfThreads == 1 )
         err = CANNOT_KILL_LAST_THREAD;
 
-    // if enough threads exist to kill this one, continue
-    else
-    {
-        // search for requested thread ID + set error code
-        for (int i = 0; i < MAX_THREADS; ++i)
-        {
-            // id was found
-            if ( tempTcb->id == id && tempTcb->alive )
-            {
-                threadNUM = i;
-                err = NO_ERROR;
-                break;
-            }
-
-            // id was not found
-            else
-            {
-                err = THREAD_DOES_NOT_EXIST;
-                tempTcb = tempTcb->next;
-            }
-        }
+    // if the thread exists, continue.. otherwise,  exit
+    else if ( tempTcb == 0 )
+        err = THREAD_DOES_NOT_EXIST;
 
-        // if the thread exists, continue.. otherwise,  exit
-        if ( err != THREAD_DOES_NOT_EXIST )
-        {
-            // stops this tcb from being used again.
-            // force to be the lowest priority so the
-            // PendSV handler is allowed to switch if there
-            // are no other high priority threads to kill
-            tempTcb->priority = 255;    // min priority to allow thread deletion
-            tempTcb->asleep = 0;
-            tempTcb->id = 0;
-            tempTcb->alive = false;
-            NumberOfThreads--;
-
-            // if this is the head pointer, redefine the
-            // head pointer
-#ifdef OPT
-            if (tempTcb == head)
-                head = head->next;
-#endif
+    else
+        KillTcb(tempTcb);
 
-            // update next + previous tcb pointers to point at each other
-            if (tempTcb == CurrentlyRunningThread){
-                StartContextSwitch();
-            }
-            tempTcb->next->prev = tempTcb->prev;
-            tempTcb->prev->next = tempTcb->next;
-            //tempTcb->next = 0;
-            //tempTcb->prev = 0;
-            //tempTcb->sp = EmptyStruct.sp;
-        }
-    }
     EndCriticalSection(primask);
     __enable_interrupts();
 
     return err;
 }
 
+// kills every thread except the caller and persistent threads in one
+// pass over the tcb slots, without leaving the critical section
 void G8RTOS_KillAllOthers()
 {
     uint32_t primask = StartCriticalSection();
-    tcb_t currentThread = *CurrentlyRunningThread;
+#ifdef BENCH_KILL
+    uint32_t start = G8RTOS_CYCLES();
+#endif
+
     for (int i = 0; i < MAX_THREADS; i++)
     {
-        if ( currentThread.id != threadControlBlocks[i].id){
-            sched_err_code_t err = G8RTOS_KillThread(threadControlBlocks[i].id);
-        }
+        tcb_t *thread = &threadControlBlocks[i];
+
+        // persistent threads (the worker pool) outlive every round of the game
+        if ( thread->alive && thread != CurrentlyRunningThread && !thread->persistent )
+            KillTcb(thread);
     }
 
+#ifdef BENCH_KILL
+    G8RTOS_RecordCycleStat(&KillAllCycles, G8RTOS_CYCLES() - start);
+#endif
     EndCriticalSection(primask);
+    __enable_interrupts();
 }
 
-// a thread calls the KillSelf function to send its own ID to the KillThread
-// function
-sched_err_code_t G8RTOS_KillSelf()
+// returns the live tcb with this id, 0 if there isn't one. The slot
+// in the id finds the tcb, the whole id has to match so a stale id from
+// a killed thread never finds the thread now using its slot.
+tcb_t * G8RTOS_FindThread(threadId_t id)
 {
-    uint32_t primask = StartCriticalSection();
-    sched_err_code_t err = G8RTOS_KillThread( CurrentlyRunningThread->id );
+    uint32_t slot = THREAD_ID_SLOT(id);
+
+    if ( slot >= MAX_THREADS )
+        return 0;
+
+    tcb_t *thread = &threadControlBlocks[slot];
+    if ( thread->alive && thread->id == id )
+        return thread;
+    return 0;
+}
+
+// tcb slot of a thread, used to label trace records
+uint8_t G8RTOS_ThreadSlot(tcb_t *thread)
+{
+    if ( thread == 0 )
+        return TRACE_THREAD_NONE;
+    if ( thread == &IdleTcb )
+        return TRACE_THREAD_IDLE;
+    return (uint8_t)(thread - threadControlBlocks);
+}
+
+// marks the calling thread as persistent so G8RTOS_KillAllOthers leaves
+// it alive. G8RTOS_KillThread and G8RTOS_KillSelf still kill it.
+void G8RTOS_MakePersistent()
+{
+    CurrentlyRunningThread->persistent = true;
+}
+
+// a thread calls the KillSelf function to send its own ID to the KillThread
+// function
+sched_err_code_t G8RTOS_KillSelf()
+{
+    uint32_t primask = StartCriticalSection();
+    sched_err_code_t err = G8RTOS_KillThread( CurrentlyRunningThread->id );
     EndCriticalSection(primask);
     return err;
 }
@@ -489,7 +1081,7 @@ threadId_t G8RTOS_GetThreadId()
 // quantum count of 1
 sched_err_code_t G8RTOS_AddThread__Def_Starvation(void (*threadToAdd)(void), uint8_t priority, char * name)
 {
-    sched_err_code_t ret = G8RTOS_AddThread( threadToAdd, priority, DONT_STARVE_AGE, name);
+    sched_err_code_t ret = G8RTOS_AddThread( threadToAdd, priority, DONT_STARVE_AGE, STACKSIZE, name);
     return ret;
 }
 
@@ -502,11 +1094,13 @@ sched_err_code_t G8RTOS_AddThread__Def_Starvation(void (*threadToAdd)(void), uin
  *  - Sets up the next and previous tcb pointers in a round robin fashion
  *  - Starvation age is the number of SysTicks the thread has not run before
  *      temporary priority is auto boosted to high priority (currently level 10).
+ *  - The stack is taken from the stack pool, rounded up to STACK_CHUNK words
  * Param "threadToAdd": Void-Void Function to add as preemptable main thread
+ * Param "stackSize": stack size in words
  * Returns: Error code for adding threads
  */
 sched_err_code_t G8RTOS_AddThread(    void (*threadToAdd)(void), uint8_t priority,
-                         uint32_t starvation_age, char * name          )
+                         uint32_t starvation_age, uint32_t stackSize, char * name )
 {
     int32_t primask = StartCriticalSection();
 
@@ -522,47 +1116,68 @@ sched_err_code_t G8RTOS_AddThread(    void (*threadToAdd)(void), uint8_t priorit
         else
             return org.err;
 
-        // - Initializes the stack for the provided thread to hold a "fake context"
-        threadStacks[priorityIndex][STACKSIZE - 1] = THUMBBIT;      // thumb bit
-        threadStacks[priorityIndex][STACKSIZE - 2] = (uint32_t)threadToAdd;  // PC value for the function
-        threadStacks[priorityIndex][STACKSIZE - 3] = 0x14141414;    // R14
-        threadStacks[priorityIndex][STACKSIZE - 4] = 0x12121212;    // R12
-        threadStacks[priorityIndex][STACKSIZE - 5] = 0x03030303;    // R3    -- function parameters
-        threadStacks[priorityIndex][STACKSIZE - 6] = 0x02020202;    // R2    -- function parameters
-        threadStacks[priorityIndex][STACKSIZE - 7] = 0x01010101;    // R1    -- function parameters
-        threadStacks[priorityIndex][STACKSIZE - 8] = 0x00000000;    // R0    -- function parameters
-        threadStacks[priorityIndex][STACKSIZE - 9] = 0x11111111;    // R11
-        threadStacks[priorityIndex][STACKSIZE - 10] = 0x10101010;   // R10
-        threadStacks[priorityIndex][STACKSIZE - 11] = 0x09090909;   // R9
-        threadStacks[priorityIndex][STACKSIZE - 12] = 0x08080808;   // R8
-        threadStacks[priorityIndex][STACKSIZE - 13] = 0x07070707;   // R7
-        threadStacks[priorityIndex][STACKSIZE - 14] = 0x06060606;   // R6
-        threadStacks[priorityIndex][STACKSIZE - 15] = 0x05050505;   // R5
-        threadStacks[priorityIndex][STACKSIZE - 16] = 0x04040404;   // R4
+        // - Takes the stack from the pool
+        int32_t *stack = StackAlloc(stackSize);
+        if ( stack == 0 )
+        {
+            EndCriticalSection(primask);
+            __enable_interrupts();
+            return STACK_POOL_EMPTY;
+        }
 
+        // - Initializes the stack for the provided thread to hold a "fake context"
         // - Sets tcb stack pointer to top of thread stack + priority
         tcb_t* tempTCB = &threadControlBlocks[priorityIndex];
-        tempTCB->sp = &threadStacks[priorityIndex][STACKSIZE - 16];
-        //threadControlBlocks[priorityIndex].StackPointer = &threadStacks[priorityIndex][STACKSIZE - 16];//assign first stack pointer for the thread
+        tempTCB->stack = stack;
+        tempTCB->stack_size = (stackSize + STACK_CHUNK - 1) / STACK_CHUNK * STACK_CHUNK;
+#ifdef G8RTOS_HOST
+        G8RTOS_HostInitContext(tempTCB, threadToAdd);
+#else
+        tempTCB->sp = InitStackFrame(stack + tempTCB->stack_size, threadToAdd);
+#endif
         tempTCB->priority = priority;
         tempTCB->priority_perm = priority;
         tempTCB->alive = true;
+        tempTCB->persistent = false;
         tempTCB->age = 0;
+        tempTCB->quantum = 0;
+        tempTCB->max_wait = 0;
         tempTCB->blocked = 0;
+        tempTCB->wait_next = 0;
         tempTCB->starvation_age = starvation_age;
-        tempTCB->id = ((IDCounter++) << 16) | (uint32_t)tempTCB;
+        tempTCB->mutexes_held = 0;
+        tempTCB->mutexes_owned = 0;
+        tempTCB->mutex_wait = 0;
+        tempTCB->notify_bits = 0;
+        tempTCB->notify_wait.count = 0;
+        tempTCB->notify_wait.waiters = 0;
+        tempTCB->asleep = 0;
+        tempTCB->sleep_next = 0;
+        tempTCB->ready_next = 0;
+        tempTCB->ready_prev = 0;
+        tempTCB->run_cycles = 0;
+        tempTCB->switch_in_time = 0;
+        tempTCB->switches = 0;
+        tempTCB->preemptions = 0;
+        tempTCB->blocks = 0;
+        tempTCB->id = (++SlotGeneration[priorityIndex] << THREAD_ID_GEN_SHIFT) | priorityIndex;
 
         // assign the thread's name
         for (int i = 0; i < MAX_NAME_LENGTH; i++)
             tempTCB->name[i] = *(name + i); // could produce bad data -- possibly adjust
 
+#ifdef G8RTOS_TRACE
+        G8RTOS_TraceNameThread(priorityIndex, tempTCB->name);
+        TRACE(TRACE_THREAD_ADD, priorityIndex);
+#endif
+
         // - Sets up the next and previous tcb pointers in circular linked list format
         if (NumberOfThreads == 0)   // First control block creation
         {
             // initialize next/previous for the current(first) control block
             threadControlBlocks[priorityIndex].next = &threadControlBlocks[priorityIndex];
             threadControlBlocks[priorityIndex].prev = &threadControlBlocks[priorityIndex];
-#ifdef OPT
+#if defined OPT || defined BITMAP
             head = &threadControlBlocks[priorityIndex];
 #endif
         }
@@ -572,7 +1187,7 @@ sched_err_code_t G8RTOS_AddThread(    void (*threadToAdd)(void), uint8_t priorit
             threadControlBlocks[priorityIndex].next = org.next;
             threadControlBlocks[priorityIndex].prev = org.prev;
 
-#ifdef OPT
+#if defined OPT || defined BITMAP
             // if the new tcb's priority is less than equal to the
             // head's priority, this is the new head.
             if ( org.current->priority <= head->priority )
@@ -586,6 +1201,7 @@ sched_err_code_t G8RTOS_AddThread(    void (*threadToAdd)(void), uint8_t priorit
             org.prev->next = org.current;
         }
 
+        G8RTOS_ReadyInsert(tempTCB);
         NumberOfThreads++;  // - prepare for the next thread
 
         EndCriticalSection(primask);
@@ -611,12 +1227,21 @@ sched_err_code_t G8RTOS_AddAperiodicEvent_Priority(void (*PthreadToAdd)(void), u
     {
         if ( priority > 6 )
             err = HWI_PRIORITY_INVALID;
+#ifdef KERNEL_BASEPRI
+        // handlers above KERNEL_IRQ_PRIORITY are not masked by kernel critical sections
+        else if ( priority < KERNEL_IRQ_PRIORITY )
+            err = HWI_PRIORITY_INVALID;
+#endif
         else
         {
             // Interrupt vector functions.
             // using FPU_IRQn because this unit is never
             // enabled, so it shouldn't be a problem to use it.
+#ifdef G8RTOS_HOST
+            G8RTOS_HostSetVector(IRQn, PthreadToAdd);
+#else
             __NVIC_SetVector(IRQn, (uint32_t)PthreadToAdd);
+#endif
             __NVIC_SetPriority(IRQn, priority);
             __NVIC_EnableIRQ(IRQn);
         }
@@ -630,57 +1255,150 @@ sched_err_code_t G8RTOS_AddAperiodicEvent_Priority(void (*PthreadToAdd)(void), u
 /*
  * Adds periodic threads to G8RTOS Scheduler
  * Function will initialize a periodic event struct to represent event.
- * The struct will be added to a linked list of periodic events
+ * The struct will be added to the heap of periodic events
  * Param Pthread To Add: void-void function for P thread handler
- * Param period: period of P thread to add
+ * Param period: period of P thread to add in ms
  * Returns: Error code for adding threads
  */
 sched_err_code_t G8RTOS_AddPeriodicEvent(void (*PthreadToAdd)(void), uint32_t period)
 {
-    sched_err_code_t err = NO_ERROR;
+    sched_err_code_t err = THREAD_LIMIT_REACHED;
     uint32_t primask = StartCriticalSection();
 
-    // only adds threads if there is room in the linked list
-    if (NumberOfPthreads < MAXPTHREADS)
+    // only adds threads if there is room in the heap
+    for (int i = 0; i < MAXPTHREADS && NumberOfPthreads < MAXPTHREADS; i++)
     {
-        // assign parameter values
-        Pthread[NumberOfPthreads].handler = PthreadToAdd;
-        Pthread[NumberOfPthreads].period = period;
-        Pthread[NumberOfPthreads].exec_time = period + SystemTime + NumberOfPthreads;
+        if ( Pthread[i].handler != 0 )
+            continue;
+
+        // assign parameter values. Events added together are offset
+        // by one tick so they don't all run in the same SysTick.
+        ptcb_t* event = &Pthread[i];
+        event->handler = PthreadToAdd;
+        event->period = (period > 0) ? period : 1;
+        event->exec_time = event->period + SystemTime + NumberOfPthreads;
+        event->overruns = 0;
+        G8RTOS_ResetCycleStat(&event->release_delay);
+        G8RTOS_ResetCycleStat(&event->exec_cycles);
+
+        // add to the bottom of the heap and move it up to its place
+        HeapSet(NumberOfPthreads, event);
+        NumberOfPthreads++;
+        HeapSiftUp(event->heap_index);
 
-        // handle circular linked list organization
-        if (NumberOfPthreads == 0)   // First control block creation
-        {
-            // initialize next/previous for the current(first) control block
-            Pthread[NumberOfPthreads].next = &Pthread[NumberOfPthreads];
-            Pthread[NumberOfPthreads].prev = &Pthread[NumberOfPthreads];
-        }
-        else
-        {
-            // initialize next/previous for the current block
-            Pthread[NumberOfPthreads].next = &Pthread[0];
-            Pthread[NumberOfPthreads].prev = &Pthread[NumberOfPthreads - 1];
+        err = NO_ERROR;
+        break;
+    }
+
+    EndCriticalSection(primask);
+    __enable_interrupt();
+    return err;
+}
+
+/*
+ * Removes the periodic event with the given handler. The last heap
+ * entry takes its slot and is moved up or down to its place.
+ */
+sched_err_code_t G8RTOS_KillPeriodicEvent(void (*PthreadToKill)(void))
+{
+    sched_err_code_t err = THREAD_DOES_NOT_EXIST;
+    uint32_t primask = StartCriticalSection();
 
-            // update next from the previous block
-            Pthread[NumberOfPthreads - 1].next = &Pthread[NumberOfPthreads];
+    for (int i = 0; i < MAXPTHREADS; i++)
+    {
+        if ( Pthread[i].handler != PthreadToKill || PthreadToKill == 0 )
+            continue;
 
-            // update previous from the original block
-            Pthread[0].prev = &Pthread[NumberOfPthreads];
+        uint32_t slot = Pthread[i].heap_index;
+        NumberOfPthreads--;
+
+        if ( slot < NumberOfPthreads )
+        {
+            ptcb_t* moved = PeriodicHeap[NumberOfPthreads];
+            HeapSet(slot, moved);
+            HeapSiftUp(slot);
+            HeapSiftDown(moved->heap_index);
         }
 
-        NumberOfPthreads++;
+        Pthread[i].handler = 0;
         err = NO_ERROR;
+        break;
     }
-    else
+
+    EndCriticalSection(primask);
+    return err;
+}
+
+
+/*
+ * Changes a thread's running priority. Under OPT and BITMAP the tcb
+ * list is kept sorted by priority, so the thread is unlinked and put
+ * back in front of the first thread of equal or lower priority.
+ */
+void G8RTOS_ChangePriority(tcb_t *thread, uint8_t priority)
+{
+    uint32_t primask = StartCriticalSection();
+
+    // only the BITMAP ready lists are kept per priority. Under OPT an
+    // insert would also restart the thread's wait for aging.
+#ifdef BITMAP
+    G8RTOS_ReadyRemove(thread);
+#endif
+
+    // a waiting thread moves to its new place in the wait queue
+    if ( thread->blocked != 0 )
+        G8RTOS_WaitQueueRemove(thread->blocked, thread);
+
+#if defined OPT || defined BITMAP
+    if ( NumberOfThreads > 1 )
     {
-        err = THREAD_LIMIT_REACHED;
+        // take the thread out of the list
+        if ( thread == head )
+            head = thread->next;
+        thread->prev->next = thread->next;
+        thread->next->prev = thread->prev;
+
+        // find the first thread it should run before. If none is
+        // found the search wraps back to the head (new tail).
+        tcb_t* tempTcb = head;
+        for (uint32_t i = 0; i < NumberOfThreads - 1; i++)
+        {
+            if ( priority <= tempTcb->priority )
+                break;
+            tempTcb = tempTcb->next;
+        }
+
+        thread->next = tempTcb;
+        thread->prev = tempTcb->prev;
+        tempTcb->prev->next = thread;
+        tempTcb->prev = thread;
+
+        if ( priority <= head->priority )
+            head = thread;
     }
+#endif
+
+    thread->priority = priority;
+#ifdef BITMAP
+    G8RTOS_ReadyInsert(thread);
+#endif
+
+    if ( thread->blocked != 0 )
+        G8RTOS_WaitQueueInsert(thread->blocked, thread);
 
     EndCriticalSection(primask);
-    __enable_interrupt();
-    return err;
 }
 
+/*
+ * Sets the time slice of one priority level. Threads already running
+ * keep the slice they started with.
+ */
+void G8RTOS_SetQuantum(uint8_t priority, uint8_t ticks)
+{
+#ifdef OPT
+    QuantumTicks[priority] = (ticks > 0) ? ticks : 1;
+#endif
+}
 
 /*
  * Puts the current thread into a sleep state.
@@ -688,15 +1406,281 @@ sched_err_code_t G8RTOS_AddPeriodicEvent(void (*PthreadToAdd)(void), uint32_t pe
  */
 void sleep(uint32_t durationMS)
 {
-    CurrentlyRunningThread->sleep_count = SystemTime + durationMS;
-    CurrentlyRunningThread->asleep = 0x1;
-    StartContextSwitch();
-	while(CurrentlyRunningThread->asleep);
+    uint32_t primask = StartCriticalSection();
+    TRACE(TRACE_SLEEP, durationMS);
+    BlockUntil(SystemTime + durationMS);
+    EndCriticalSection(primask);
 }
 
-/*********************************************** UPDATES *********************************************************************/
+/*
+ * Puts the current thread to sleep until SystemTime reaches wakeTime.
+ * Returns right away if wakeTime has already passed. Periodic loops
+ * add their period to wakeTime each pass so they don't drift by their
+ * own execution time.
+ *  param wakeTime: SystemTime (ms) to wake up at
+ */
+void sleep_until(uint32_t wakeTime)
+{
+    uint32_t primask = StartCriticalSection();
+    if ( !TimeReached(wakeTime) )
+    {
+        TRACE(TRACE_SLEEP, wakeTime - SystemTime);
+        BlockUntil(wakeTime);
+    }
+    EndCriticalSection(primask);
+}
+
+/*
+ * Stops the CPU until the next interrupt. With TICKLESS, SysTick is
+ * stretched to the next sleeper or periodic event first.
+ *  - Interrupts are masked from the check to the WFI so a thread that an
+ *    interrupt makes ready cannot be missed (WFI still wakes on it). This
+ *    uses PRIMASK even with KERNEL_BASEPRI.
+ *  - Idle time is measured with SysTick because the DWT cycle counter
+ *    stops while the core sleeps
+ */
+void G8RTOS_Idle(void)
+{
+    // always PRIMASK, WFI does not wake on an interrupt masked by BASEPRI
+    uint32_t primask = (StartCriticalSection)();
+
+    // a context switch is already waiting for this critical section to end
+#ifdef G8RTOS_HOST
+    if ( G8RTOS_HostPendSVPending() )
+#else
+    if ( SCB->ICSR & SCB_ICSR_PENDSVSET_Msk )
+#endif
+    {
+        (EndCriticalSection)(primask);
+        return;
+    }
+
+#ifdef TICKLESS
+    uint32_t idleTicks = TicksUntilNextEvent();
 
+    if ( idleTicks > 1 )
+    {
+        IdleCycles += SuppressedSleep(idleTicks);
+        IdleSleeps++;
+        (EndCriticalSection)(primask);
+        return;
+    }
+#endif
+
+    // sleep until the next interrupt, normally the next tick
+#ifdef G8RTOS_HOST
+    uint32_t before = G8RTOS_CYCLES();
+    __WFI();
+    IdleCycles += G8RTOS_CYCLES() - before;
+#else
+    uint32_t before = SysTick->VAL;
+    (void)SysTick->CTRL;                        // reading CTRL clears COUNTFLAG
+
+    __DSB();
+    __WFI();
+
+    uint32_t after = SysTick->VAL;
+    if ( SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk )
+        IdleCycles += before + (SysTick->LOAD + 1 - after);
+    else
+        IdleCycles += before - after;
+#endif
+    IdleSleeps++;
+
+    (EndCriticalSection)(primask);
+}
+
+/*
+ * Copies the run time accounting of every alive thread. The running
+ * thread is charged up to now first so its time is not one switch behind.
+ */
+uint32_t G8RTOS_GetThreadStats(thread_stats_t *stats, uint32_t maxThreads)
+{
+    uint32_t count = 0;
+    uint32_t primask = StartCriticalSection();
+
+    uint32_t now = G8RTOS_CYCLES();
+    CurrentlyRunningThread->run_cycles += now - CurrentlyRunningThread->switch_in_time;
+    CurrentlyRunningThread->switch_in_time = now;
+
+    // the fallback idle thread is reported after the tcb array
+    for (int i = 0; i <= MAX_THREADS && count < maxThreads; i++)
+    {
+        tcb_t* tempTcb = (i < MAX_THREADS) ? &threadControlBlocks[i] : &IdleTcb;
+        if ( !tempTcb->alive )
+            continue;
+
+        for (int j = 0; j < MAX_NAME_LENGTH; j++)
+            stats[count].name[j] = tempTcb->name[j];
+        stats[count].name[MAX_NAME_LENGTH] = 0;
+
+        stats[count].id = tempTcb->id;
+        stats[count].priority = tempTcb->priority;
+        stats[count].run_cycles = tempTcb->run_cycles;
+        stats[count].switches = tempTcb->switches;
+        stats[count].preemptions = tempTcb->preemptions;
+        stats[count].blocks = tempTcb->blocks;
+        stats[count].max_wait = tempTcb->max_wait;
 #ifdef OPT
+        // a thread that is still waiting counts the wait so far
+        if (    i < MAX_THREADS && tempTcb != CurrentlyRunningThread && CanRun(tempTcb)
+            &&  SystemTime - tempTcb->age > stats[count].max_wait )
+        {
+            stats[count].max_wait = SystemTime - tempTcb->age;
+        }
+#endif
+        stats[count].stack_size = tempTcb->stack_size;
+        stats[count].stack_used = StackUsed(tempTcb);
+        count++;
+    }
+
+    EndCriticalSection(primask);
+    return count;
+}
+
+/*
+ * Clears the run time accounting of every thread
+ */
+void G8RTOS_ResetThreadStats(void)
+{
+    uint32_t primask = StartCriticalSection();
+
+    for (int i = 0; i < MAX_THREADS; i++)
+    {
+        threadControlBlocks[i].run_cycles = 0;
+        threadControlBlocks[i].switches = 0;
+        threadControlBlocks[i].preemptions = 0;
+        threadControlBlocks[i].blocks = 0;
+        threadControlBlocks[i].max_wait = 0;
+    }
+    IdleTcb.run_cycles = 0;
+    IdleTcb.switches = 0;
+    IdleTcb.preemptions = 0;
+    IdleTcb.blocks = 0;
+    CurrentlyRunningThread->switch_in_time = G8RTOS_CYCLES();
+
+    EndCriticalSection(primask);
+}
+
+/*
+ * Prints G8RTOS_GetThreadStats for every alive thread. Run cycles are
+ * printed in thousands so they fit the signed 32 bit print.
+ */
+void G8RTOS_PrintThreadStats(void)
+{
+    static thread_stats_t stats[MAX_THREADS + 1];
+    uint32_t count = G8RTOS_GetThreadStats(stats, MAX_THREADS + 1);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        BackChannelPrint(stats[i].name, BackChannel_Info);
+        BackChannelPrintIntVariable("run_kcycles", (int32_t)(stats[i].run_cycles / 1000));
+        BackChannelPrintIntVariable("switches", stats[i].switches);
+        BackChannelPrintIntVariable("preemptions", stats[i].preemptions);
+        BackChannelPrintIntVariable("blocks", stats[i].blocks);
+        BackChannelPrintIntVariable("max_wait_ms", stats[i].max_wait);
+        BackChannelPrintIntVariable("stack_used", stats[i].stack_used);
+        BackChannelPrintIntVariable("stack_size", stats[i].stack_size);
+    }
+}
+
+/*
+ * Copies the timing statistics of every periodic event
+ */
+uint32_t G8RTOS_GetPeriodicStats(periodic_stats_t *stats, uint32_t maxEvents)
+{
+    uint32_t count = 0;
+    uint32_t primask = StartCriticalSection();
+
+    for (int i = 0; i < MAXPTHREADS && count < maxEvents; i++)
+    {
+        if ( Pthread[i].handler == 0 )
+            continue;
+
+        stats[count].handler = Pthread[i].handler;
+        stats[count].period = Pthread[i].period;
+        stats[count].overruns = Pthread[i].overruns;
+        stats[count].release_delay = Pthread[i].release_delay;
+        stats[count].exec_cycles = Pthread[i].exec_cycles;
+        count++;
+    }
+
+    EndCriticalSection(primask);
+    return count;
+}
+
+/*
+ * Clears the timing statistics of every periodic event
+ */
+void G8RTOS_ResetPeriodicStats(void)
+{
+    uint32_t primask = StartCriticalSection();
+
+    for (int i = 0; i < MAXPTHREADS; i++)
+    {
+        Pthread[i].overruns = 0;
+        G8RTOS_ResetCycleStat(&Pthread[i].release_delay);
+        G8RTOS_ResetCycleStat(&Pthread[i].exec_cycles);
+    }
+
+    EndCriticalSection(primask);
+}
+
+/*
+ * Prints G8RTOS_GetPeriodicStats for every periodic event. Events are
+ * labelled by period since they have no name.
+ */
+void G8RTOS_PrintPeriodicStats(void)
+{
+    static periodic_stats_t stats[MAXPTHREADS];
+    uint32_t count = G8RTOS_GetPeriodicStats(stats, MAXPTHREADS);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        BackChannelPrintIntVariable("PERIODIC_MS", stats[i].period);
+        BackChannelPrintIntVariable("overruns", stats[i].overruns);
+        G8RTOS_PrintCycleStat("RELEASE_DELAY", &stats[i].release_delay);
+        BackChannelPrintIntVariable("jitter", (stats[i].release_delay.count > 0) ?
+                stats[i].release_delay.max - stats[i].release_delay.min : 0);
+        G8RTOS_PrintCycleStat("EXEC", &stats[i].exec_cycles);
+    }
+}
+
+/*
+ * Reads the idle and busy time since the last G8RTOS_ResetCpuUsage
+ */
+void G8RTOS_GetCpuUsage(cpu_usage_t *usage)
+{
+    uint32_t primask = StartCriticalSection();
+
+    uint64_t total = (uint64_t)(SystemTime - UsageStartTime) * CyclesPerTick;
+
+    usage->idle_cycles = IdleCycles;
+    usage->busy_cycles = (total > IdleCycles) ? total - IdleCycles : 0;
+    usage->sleeps = IdleSleeps;
+    usage->suppressed_ticks = SuppressedTicks;
+
+    EndCriticalSection(primask);
+}
+
+/*
+ * Restarts the idle and busy counters
+ */
+void G8RTOS_ResetCpuUsage(void)
+{
+    uint32_t primask = StartCriticalSection();
+
+    IdleCycles = 0;
+    IdleSleeps = 0;
+    SuppressedTicks = 0;
+    UsageStartTime = SystemTime;
+
+    EndCriticalSection(primask);
+}
+
+/*********************************************** UPDATES *********************************************************************/
+
+#if defined OPT || defined BITMAP
 // Function used in adding priority threads into the linked
 // list with descending order of priority (0 .. 255)
 // Returns an "INDEX" of in the TCB linked list where the new
@@ -782,56 +1766,250 @@ OrganizedPriorityObject_t FindEmptyTcb(uint8_t priority)
 #endif
 
 #if defined OPT
-// Scheduling algorithm using priority instead of round robin
-// NOTE: **Update to include aging and dynamic quantum time later**
-void G8RTOS_Scheduler_Priority(void)
+// Scheduling algorithm using priority instead of round robin.
+// Runs the first thread in the sorted list that can run. Threads of the
+// same priority take turns of QuantumTicks[priority] ticks, and a starved
+// thread (see AgeNextThread) runs ahead of anything that isn't above
+// DONT_STARVE_PRIORITY.
+static void SelectNextThread(void)
 {
+    tcb_t* current = CurrentlyRunningThread;
     tcb_t* tempThreadPtr = head;
 
-    for (int i = 0; i < NumberOfThreads; i++)
+    // the list is sorted, so the first thread that can run has the highest
+    // priority. If none can, the walk ends back at the head.
+    for (uint32_t i = 0; i < NumberOfThreads && !CanRun(tempThreadPtr); i++)
+        tempThreadPtr = tempThreadPtr->next;
+
+    bool found = CanRun(tempThreadPtr);
+
+    // the starved thread is boosted until it has used up a time slice
+    // or it sleeps or blocks
+    if (    Starved != 0
+        &&  ( !CanRun(Starved) || (Starved == current && current->quantum == 0) ) )
+    {
+        Starved = 0;
+    }
+
+    if ( Starved != 0 && ( !found || DONT_STARVE_PRIORITY <= tempThreadPtr->priority ) )
+    {
+        tempThreadPtr = Starved;
+    }
+
+    // the running thread keeps the CPU until its time slice is used up.
+    // Then the next thread of its priority after it that can run gets a
+    // turn. If there is none, the walk above already found the first one.
+    else if (   found && current != &IdleTcb && CanRun(current)
+            &&  current->priority == tempThreadPtr->priority    )
     {
-        // Jump through the linked list if the temp thread cannot be run.
-        if ( tempThreadPtr->blocked > 0 || tempThreadPtr->asleep == 1 )
+        if ( current->quantum > 0 )
         {
-            tempThreadPtr = tempThreadPtr->next;
+            tempThreadPtr = current;
         }
-
-        // If there are multiple threads of this priority, determine which
-        // thread should be run next. I do not need to specify less than equal
-        // because I am already starting at the head.
-        else if (   tempThreadPtr->priority == CurrentlyRunningThread->priority
-                &&  tempThreadPtr->priority == tempThreadPtr->next->priority    )
+        else
         {
-            // old the first of this priority. Cannot be blocked because
-            // it made it past the first if statement.
-            tcb_t* remember_me = tempThreadPtr;
-            while (1)
+            for (tcb_t* next = current->next; next != current && next->priority == current->priority; next = next->next)
             {
-                tempThreadPtr = tempThreadPtr->next;
-
-                // if unblocked and awake, allow thread to run. This cannot be
-                // running the same thing as CurrentlyRunningThread because it
-                // forces a thread switch every iteration.
-                if ( tempThreadPtr->blocked == 0 && tempThreadPtr->asleep == 0 )
-                    break;
-
-                // if the thread reaches the end of its priority list, go to
-                // the beginning of the list and run. List will continue iterating
-                // on the next SysTick.
-                else if ( tempThreadPtr->priority != tempThreadPtr->next->priority )
+                if ( CanRun(next) )
                 {
-                    tempThreadPtr = remember_me;
+                    tempThreadPtr = next;
                     break;
                 }
             }
+        }
+    }
 
-            break;
+    if ( CanRun(tempThreadPtr) )
+    {
+        // a new turn starts with a full time slice
+        if ( tempThreadPtr->quantum == 0 )
+            tempThreadPtr->quantum = QuantumTicks[tempThreadPtr->priority];
+
+        // the wait ends for the thread switched in and starts for the one
+        // switched out (a thread that slept or blocked restarts it in
+        // G8RTOS_ReadyInsert)
+        if ( tempThreadPtr != current )
+        {
+            if ( SystemTime - tempThreadPtr->age > tempThreadPtr->max_wait )
+                tempThreadPtr->max_wait = SystemTime - tempThreadPtr->age;
+            current->age = SystemTime;
         }
+    }
+
+    CurrentlyRunningThread = tempThreadPtr;
+}
+
+/*
+ * Aging. Checks one tcb slot per tick, so it costs the same for any
+ * number of threads. A thread that has been ready for starvation_age
+ * ticks without running becomes the starved thread. Only one thread is
+ * boosted at a time and the slots are not checked meanwhile, so a
+ * thread waits at most starvation_age + MAX_THREADS ticks plus the
+ * slices of threads boosted ahead of it.
+ */
+static void AgeNextThread(void)
+{
+    if ( Starved != 0 )
+        return;
 
-        // if there is only one thread available of this priority, run it now
-        else break;
+    tcb_t* tempTcb = &threadControlBlocks[AgingSlot];
+
+    if ( ++AgingSlot == MAX_THREADS )
+        AgingSlot = 0;
+
+    if (    tempTcb != CurrentlyRunningThread && CanRun(tempTcb)
+        &&  tempTcb->priority > DONT_STARVE_PRIORITY
+        &&  SystemTime - tempTcb->age >= tempTcb->starvation_age )
+    {
+        Starved = tempTcb;
+    }
+}
+#endif
+
+#if defined BITMAP
+// Scheduling algorithm using the ready bitmap. Finds the highest
+// ready priority with two count leading zero instructions and
+// round robins inside that priority's ready list.
+static void SelectNextThread(void)
+{
+    // nothing is ready. G8RTOS_Scheduler_Priority switches
+    // to the fallback idle thread.
+    if ( ReadyGroup == 0 )
+        return;
+
+    uint32_t group = __CLZ(ReadyGroup);
+    uint32_t priority = (group << 5) | __CLZ(ReadyMap[group]);
+    tcb_t* tempThreadPtr = ReadyList[priority];
+
+    // If the running thread is still ready at this priority, give
+    // the next thread in its list a turn. Otherwise start at the
+    // front of the list.
+    if (    CurrentlyRunningThread->ready_next != 0
+        &&  CurrentlyRunningThread->priority == priority    )
+    {
+        tempThreadPtr = CurrentlyRunningThread->ready_next;
     }
 
     CurrentlyRunningThread = tempThreadPtr;
 }
+
+// Adds a thread to the back of its priority's ready list if it
+// can run and is not already on a list.
+void G8RTOS_ReadyInsert(tcb_t *thread)
+{
+    if (    thread->ready_next != 0 || !thread->alive
+        ||  thread->asleep || thread->blocked != 0 )
+        return;
+
+    uint32_t priority = thread->priority;
+    tcb_t* first = ReadyList[priority];
+
+    if ( first == 0 )
+    {
+        // first ready thread of this priority
+        thread->ready_next = thread;
+        thread->ready_prev = thread;
+        ReadyList[priority] = thread;
+        ReadyMap[priority >> 5] |= 0x80000000 >> (priority & 31);
+        ReadyGroup |= 0x80000000 >> (priority >> 5);
+    }
+    else
+    {
+        // insert at the back (just before the first thread)
+        thread->ready_next = first;
+        thread->ready_prev = first->ready_prev;
+        first->ready_prev->ready_next = thread;
+        first->ready_prev = thread;
+    }
+}
+
+// Takes a thread off its ready list and clears the bitmap bits
+// when the list becomes empty.
+void G8RTOS_ReadyRemove(tcb_t *thread)
+{
+    if ( thread->ready_next == 0 )
+        return;
+
+    uint32_t priority = thread->priority;
+
+    if ( thread->ready_next == thread )
+    {
+        // last ready thread of this priority
+        ReadyList[priority] = 0;
+        ReadyMap[priority >> 5] &= ~(0x80000000 >> (priority & 31));
+        if ( ReadyMap[priority >> 5] == 0 )
+            ReadyGroup &= ~(0x80000000 >> (priority >> 5));
+    }
+    else
+    {
+        thread->ready_prev->ready_next = thread->ready_next;
+        thread->ready_next->ready_prev = thread->ready_prev;
+        if ( ReadyList[priority] == thread )
+            ReadyList[priority] = thread->ready_next;
+    }
+
+    thread->ready_next = 0;
+    thread->ready_prev = 0;
+}
+#elif defined OPT
+// OPT finds ready threads by scanning the tcb list. Inserting only
+// starts the thread's wait for aging.
+void G8RTOS_ReadyInsert(tcb_t *thread) { thread->age = SystemTime; }
+void G8RTOS_ReadyRemove(tcb_t *thread) { (void)thread; }
+#else
+// ORIG finds ready threads by scanning the tcb list, so there is
+// no ready list to maintain.
+void G8RTOS_ReadyInsert(tcb_t *thread) { }
+void G8RTOS_ReadyRemove(tcb_t *thread) { }
 #endif
+
+/*
+ * Priority scheduler called from the PendSV handler.
+ * Picks the next thread with the algorithm selected at the top of
+ * this file and optionally measures how long the choice took.
+ */
+void G8RTOS_Scheduler_Priority(void)
+{
+    uint32_t start = G8RTOS_CYCLES();
+    tcb_t* outgoing = CurrentlyRunningThread;
+
+    // charge the thread that is being switched out
+    outgoing->run_cycles += start - outgoing->switch_in_time;
+
+    SelectNextThread();
+
+    // nothing in the list can run. Hand the CPU to the fallback idle
+    // thread and hook it into the list so list walks starting from
+    // CurrentlyRunningThread still work.
+    if (    CurrentlyRunningThread->asleep || CurrentlyRunningThread->blocked != 0
+        ||  !CurrentlyRunningThread->alive )
+    {
+        if ( outgoing != &IdleTcb )
+        {
+            IdleTcb.next = outgoing->next;
+            IdleTcb.prev = outgoing->prev;
+        }
+        CurrentlyRunningThread = &IdleTcb;
+    }
+
+    if ( CurrentlyRunningThread != outgoing && outgoing->alive )
+    {
+        if ( outgoing->blocked != 0 )
+            outgoing->blocks++;
+        else if ( !outgoing->asleep )
+            outgoing->preemptions++;
+    }
+
+    if ( CurrentlyRunningThread != outgoing )
+    {
+        CurrentlyRunningThread->switches++;
+        TRACE(TRACE_SWITCH, G8RTOS_ThreadSlot(outgoing));
+    }
+
+    // scheduler time is not charged to either thread
+    CurrentlyRunningThread->switch_in_time = G8RTOS_CYCLES();
+
+#ifdef BENCH_SCHEDULER
+    G8RTOS_RecordCycleStat(&SchedulerCycles, CurrentlyRunningThread->switch_in_time - start);
+#endif
+}
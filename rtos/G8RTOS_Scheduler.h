@@ -9,24 +9,97 @@
 #include <stdint.h>
 #include "G8RTOS_Structures.h"
 #include "G8RTOS_CriticalSection.h"
+#include "G8RTOS_Statistics.h"
+#include "G8RTOS_Trace.h"
 #include "BSP.h"
 
 /*********************************************** Sizes and Limits *********************************************************************/
 #define MAX_THREADS     26
-#define MAXPTHREADS     1
-#define STACKSIZE       256
+#define MAXPTHREADS     32
+#define STACKSIZE       256         // default thread stack size in words
+#define IDLE_STACKSIZE  128         // stack of the kernel's fallback idle thread in words
+#define STACK_POOL_SIZE 5120        // words shared by all thread stacks
+#define STACK_CHUNK     32          // stacks are allocated in multiples of this many words
+#define STACK_CANARY    ((int32_t)0xA5A5A5A5)  // fill pattern used to find how much of a stack was used
 #define OSINT_PRIORITY  7
 
 #define DONT_STARVE_PRIORITY    10
-#define DONT_STARVE_AGE         100
-#define DEF_QUANT_COUNT         1
+#define DONT_STARVE_AGE         100         // ticks a ready thread waits before it is boosted
+#define DEF_QUANT_COUNT         1           // time slice in ticks of every priority until G8RTOS_SetQuantum
+#define NUM_PRIORITIES          256
 /*********************************************** Sizes and Limits *********************************************************************/
 
+/*********************************************** Kernel Options ***********************************************************************/
+/*
+ * TICKLESS -   When the idle thread runs, G8RTOS_Idle stops the 1 ms SysTick
+ *              until the next sleeper or periodic event is due, executes WFI,
+ *              and corrects SystemTime when it wakes up. Without it, the idle
+ *              thread still executes WFI but wakes up on every tick.
+ */
+#define TICKLESS
+
+// the host port keeps SysTick on fixed 1 ms ticks (see G8RTOS_Host.h)
+#ifdef G8RTOS_HOST
+#undef TICKLESS
+#endif
+/*********************************************** Kernel Options ***********************************************************************/
+
+/*********************************************** Benchmarks ***************************************************************************/
+/*
+ * Uncomment to measure kernel paths with the DWT cycle counter.
+ * Results are kept in cycle_stat_t variables (see Benchmark.h for the workloads).
+ *
+ * BENCH_SCHEDULER  -   cycles spent picking the next thread on every PendSV
+ * BENCH_TICK       -   cycles spent in SysTick_Handler (waking sleepers, periodic events)
+ * BENCH_MUTEX      -   worst case time a high priority thread waits for a lock held
+ *                      by a low priority thread while a medium priority thread runs.
+ *                      Add BENCH_MUTEX_AS_SEMAPHORE to run it on a plain semaphore.
+ * BENCH_PERIODIC   -   release delay, jitter and run time of many periodic events
+ * BENCH_IPC        -   cost of passing one multi-word message through a FIFO
+ *                      and through a lock-free ring
+ * BENCH_DEFERRED   -   ISR duration and deferral latency of interrupt bottom halves
+ * BENCH_IRQ_LATENCY -  latency of an interrupt that never calls the kernel while
+ *                      threads churn through kernel critical sections.
+ *                      Run with and without KERNEL_BASEPRI to compare.
+ * BENCH_SWITCH     -   cost of waking a higher priority thread, for threads
+ *                      that never touch the FPU and threads that do
+ * BENCH_KILL       -   cycles G8RTOS_KillAllOthers keeps interrupts masked
+ * BENCH_FAIRNESS   -   worst case time low priority threads wait to run while
+ *                      higher priority threads hog the CPU (OPT aging)
+ */
+// #define BENCH_SCHEDULER
+// #define BENCH_TICK
+// #define BENCH_MUTEX
+// #define BENCH_MUTEX_AS_SEMAPHORE
+// #define BENCH_PERIODIC
+// #define BENCH_IPC
+// #define BENCH_DEFERRED
+// #define BENCH_IRQ_LATENCY
+// #define BENCH_SWITCH
+// #define BENCH_KILL
+// #define BENCH_FAIRNESS
+/*********************************************** Benchmarks ***************************************************************************/
+
 /*********************************************** Public Variables *********************************************************************/
 
 /* Holds the current time for the whole System */
 extern uint32_t SystemTime;
 
+#ifdef BENCH_SCHEDULER
+/* Cycles spent in G8RTOS_Scheduler_Priority per context switch */
+extern cycle_stat_t SchedulerCycles;
+#endif
+
+#ifdef BENCH_TICK
+/* Cycles spent in SysTick_Handler per tick */
+extern cycle_stat_t TickCycles;
+#endif
+
+#ifdef BENCH_KILL
+/* Cycles G8RTOS_KillAllOthers keeps interrupts masked */
+extern cycle_stat_t KillAllCycles;
+#endif
+
 /*********************************************** Public Variables *********************************************************************/
 
 
@@ -42,7 +115,8 @@ typedef enum
     THREAD_DOES_NOT_EXIST       = -4,
     CANNOT_KILL_LAST_THREAD     = -5,
     IRQn_INVALID                = -6,
-    HWI_PRIORITY_INVALID        = -7
+    HWI_PRIORITY_INVALID        = -7,
+    STACK_POOL_EMPTY            = -8
 } sched_err_code_t;
 
 /* Points to next and previous tcb's when using priority operation */
@@ -74,9 +148,61 @@ sched_err_code_t G8RTOS_Launch_Priority();
 void G8RTOS_Scheduler(void);
 void G8RTOS_Scheduler_Priority(void);
 
+/*
+ * Ready list bookkeeping for the BITMAP scheduler
+ *  - Insert adds an alive, awake and unblocked thread to its priority's ready list
+ *  - Remove takes a thread off its ready list (call after it sleeps, blocks or dies)
+ *  - Both are safe to call more than once and do nothing under ORIG
+ *  - Under OPT, Insert only stamps when the thread became ready, for aging
+ *  - Must be called inside a critical section
+ */
+void G8RTOS_ReadyInsert(tcb_t *thread);
+void G8RTOS_ReadyRemove(tcb_t *thread);
+
+/*
+ * Changes a thread's running priority and moves it to the matching
+ * place in the tcb list and ready lists. The permanent priority is
+ * not changed. Used by the mutexes for priority inheritance.
+ * Param "thread": thread to change
+ * Param "priority": new priority (0 is the highest)
+ */
+void G8RTOS_ChangePriority(tcb_t *thread, uint8_t priority);
+
+/*
+ * Sets how many ticks a thread of this priority runs before the next
+ * ready thread of the same priority gets a turn. Only the OPT scheduler
+ * keeps time slices, ORIG and BITMAP switch on every tick.
+ * Param "priority": priority level to change
+ * Param "ticks": time slice in ticks, at least 1
+ */
+void G8RTOS_SetQuantum(uint8_t priority, uint8_t ticks);
 
 threadId_t G8RTOS_GetThreadId();
+
+/*
+ * Kills every thread except the caller and persistent threads, in one
+ * pass over the tcb slots inside one critical section
+ */
 void G8RTOS_KillAllOthers();
+
+/*
+ * Returns: the live thread with this id, 0 if there isn't one. O(1),
+ * the id holds the tcb slot (see threadId_t).
+ */
+tcb_t * G8RTOS_FindThread(threadId_t id);
+
+/*
+ * Marks the calling thread as persistent. G8RTOS_KillAllOthers skips
+ * persistent threads, G8RTOS_KillThread and G8RTOS_KillSelf do not.
+ */
+void G8RTOS_MakePersistent();
+
+/*
+ * Returns: the tcb slot of a thread, TRACE_THREAD_IDLE for the kernel's
+ * idle thread, TRACE_THREAD_NONE for no thread (before launch)
+ */
+uint8_t G8RTOS_ThreadSlot(tcb_t *thread);
+
 sched_err_code_t G8RTOS_KillThread( threadId_t id );
 sched_err_code_t G8RTOS_KillSelf();
 
@@ -87,22 +213,55 @@ sched_err_code_t G8RTOS_KillSelf();
  * 	- Initializes the stack for the provided thread
  * 	- Sets up the next and previous tcb pointers in a round robin fashion
  * Param "threadToAdd": Void-Void Function to add as preemptable main thread
+ * Param "stackSize": stack size in words (rounded up to STACK_CHUNK), taken from the stack pool
  * Returns: Error code for adding threads
  */
 OrganizedPriorityObject_t FindEmptyTcb(uint8_t priority);    // helper func
 sched_err_code_t G8RTOS_AddThread__Def_Starvation(void (*threadToAdd)(void), uint8_t priority, char * name);  // helper func
-sched_err_code_t G8RTOS_AddThread( void (*threadToAdd)(void), uint8_t priority, uint32_t starvation_age, char * name );
+sched_err_code_t G8RTOS_AddThread( void (*threadToAdd)(void), uint8_t priority, uint32_t starvation_age, uint32_t stackSize, char * name );
+/*
+ * Installs an interrupt handler that may call the kernel
+ * Param priority: NVIC priority, from KERNEL_IRQ_PRIORITY to 6
+ * Returns: HWI_PRIORITY_INVALID if the priority is above KERNEL_IRQ_PRIORITY,
+ *          since kernel critical sections would not mask the handler
+ */
+sched_err_code_t G8RTOS_AddAperiodicEvent_Priority(void (*PthreadToAdd)(void), uint32_t priority, IRQn_Type IRQn);
 /*
  * Adds periodic threads to G8RTOS Scheduler
  * Function will initialize a periodic event struct to represent event.
- * The struct will be added to a linked list of periodic events
+ * The struct will be added to the heap of periodic events
+ * Handlers run inside SysTick_Handler, so they must not block or sleep
  * Param Pthread To Add: void-void function for P thread handler
- * Param period: period of P thread to add
+ * Param period: period of P thread to add in ms
  * Returns: Error code for adding threads
  */
-sched_err_code_t G8RTOS_AddAperiodicEvent_Priority(void (*PthreadToAdd)(void), uint32_t priority, IRQn_Type IRQn);
 sched_err_code_t G8RTOS_AddPeriodicEvent(void (*PthreadToAdd)(void), uint32_t period);
 
+/*
+ * Removes the periodic event with the given handler
+ * Param PthreadToKill: handler passed to G8RTOS_AddPeriodicEvent
+ * Returns: THREAD_DOES_NOT_EXIST if no event uses that handler
+ */
+sched_err_code_t G8RTOS_KillPeriodicEvent(void (*PthreadToKill)(void));
+
+/*
+ * Copies the timing statistics of every periodic event
+ * Param "stats": array to fill
+ * Param "maxEvents": number of entries in the array
+ * Returns: number of entries filled
+ */
+uint32_t G8RTOS_GetPeriodicStats(periodic_stats_t *stats, uint32_t maxEvents);
+
+/*
+ * Clears the timing statistics of every periodic event
+ */
+void G8RTOS_ResetPeriodicStats(void);
+
+/*
+ * Prints G8RTOS_GetPeriodicStats for every periodic event to the back channel UART
+ */
+void G8RTOS_PrintPeriodicStats(void);
+
 
 /*
  * Puts the current thread into a sleep state.
@@ -110,6 +269,50 @@ sched_err_code_t G8RTOS_AddPeriodicEvent(void (*PthreadToAdd)(void), uint32_t pe
  */
 void sleep(uint32_t durationMS);
 
+/*
+ * Puts the current thread to sleep until SystemTime reaches wakeTime
+ * (returns right away if it already has)
+ *  param wakeTime: SystemTime (ms) to wake up at
+ */
+void sleep_until(uint32_t wakeTime);
+
+/*
+ * Stops the CPU until the next interrupt. Call this in a loop from the
+ * lowest priority (idle) thread. With TICKLESS, SysTick is held off until
+ * the next sleeper or periodic event is due.
+ */
+void G8RTOS_Idle(void);
+
+/*
+ * Copies the run time accounting of every alive thread, followed by
+ * the kernel's fallback idle thread
+ * Param "stats": array to fill (MAX_THREADS + 1 entries holds everything)
+ * Param "maxThreads": number of entries in the array
+ * Returns: number of entries filled
+ */
+uint32_t G8RTOS_GetThreadStats(thread_stats_t *stats, uint32_t maxThreads);
+
+/*
+ * Clears the run time accounting of every thread
+ */
+void G8RTOS_ResetThreadStats(void);
+
+/*
+ * Prints G8RTOS_GetThreadStats for every alive thread to the back channel UART
+ */
+void G8RTOS_PrintThreadStats(void);
+
+/*
+ * Reads the idle and busy time since the last G8RTOS_ResetCpuUsage
+ * Param "usage": filled with the current counters
+ */
+void G8RTOS_GetCpuUsage(cpu_usage_t *usage);
+
+/*
+ * Restarts the idle and busy counters
+ */
+void G8RTOS_ResetCpuUsage(void);
+
 /*********************************************** Public Functions *********************************************************************/
 
 #endif /* G8RTOS_SCHEDULER_H_ */
@@ -26,6 +26,7 @@ G8RTOS_Start: .asmfunc
 
 	; Load registers from CurrentlyRunningThread's stack
 	pop {r4 - r11}
+	add SP, SP, #4			; EXC_RETURN isn't useful yet, the first thread has no FPU state
 	pop {r0 - r3}
 	pop {r12}
 	add SP, SP, #4			; link register isn't useful yet
@@ -46,22 +47,27 @@ G8RTOS_Start: .asmfunc
 ;	- Calls G8RTOS_Scheduler to get new tcb
 ;	- Set stack pointer to new stack pointer from new tcb
 ;	- Pops registers from thread stack
+; FPU registers are only saved for threads that used the FPU since their
+; last switch in. Those threads enter with an extended frame (S0-S15 and
+; FPSCR stacked lazily by hardware) and bit 4 of EXC_RETURN cleared.
 PendSV_Handler: .asmfunc
 
-	; LR = 0xFFFFFFF9 --------------
+	; LR = 0xFFFFFFF9 (integer thread) or 0xFFFFFFE9 (FPU thread) ---
 	; Registers R0-R3, R12-R14, and PSR automatically pushed to stack
 	; After triggering the PENDSV_HANDLER
 	CPSID I					; prevent interrupt during thread switch
-	push {r4 - r11}
+
+	tst LR, #0x10			; extended frame?
+	it eq
+	vpusheq {s16 - s31}		; save the rest of the FPU context
+	push {r4 - r11, LR}		; EXC_RETURN is kept with the thread
 
 	; STORE THE STACK POINTER
 	ldr r0, RunningPtr
 	ldr r1, [r0]
 	str SP, [r1]			; store SP into TCB
 
-	push {LR}						; SAME STACK HERE
 	BL G8RTOS_Scheduler_Priority	; Calls G8RTOS_Scheduler to get new tcb
-	pop {LR}						; LR = 0xFFFFFFF9 restored for exitting interrupt
 
 	;	- Set stack pointer to new stack pointer from new tcb
 	ldr r0, RunningPtr
@@ -69,7 +75,10 @@ PendSV_Handler: .asmfunc
 	ldr SP, [r1]		; unload SP from TCB
 
 	;	- Pops registers from thread stack
-	pop {r4 - r11}
+	pop {r4 - r11, LR}		; LR = EXC_RETURN of the new thread
+	tst LR, #0x10
+	it eq
+	vpopeq {s16 - s31}
 
 	cpsie I
 	bx LR
@@ -4,10 +4,128 @@
 
 /*********************************************** Dependencies and Externs *************************************************************/
 #include "G8RTOS_Semaphores.h"
+#include "G8RTOS_Scheduler.h"
 
 /*********************************************** Dependencies and Externs *************************************************************/
 
 
+/*********************************************** Private Functions ********************************************************************/
+
+/*
+ * Takes the first (highest priority, longest waiting) thread off a
+ * semaphore's wait queue and makes it ready to run.
+ * Returns: the woken thread, 0 if nothing was waiting
+ */
+static tcb_t * WakeFirstWaiter(semaphore_t *s)
+{
+    tcb_t *pt = s->waiters;
+
+    if ( pt != 0 )
+    {
+        s->waiters = pt->wait_next;
+        pt->wait_next = 0;
+        pt->blocked = 0;
+        G8RTOS_ReadyInsert(pt);
+    }
+
+    return pt;
+}
+
+/*
+ * Makes a thread the owner of a mutex
+ */
+static void OwnMutex(mutex_t *m, tcb_t *thread)
+{
+    m->owner = thread;
+    m->owned_next = thread->mutexes_owned;
+    thread->mutexes_owned = m;
+    thread->mutexes_held++;
+}
+
+/*
+ * Takes a mutex off its owner's list and leaves it without an owner
+ */
+static void DisownMutex(mutex_t *m)
+{
+    tcb_t *owner = m->owner;
+    mutex_t **link = &owner->mutexes_owned;
+
+    while ( *link != m )
+        link = &(*link)->owned_next;
+
+    *link = m->owned_next;
+    m->owned_next = 0;
+    m->owner = 0;
+    owner->mutexes_held--;
+}
+
+/*
+ * Returns: the priority a mutex owner is owed, its own or that of the
+ *          first (highest priority) waiter on any mutex it owns
+ */
+static uint8_t InheritedPriority(tcb_t *owner)
+{
+    uint8_t priority = owner->priority_perm;
+
+    for (mutex_t *m = owner->mutexes_owned; m != 0; m = m->owned_next)
+    {
+        if ( m->sem.waiters != 0 && m->sem.waiters->priority < priority )
+            priority = m->sem.waiters->priority;
+    }
+
+    return priority;
+}
+
+/*
+ * Passes a mutex from its owner to its first waiter. The new owner
+ * inherits the priority of the waiters still behind it.
+ * Returns: the new owner, 0 if nothing was waiting and the mutex is free
+ */
+static tcb_t * HandOverMutex(mutex_t *m)
+{
+    DisownMutex(m);
+    m->sem.count++;
+
+    tcb_t *pt = WakeFirstWaiter(&m->sem);
+    if ( pt != 0 )
+    {
+        OwnMutex(m, pt);
+        pt->mutex_wait = 0;
+
+        uint8_t priority = InheritedPriority(pt);
+        if ( priority < pt->priority )
+            G8RTOS_ChangePriority(pt, priority);
+    }
+
+    return pt;
+}
+
+/*
+ * Returns: true if the set flags "got" satisfy a wait for "mask"
+ */
+static inline bool EventsMet(uint32_t got, uint32_t mask, uint8_t options)
+{
+    if ( options & EVENTS_WAIT_ALL )
+        return got == mask;
+    return got != 0;
+}
+
+/*
+ * Queues the running thread on a semaphore and switches away from it.
+ * Called with interrupts disabled, the switch happens once they are
+ * enabled again.
+ */
+static void BlockOn(semaphore_t *s)
+{
+    CurrentlyRunningThread->blocked = s;    // blocked is given address of the semaphore
+    G8RTOS_WaitQueueInsert(s, CurrentlyRunningThread);
+    G8RTOS_ReadyRemove(CurrentlyRunningThread);
+    StartContextSwitch();
+}
+
+/*********************************************** Private Functions ********************************************************************/
+
+
 /*********************************************** Public Functions *********************************************************************/
 
 /*
@@ -20,7 +138,8 @@ void G8RTOS_InitSemaphore(semaphore_t *s, int32_t value)
 {
     uint32_t primask = StartCriticalSection();
 
-    *s = value;
+    s->count = value;
+    s->waiters = 0;
 
     EndCriticalSection(primask);
     __enable_interrupt();
@@ -30,7 +149,49 @@ void G8RTOS_InitSemaphore(semaphore_t *s, int32_t value)
 // switch to next unblocked thread
 void StartContextSwitch( void )
 {
+#ifdef G8RTOS_HOST
+    G8RTOS_HostPendSV();
+#else
     SCB->ICSR |= SCB_ICSR_PENDSVSET_Msk;
+#endif
+}
+
+/*
+ * Adds a thread to a semaphore's wait queue behind every waiter of
+ * equal or higher priority, so equal priorities are woken in FIFO order
+ * THIS IS A CRITICAL SECTION
+ */
+void G8RTOS_WaitQueueInsert(semaphore_t *s, tcb_t *thread)
+{
+    uint32_t primask = StartCriticalSection();
+
+    tcb_t **link = &s->waiters;
+    while ( *link != 0 && (*link)->priority <= thread->priority )
+        link = &(*link)->wait_next;
+
+    thread->wait_next = *link;
+    *link = thread;
+
+    EndCriticalSection(primask);
+}
+
+/*
+ * Takes a thread out of a semaphore's wait queue
+ * THIS IS A CRITICAL SECTION
+ */
+void G8RTOS_WaitQueueRemove(semaphore_t *s, tcb_t *thread)
+{
+    uint32_t primask = StartCriticalSection();
+
+    tcb_t **link = &s->waiters;
+    while ( *link != 0 && *link != thread )
+        link = &(*link)->wait_next;
+
+    if ( *link == thread )
+        *link = thread->wait_next;
+    thread->wait_next = 0;
+
+    EndCriticalSection(primask);
 }
 
 /*
@@ -43,16 +204,13 @@ void StartContextSwitch( void )
 void G8RTOS_WaitSemaphore(semaphore_t *s)
 {
     uint32_t primask = StartCriticalSection();
+    TRACE(TRACE_SEM_WAIT, s);
 
-    (*s)--; // decrement semaphore if it is available
+    s->count--; // decrement semaphore if it is available
 
-    // add blocked thread and force a context switch
-    if ( (*s) < 0 )
-    {
-        CurrentlyRunningThread->blocked = s;    // blocked is given address of the semaphore
-        __enable_interrupt();
-        StartContextSwitch();
-    }
+    // add blocked thread to the wait queue and force a context switch
+    if ( s->count < 0 )
+        BlockOn(s);
 
     EndCriticalSection(primask);
     __enable_interrupt();
@@ -61,38 +219,341 @@ void G8RTOS_WaitSemaphore(semaphore_t *s)
 /*
  * Signals the completion of the usage of a semaphore
  *  - Increments the semaphore value by 1
- *  - Unblocks any threads waiting on that semaphore
+ *  - Hands the semaphore to the first thread in its wait queue
+ *  - Requests a context switch only if the woken thread outranks the
+ *    running one. From an ISR that is the interrupted thread, so a
+ *    thread woken while the idle thread runs is switched to right away
+ *    instead of on the next SysTick (which can be many ms away while
+ *    the idle thread is tickless)
  * Param "s": Pointer to semaphore to be signaled
  * THIS IS A CRITICAL SECTION
  */
 void G8RTOS_SignalSemaphore(semaphore_t *s)
 {
     uint32_t primask = StartCriticalSection();  // ints disabled
+    TRACE(TRACE_SEM_SIGNAL, s);
 
-    (*s)++;
+    s->count++;
 
-    // cycle through tcb's until a tcb that is not blocked
-    // by this semaphore shows up.
-    if ( (*s) <= 0 )
+    if ( s->count <= 0 )
     {
-        //temp points to the next thread's tcb
-        tcb_t *pt = CurrentlyRunningThread->next;
+        tcb_t *pt = WakeFirstWaiter(s);
+
+        if ( pt != 0 && pt->priority < CurrentlyRunningThread->priority )
+            StartContextSwitch();
+    }
 
-        // continue cycling until it finds a thread that is
-        // not blocked by this semaphore
-        while(pt->blocked != s)
+    EndCriticalSection(primask);
+    __enable_interrupts();      // ints enabled
+    return;
+}
+
+/*
+ * Initializes a mutex to the free state
+ * Param "m": Pointer to mutex
+ * THIS IS A CRITICAL SECTION
+ */
+void G8RTOS_InitMutex(mutex_t *m)
+{
+    uint32_t primask = StartCriticalSection();
+
+    m->sem.count = 1;
+    m->sem.waiters = 0;
+    m->owner = 0;
+    m->owned_next = 0;
+
+    EndCriticalSection(primask);
+    __enable_interrupt();
+}
+
+/*
+ * Acquires a mutex
+ *  - Takes the mutex right away if it is free
+ *  - Otherwise raises the owner (and whoever the owner is waiting
+ *    on, and so on) to this thread's priority, then blocks until
+ *    G8RTOS_ReleaseMutex hands the mutex over
+ * Param "m": Pointer to mutex to acquire
+ * THIS IS A CRITICAL SECTION
+ */
+void G8RTOS_AcquireMutex(mutex_t *m)
+{
+    uint32_t primask = StartCriticalSection();
+
+    m->sem.count--;
+
+    if ( m->owner == 0 )
+    {
+        OwnMutex(m, CurrentlyRunningThread);
+    }
+    else
+    {
+        // lend this thread's priority down the chain of owners
+        uint8_t priority = CurrentlyRunningThread->priority;
+        tcb_t *owner = m->owner;
+        while ( owner != 0 && owner->priority > priority )
         {
-            pt = pt->next;
+            G8RTOS_ChangePriority(owner, priority);
+            owner = (owner->mutex_wait != 0) ? owner->mutex_wait->owner : 0;
         }
 
-        pt->blocked = 0;
+        // block until the owner hands the mutex over
+        CurrentlyRunningThread->mutex_wait = m;
+        BlockOn(&m->sem);
     }
 
     EndCriticalSection(primask);
-    __enable_interrupts();      // ints enabled
-    return;
+    __enable_interrupt();
 }
 
-/*********************************************** Public Functions *********************************************************************/
+/*
+ * Releases a mutex owned by the calling thread
+ *  - Ownership passes directly to the first waiter, so a thread
+ *    that was never blocked can't take the mutex first
+ *  - The caller drops to the priority it is still owed: its own, or
+ *    that of the first waiter on a mutex it still owns
+ * Param "m": Pointer to mutex to release
+ * THIS IS A CRITICAL SECTION
+ */
+void G8RTOS_ReleaseMutex(mutex_t *m)
+{
+    uint32_t primask = StartCriticalSection();
+    tcb_t *self = CurrentlyRunningThread;
 
+    if ( m->owner == self )
+    {
+        // hand the mutex to the highest priority waiter
+        tcb_t *pt = HandOverMutex(m);
+
+        // give back the priority lent by this mutex's waiters. Whatever
+        // it was holding off may now outrank this thread.
+        uint8_t priority = InheritedPriority(self);
+        if ( priority != self->priority )
+        {
+            G8RTOS_ChangePriority(self, priority);
+            StartContextSwitch();
+        }
+        else if ( pt != 0 && pt->priority < self->priority )
+            StartContextSwitch();
+    }
+
+    EndCriticalSection(primask);
+    __enable_interrupts();
+}
+
+/*
+ * Cleans up the mutexes of a thread being killed
+ *  - Each mutex it owns is handed over like G8RTOS_ReleaseMutex does
+ *  - A waiter lent its priority down the chain of owners. Each owner
+ *    in that chain drops back to what its remaining waiters lend it.
+ * THIS IS A CRITICAL SECTION
+ */
+void G8RTOS_MutexThreadKilled(tcb_t *thread)
+{
+    uint32_t primask = StartCriticalSection();
+    bool preempt = false;
+
+    while ( thread->mutexes_owned != 0 )
+    {
+        tcb_t *pt = HandOverMutex(thread->mutexes_owned);
+        if ( pt != 0 && pt->priority < CurrentlyRunningThread->priority )
+            preempt = true;
+    }
+
+    mutex_t *m = thread->mutex_wait;
+    thread->mutex_wait = 0;
+
+    // only an owner running at this thread's priority can have been lent it
+    tcb_t *owner = (m != 0 && m->owner != 0 && m->owner->priority == thread->priority) ? m->owner : 0;
+    while ( owner != 0 )
+    {
+        uint8_t priority = InheritedPriority(owner);
+        if ( priority == owner->priority )
+            break;
+
+        G8RTOS_ChangePriority(owner, priority);
+        owner = (owner->mutex_wait != 0) ? owner->mutex_wait->owner : 0;
+    }
+
+    if ( preempt )
+        StartContextSwitch();
+
+    EndCriticalSection(primask);
+}
+
+/*
+ * Clears every flag of an event group
+ * THIS IS A CRITICAL SECTION
+ */
+void G8RTOS_InitEventGroup(event_group_t *g)
+{
+    uint32_t primask = StartCriticalSection();
+
+    g->flags = 0;
+    g->sem.count = 0;
+    g->sem.waiters = 0;
+
+    EndCriticalSection(primask);
+    __enable_interrupt();
+}
+
+/*
+ * Sets event flags
+ *  - Walks the whole wait queue since waiters want different flags
+ *  - A woken waiter's event_mask is replaced by the flags that woke it
+ *  - Flags a woken EVENTS_CLEAR waiter asked for are cleared after the
+ *    walk, so every waiter satisfied by this call still sees them
+ * THIS IS A CRITICAL SECTION
+ */
+uint32_t G8RTOS_SetEvents(event_group_t *g, uint32_t flags)
+{
+    uint32_t primask = StartCriticalSection();
+
+    uint32_t clear = 0;
+    tcb_t *first = 0;
+    tcb_t **link = &g->sem.waiters;
+
+    g->flags |= flags;
+
+    while ( *link != 0 )
+    {
+        tcb_t *pt = *link;
+        uint32_t got = g->flags & pt->event_mask;
+
+        if ( EventsMet(got, pt->event_mask, pt->event_options) )
+        {
+            if ( pt->event_options & EVENTS_CLEAR )
+                clear |= pt->event_mask;
+
+            *link = pt->wait_next;
+            pt->wait_next = 0;
+            pt->blocked = 0;
+            pt->event_mask = got;
+            G8RTOS_ReadyInsert(pt);
+
+            // the queue is in priority order, so the first one woken is the highest
+            if ( first == 0 )
+                first = pt;
+        }
+        else
+            link = &pt->wait_next;
+    }
+
+    g->flags &= ~clear;
+    flags = g->flags;
+
+    if ( first != 0 && first->priority < CurrentlyRunningThread->priority )
+        StartContextSwitch();
+
+    EndCriticalSection(primask);
+    __enable_interrupts();
+    return flags;
+}
+
+/*
+ * Clears event flags
+ * THIS IS A CRITICAL SECTION
+ */
+uint32_t G8RTOS_ClearEvents(event_group_t *g, uint32_t flags)
+{
+    uint32_t primask = StartCriticalSection();
+
+    uint32_t before = g->flags;
+    g->flags &= ~flags;
+
+    EndCriticalSection(primask);
+    __enable_interrupts();
+    return before;
+}
+
+/*
+ * Waits for event flags
+ * THIS IS A CRITICAL SECTION
+ */
+uint32_t G8RTOS_WaitEvents(event_group_t *g, uint32_t mask, uint8_t options)
+{
+    uint32_t primask = StartCriticalSection();
+
+    uint32_t got = g->flags & mask;
+    bool waited = false;
+
+    if ( EventsMet(got, mask, options) )
+    {
+        if ( options & EVENTS_CLEAR )
+            g->flags &= ~mask;
+    }
+    else
+    {
+        // G8RTOS_SetEvents stores the flags that woke us in event_mask.
+        // The switch happens when interrupts are enabled below.
+        CurrentlyRunningThread->event_mask = mask;
+        CurrentlyRunningThread->event_options = options;
+        BlockOn(&g->sem);
+        waited = true;
+    }
+
+    EndCriticalSection(primask);
+    __enable_interrupts();
+
+    if ( waited )
+        got = CurrentlyRunningThread->event_mask;
+
+    return got;
+}
+
+/*
+ * Sets notification bits on a thread
+ * THIS IS A CRITICAL SECTION
+ */
+int G8RTOS_NotifyThread(threadId_t id, uint32_t bits)
+{
+    uint32_t primask = StartCriticalSection();
+
+    tcb_t *pt = G8RTOS_FindThread(id);
+    if ( pt == 0 )
+    {
+        EndCriticalSection(primask);
+        __enable_interrupts();
+        return -1;
+    }
+
+    pt->notify_bits |= bits;
+
+    // only the thread itself ever waits on its notify queue
+    if ( pt->blocked == &pt->notify_wait )
+    {
+        WakeFirstWaiter(&pt->notify_wait);
+        if ( pt->priority < CurrentlyRunningThread->priority )
+            StartContextSwitch();
+    }
+
+    EndCriticalSection(primask);
+    __enable_interrupts();
+    return 0;
+}
+
+/*
+ * Waits for notification bits
+ * THIS IS A CRITICAL SECTION
+ */
+uint32_t G8RTOS_WaitNotify(void)
+{
+    uint32_t primask = StartCriticalSection();
+
+    tcb_t *self = CurrentlyRunningThread;
+    if ( self->notify_bits == 0 )
+        BlockOn(&self->notify_wait);
+
+    EndCriticalSection(primask);
+    __enable_interrupts();      // switches away here if blocked
+
+    primask = StartCriticalSection();
+    uint32_t bits = self->notify_bits;
+    self->notify_bits = 0;
+    EndCriticalSection(primask);
+    __enable_interrupts();
+
+    return bits;
+}
+
+/*********************************************** Public Functions *********************************************************************/
 
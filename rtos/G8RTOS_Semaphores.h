@@ -13,8 +13,48 @@
 
 /*
  * Semaphore typedef
+ *  - Threads blocked on the semaphore wait in a queue sorted by
+ *    priority, first come first served within a priority
  */
-typedef int32_t semaphore_t;
+typedef struct semaphore
+{
+    int32_t count;          // semaphore value, -n when n threads are waiting
+    struct tcb *waiters;    // first thread to wake, linked through tcb wait_next
+} semaphore_t;
+
+/*
+ * Mutex typedef
+ *  - Only the thread that acquired the mutex may release it
+ *  - A thread waiting on the mutex lends its priority to the owner
+ *    (priority inheritance) so medium priority threads can't keep
+ *    the owner from finishing
+ *  - Not recursive and not usable from an ISR
+ *  - Killing the owner hands the mutex to its next waiter
+ */
+typedef struct mutex
+{
+    semaphore_t sem;        // count is 1 when free, 0 when held, -n when n threads are waiting
+    struct tcb *owner;      // thread holding the mutex, 0 when free
+    struct mutex *owned_next; // next mutex the same thread owns
+} mutex_t;
+
+/*
+ * Event group typedef
+ *  - 32 event flags that threads can block on until one (or all) of
+ *    the flags they ask for are set
+ *  - Flags stay set until a waiter clears them or G8RTOS_ClearEvents
+ *  - Setting flags never blocks, so ISRs and periodic events can do it
+ */
+typedef struct event_group
+{
+    uint32_t flags;         // events that have happened and not been cleared
+    semaphore_t sem;        // only the wait queue is used, count means nothing
+} event_group_t;
+
+/* G8RTOS_WaitEvents options, OR them together */
+#define EVENTS_WAIT_ANY     0x00    // wake when any flag in the mask is set
+#define EVENTS_WAIT_ALL     0x01    // wake only when every flag in the mask is set
+#define EVENTS_CLEAR        0x02    // clear the mask's flags when the wait ends
 
 /*********************************************** Datatype Definitions *****************************************************************/
 #include "G8RTOS_Structures.h"
@@ -24,6 +64,30 @@ typedef int32_t semaphore_t;
 
 void StartContextSwitch( void );
 
+/*
+ * Kernel use: adds a thread to a semaphore's wait queue behind every
+ * waiter of equal or higher priority
+ * Param "s": Pointer to semaphore
+ * Param "thread": thread to queue
+ */
+void G8RTOS_WaitQueueInsert(semaphore_t *s, struct tcb *thread);
+
+/*
+ * Kernel use: takes a thread out of a semaphore's wait queue
+ * Param "s": Pointer to semaphore
+ * Param "thread": thread to remove
+ */
+void G8RTOS_WaitQueueRemove(semaphore_t *s, struct tcb *thread);
+
+/*
+ * Kernel use: cleans up the mutexes of a thread being killed
+ *  - Every mutex it owns is handed to its next waiter
+ *  - If it was waiting on a mutex (already out of the wait queue), the
+ *    owners it lent its priority to drop back to what is left
+ * Param "thread": thread being killed, still at its own priority
+ */
+void G8RTOS_MutexThreadKilled(struct tcb *thread);
+
 /*
  * Initializes a semaphore to a given value
  * Param "s": Pointer to semaphore
@@ -34,7 +98,7 @@ void G8RTOS_InitSemaphore(semaphore_t *s, int32_t value);
 /*
  * Waits for a semaphore to be available (value greater than 0)
  * 	- Decrements semaphore when available
- * 	- Spinlocks to wait for semaphore
+ * 	- Blocks in the semaphore's wait queue until signalled
  * Param "s": Pointer to semaphore to wait on
  */
 void G8RTOS_WaitSemaphore(semaphore_t *s);
@@ -46,6 +110,79 @@ void G8RTOS_WaitSemaphore(semaphore_t *s);
  */
 void G8RTOS_SignalSemaphore(semaphore_t *s);
 
+/*
+ * Initializes a mutex to the free state
+ * Param "m": Pointer to mutex
+ */
+void G8RTOS_InitMutex(mutex_t *m);
+
+/*
+ * Acquires a mutex
+ *  - Blocks the thread if another thread owns it
+ *  - Raises the owner to the caller's priority while the caller waits
+ * Param "m": Pointer to mutex to acquire
+ */
+void G8RTOS_AcquireMutex(mutex_t *m);
+
+/*
+ * Releases a mutex owned by the calling thread
+ *  - Hands the mutex directly to the highest priority waiting thread
+ *  - Drops the priority lent by that mutex's waiters, keeping what the
+ *    waiters on its other mutexes lent
+ * Param "m": Pointer to mutex to release
+ */
+void G8RTOS_ReleaseMutex(mutex_t *m);
+
+/*
+ * Clears every flag of an event group
+ * Param "g": Pointer to event group
+ */
+void G8RTOS_InitEventGroup(event_group_t *g);
+
+/*
+ * Sets event flags and wakes every waiter whose mask is now satisfied
+ *  - Safe to call from ISRs and periodic events
+ * Param "g": Pointer to event group
+ * Param "flags": flags to set
+ * Returns: the group's flags after waiters cleared theirs
+ */
+uint32_t G8RTOS_SetEvents(event_group_t *g, uint32_t flags);
+
+/*
+ * Clears event flags
+ * Param "g": Pointer to event group
+ * Param "flags": flags to clear
+ * Returns: the group's flags before clearing
+ */
+uint32_t G8RTOS_ClearEvents(event_group_t *g, uint32_t flags);
+
+/*
+ * Blocks until any (or all, with EVENTS_WAIT_ALL) flags in the mask are set
+ *  - Returns right away if they already are
+ *  - EVENTS_CLEAR clears the mask's flags on the way out
+ * Param "g": Pointer to event group
+ * Param "mask": flags to wait for
+ * Param "options": EVENTS_ options
+ * Returns: the flags in the mask that were set when the wait ended
+ */
+uint32_t G8RTOS_WaitEvents(event_group_t *g, uint32_t mask, uint8_t options);
+
+/*
+ * Sets notification bits on a thread and wakes it if it is in
+ * G8RTOS_WaitNotify. Cheaper than an event group when only one
+ * thread cares. Safe to call from ISRs and periodic events.
+ * Param "id": thread to notify
+ * Param "bits": bits to OR into its notification word
+ * Returns: 0, or -1 if no live thread has that id
+ */
+int G8RTOS_NotifyThread(uint32_t id, uint32_t bits);
+
+/*
+ * Blocks the calling thread until its notification word is non zero
+ * Returns: the notification bits, which are cleared
+ */
+uint32_t G8RTOS_WaitNotify(void);
+
 /*********************************************** Public Functions *********************************************************************/
 
 
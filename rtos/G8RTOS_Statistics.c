@@ -0,0 +1,92 @@
+/*
+ * G8RTOS_Statistics.c
+ */
+
+/*********************************************** Dependencies and Externs *************************************************************/
+#include "G8RTOS_Statistics.h"
+#include "BackChannelUart.h"
+
+#ifdef G8RTOS_HOST
+#include <time.h>
+#include "G8RTOS_Host.h"
+#endif
+
+/*********************************************** Dependencies and Externs *************************************************************/
+
+
+/*********************************************** Public Functions *********************************************************************/
+
+/*
+ * Enables the DWT cycle counter and clears it
+ */
+void G8RTOS_InitCycleCounter(void)
+{
+#ifndef G8RTOS_HOST
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;     // enable the trace block (DWT lives here)
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;                // start counting cycles
+#endif
+}
+
+#ifdef G8RTOS_HOST
+/*
+ * Returns the low 32 bits of CLOCK_MONOTONIC in nanoseconds, or of
+ * virtual time with G8RTOS_HOST_VIRTUAL
+ */
+uint32_t G8RTOS_HostCycles(void)
+{
+#ifdef G8RTOS_HOST_VIRTUAL
+    return G8RTOS_HostVirtualTime();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)((uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec);
+#endif
+}
+#endif
+
+/*
+ * Clears all samples from a cycle statistic
+ */
+void G8RTOS_ResetCycleStat(cycle_stat_t *stat)
+{
+    stat->count = 0;
+    stat->min = 0xFFFFFFFF;
+    stat->max = 0;
+    stat->total = 0;
+}
+
+/*
+ * Adds one sample to a cycle statistic
+ */
+void G8RTOS_RecordCycleStat(cycle_stat_t *stat, uint32_t cycles)
+{
+    // a zeroed (never reset) statistic starts its min at the first sample
+    if ( stat->count == 0 || cycles < stat->min )
+        stat->min = cycles;
+
+    if ( cycles > stat->max )
+        stat->max = cycles;
+
+    stat->total += cycles;
+    stat->count++;
+}
+
+/*
+ * Prints the count, min, max and average of a cycle statistic
+ */
+void G8RTOS_PrintCycleStat(const char *name, cycle_stat_t *stat)
+{
+    uint32_t avg = 0;
+
+    if ( stat->count > 0 )
+        avg = (uint32_t)(stat->total / stat->count);
+
+    BackChannelPrint(name, BackChannel_Info);
+    BackChannelPrintIntVariable("count", stat->count);
+    BackChannelPrintIntVariable("min", (stat->count > 0) ? stat->min : 0);
+    BackChannelPrintIntVariable("max", stat->max);
+    BackChannelPrintIntVariable("avg", avg);
+}
+
+/*********************************************** Public Functions *********************************************************************/
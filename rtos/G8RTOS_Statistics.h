@@ -0,0 +1,100 @@
+/*
+ * G8RTOS_Statistics.h
+ */
+
+#ifndef G8RTOS_STATISTICS_H_
+#define G8RTOS_STATISTICS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#ifndef G8RTOS_HOST
+#include "msp.h"
+#endif
+
+/*********************************************** Defines ******************************************************************************/
+
+/*
+ * Reads the free running DWT cycle counter (48 MHz MCLK -> ~20.8 ns per count).
+ * G8RTOS_InitCycleCounter must be called once before the value is valid.
+ * Host builds (G8RTOS_HOST) count nanoseconds of a monotonic clock instead.
+ * Both wrap at 32 bits, so only differences between two reads are meaningful.
+ */
+#ifdef G8RTOS_HOST
+#define G8RTOS_CYCLES()     G8RTOS_HostCycles()
+#else
+#define G8RTOS_CYCLES()     (DWT->CYCCNT)
+#endif
+
+/*********************************************** Defines ******************************************************************************/
+
+
+/*********************************************** Data Structure Definitions ***********************************************************/
+
+/*
+ *  Cycle Statistic:
+ *      - Accumulates the cost of one measured kernel path in CPU cycles
+ *      - Readable from the debugger or printed over the back channel UART
+ */
+typedef struct
+{
+    uint32_t count;     // number of samples recorded
+    uint32_t min;       // fewest cycles seen
+    uint32_t max;       // most cycles seen
+    uint64_t total;     // sum of all samples (used for the average)
+} cycle_stat_t;
+
+/*
+ *  CPU Usage:
+ *      - Splits the time since the last reset into idle and busy cycles
+ *      - Idle time is only counted while G8RTOS_Idle has the CPU stopped in WFI
+ */
+typedef struct
+{
+    uint64_t idle_cycles;       // cycles the CPU spent stopped in WFI
+    uint64_t busy_cycles;       // every other cycle since the last reset
+    uint32_t sleeps;            // number of times the idle thread executed WFI
+    uint32_t suppressed_ticks;  // SysTick interrupts skipped by tickless sleeps
+} cpu_usage_t;
+
+/*********************************************** Data Structure Definitions ***********************************************************/
+
+
+/*********************************************** Public Functions *********************************************************************/
+
+/*
+ * Enables the DWT cycle counter and clears it
+ */
+void G8RTOS_InitCycleCounter(void);
+
+#ifdef G8RTOS_HOST
+/*
+ * Returns the low 32 bits of CLOCK_MONOTONIC in nanoseconds, or of
+ * virtual time with G8RTOS_HOST_VIRTUAL
+ */
+uint32_t G8RTOS_HostCycles(void);
+#endif
+
+/*
+ * Clears all samples from a cycle statistic
+ * Param "stat": statistic to clear
+ */
+void G8RTOS_ResetCycleStat(cycle_stat_t *stat);
+
+/*
+ * Adds one sample to a cycle statistic
+ * Param "stat": statistic to update
+ * Param "cycles": measured length of the path in cycles
+ */
+void G8RTOS_RecordCycleStat(cycle_stat_t *stat, uint32_t cycles);
+
+/*
+ * Prints the count, min, max and average of a cycle statistic
+ * to the back channel UART
+ * Param "name": label printed before the values
+ * Param "stat": statistic to print
+ */
+void G8RTOS_PrintCycleStat(const char *name, cycle_stat_t *stat);
+
+/*********************************************** Public Functions *********************************************************************/
+
+#endif /* G8RTOS_STATISTICS_H_ */
@@ -8,7 +8,11 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include "msp.h"
+#ifdef G8RTOS_HOST
+#include <ucontext.h>
+#endif
 #include "G8RTOS_Semaphores.h"
+#include "G8RTOS_Statistics.h"
 
 /*********************************************** Data Structure Definitions ***********************************************************/
 
@@ -21,51 +25,122 @@
 
 #define MAX_NAME_LENGTH     16
 
+/*
+ * Thread ids are (generation << 8) | tcb slot. The slot finds the tcb
+ * without a search, and the generation, bumped every time the slot is
+ * reused, tells a stale id apart from the slot's current thread.
+ */
 typedef uint32_t threadId_t;
 
+#define THREAD_ID_SLOT(id)      ((id) & 0xFF)
+#define THREAD_ID_GEN_SHIFT     8
+
 /* Thread control block */
 struct tcb
 {
     int32_t *sp;            // current tcb stack pointer - MUST BE FIRST ADDRESS
+    int32_t *stack;         // lowest address of the thread's stack (from the stack pool)
+    uint32_t stack_size;    // stack size in words
     struct tcb *next;       // next tcb pointer
     struct tcb *prev;       // previous tcb pointer
 
     semaphore_t *blocked;   // address of the semaphore blocking the thread
+    struct tcb *wait_next;  // next thread in that semaphore's wait queue
 
     uint8_t asleep;         // boolean to test if the thread has yielded
     uint32_t sleep_count;   // number of SysTicks before thread expects to be woken up
+    struct tcb *sleep_next; // next sleeping tcb in wake up order
 
     uint8_t priority;       // 0 is the highest priority, 255 is the lowest
     uint8_t priority_perm;  // permanent priority assigned at init doesn't allow low level threads to starve
-    uint32_t age;
-    uint32_t starvation_age; // age met before the priority is automatically set to level 10
+    uint32_t age;           // ORIG: switches waited without running. OPT: SystemTime it became ready or last ran
+    uint32_t starvation_age; // age met before the priority is automatically set to level 10, 0xFFFFFFFF never
+    uint8_t quantum;        // ticks left in its time slice (OPT scheduler), 0 when the next turn starts a new one
+    uint32_t max_wait;      // most ticks spent ready without running (OPT scheduler)
+
+    uint8_t mutexes_held;   // number of mutexes this thread owns
+    struct mutex *mutexes_owned; // those mutexes, linked through mutex owned_next
+    struct mutex *mutex_wait; // mutex the thread is blocked on, 0 if none
+
+    uint32_t event_mask;    // event group flags waited for, then the flags that woke the thread
+    uint8_t event_options;  // EVENTS_ options of that wait
+    uint32_t notify_bits;   // pending G8RTOS_NotifyThread bits
+    semaphore_t notify_wait;// queue holding only this thread while in G8RTOS_WaitNotify
 
     bool alive;          // 0 is dead, 1 is alive
+    bool persistent;     // skipped by G8RTOS_KillAllOthers (worker pool threads)
     char name[MAX_NAME_LENGTH];
     threadId_t id;     // used to quickly find a specific thread
+
+    struct tcb *ready_next; // next tcb in this priority's ready list (BITMAP scheduler), 0 if not ready
+    struct tcb *ready_prev; // previous tcb in this priority's ready list (BITMAP scheduler)
+
+    uint64_t run_cycles;    // total G8RTOS_CYCLES spent running this thread
+    uint32_t switch_in_time;// G8RTOS_CYCLES when the thread was last given the CPU
+    uint32_t switches;      // number of times the thread was switched in
+    uint32_t preemptions;   // times it was switched out while it could still run
+    uint32_t blocks;        // times it was switched out blocked on a semaphore
+
+#ifdef G8RTOS_HOST
+    ucontext_t context;     // saved registers and host stack (G8RTOS_Host.c), sp is unused
+#endif
 };
 
 typedef struct tcb tcb_t; // typedef the tcb structure
 
+/*
+ *  Thread Statistics:
+ *      - Copy of one thread's run time accounting taken by G8RTOS_GetThreadStats
+ *      - Name is null terminated here (tcb names are not)
+ */
+typedef struct
+{
+    char name[MAX_NAME_LENGTH + 1];
+    threadId_t id;
+    uint8_t priority;
+    uint64_t run_cycles;
+    uint32_t switches;
+    uint32_t preemptions;
+    uint32_t blocks;
+    uint32_t max_wait;      // most ms spent ready without running, the current wait included (OPT scheduler)
+    uint32_t stack_size;    // words
+    uint32_t stack_used;    // most words ever used (high-water mark)
+} thread_stats_t;
+
 /*
  *  Periodic Thread Control Block:
  *      - Holds a function pointer that points to the periodic thread to be executed
- *      - Has a period in us
- *      - Holds Current time
- *      - Contains pointer to the next periodic event - linked list
+ *      - Has a period in ms
+ *      - Kept in a min-heap ordered by exec_time (the next release)
+ *      - Records how late each release started and how long the handler ran
  */
 struct ptcb
 {
-    void (*handler)(void); // function pointer to the periodic thread to be executed
+    void (*handler)(void); // function pointer to the periodic thread to be executed, 0 if the slot is free
     uint32_t period;    // period of execution
     uint32_t exec_time; // time that the execution needs to begin (compare to system time)
-    uint32_t curr_time; // ??
-    struct ptcb *next;  // pointer to the next ptcb in the linked list
-    struct ptcb *prev;  // pointer to the previous ptcb in the linked list
+    uint32_t heap_index; // position of this event in the periodic event heap
+    uint32_t overruns;  // times the event fell a whole period behind and releases were skipped
+    cycle_stat_t release_delay; // cycles from the start of the due tick to the handler starting
+    cycle_stat_t exec_cycles;   // cycles spent in the handler
 };
 
 typedef struct ptcb ptcb_t;
 
+/*
+ *  Periodic Event Statistics:
+ *      - Copy of one periodic event's timing taken by G8RTOS_GetPeriodicStats
+ *      - Release jitter is release_delay.max - release_delay.min
+ */
+typedef struct
+{
+    void (*handler)(void);
+    uint32_t period;
+    uint32_t overruns;
+    cycle_stat_t release_delay;
+    cycle_stat_t exec_cycles;
+} periodic_stats_t;
+
 /*********************************************** Data Structure Definitions ***********************************************************/
 
 
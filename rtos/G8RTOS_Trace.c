@@ -0,0 +1,115 @@
+/*
+ * G8RTOS_Trace.c
+ */
+
+/*********************************************** Dependencies and Externs *************************************************************/
+#include "G8RTOS_Trace.h"
+#include "G8RTOS_Scheduler.h"
+#include "G8RTOS_CriticalSection.h"
+#include "BackChannelUart.h"
+
+extern tcb_t * CurrentlyRunningThread;
+
+/*********************************************** Dependencies and Externs *************************************************************/
+
+
+/*********************************************** Data Structures Used *****************************************************************/
+
+/*
+ * Trace ring
+ *  - "TraceHead" counts every record written since the last clear. The
+ *    newest TRACE_RECORDS of them are in the buffer.
+ *  - "TraceNames" holds the name of the last thread added to each slot
+ */
+static trace_record_t TraceBuffer[TRACE_RECORDS];
+static uint32_t TraceHead;
+static bool TraceOn;
+static char TraceNames[MAX_THREADS][MAX_NAME_LENGTH];
+
+/*********************************************** Data Structures Used *****************************************************************/
+
+
+/*********************************************** Public Functions *********************************************************************/
+
+/*
+ * Clears the trace ring and starts recording
+ */
+void G8RTOS_InitTrace(void)
+{
+    TraceHead = 0;
+    TraceOn = true;
+}
+
+/*
+ * Adds one record to the trace ring. Only restores the interrupt state
+ * it found, since the scheduler calls it with interrupts off.
+ */
+void G8RTOS_TraceRecord(uint8_t type, uint32_t arg)
+{
+    uint32_t primask = StartCriticalSection();
+
+    if ( TraceOn )
+    {
+        trace_record_t *record = &TraceBuffer[TraceHead & (TRACE_RECORDS - 1)];
+        record->timestamp = G8RTOS_CYCLES();
+        record->arg = arg;
+        record->thread = G8RTOS_ThreadSlot(CurrentlyRunningThread);
+        record->type = type;
+        TraceHead++;
+    }
+
+    EndCriticalSection(primask);
+}
+
+/*
+ * Remembers the name of the thread added to a slot
+ */
+void G8RTOS_TraceNameThread(uint8_t slot, const char *name)
+{
+    if ( slot >= MAX_THREADS )
+        return;
+
+    for (int i = 0; i < MAX_NAME_LENGTH; i++)
+        TraceNames[slot][i] = name[i];
+}
+
+/*
+ * Prints the thread names and every record, oldest first, then clears the ring
+ */
+void G8RTOS_TraceDump(void)
+{
+    uint32_t primask = StartCriticalSection();
+    TraceOn = false;
+    uint32_t head = TraceHead;
+    EndCriticalSection(primask);
+    __enable_interrupts();
+
+    uint32_t count = (head < TRACE_RECORDS) ? head : TRACE_RECORDS;
+
+    BackChannelPrint("TRACE_BEGIN", BackChannel_Info);
+    BackChannelPrintIntVariable("TRACE_CYCLES_PER_US", ClockSys_GetSysFreq() / 1000000);
+    BackChannelPrintIntVariable("TRACE_LOST", head - count);
+
+    for (int i = 0; i < MAX_THREADS; i++)
+    {
+        if ( TraceNames[i][0] != 0 )
+            BackChannelPrintTraceThread(i, TraceNames[i], MAX_NAME_LENGTH);
+    }
+    BackChannelPrintTraceThread(TRACE_THREAD_IDLE, "KERNEL_IDLE_____", MAX_NAME_LENGTH);
+
+    for (uint32_t i = head - count; i != head; i++)
+    {
+        trace_record_t *record = &TraceBuffer[i & (TRACE_RECORDS - 1)];
+        BackChannelPrintTraceRecord(record->timestamp, record->thread, record->type, record->arg);
+    }
+
+    BackChannelPrint("TRACE_END", BackChannel_Info);
+
+    primask = StartCriticalSection();
+    TraceHead = 0;
+    TraceOn = true;
+    EndCriticalSection(primask);
+    __enable_interrupts();
+}
+
+/*********************************************** Public Functions *********************************************************************/
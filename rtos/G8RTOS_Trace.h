@@ -0,0 +1,117 @@
+/*
+ * G8RTOS_Trace.h
+ */
+
+#ifndef G8RTOS_G8RTOS_TRACE_H_
+#define G8RTOS_G8RTOS_TRACE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Uncomment to record kernel events into the trace ring. When it is
+ * commented out every TRACE() in the kernel compiles to nothing.
+ * Dump the ring with G8RTOS_TraceDump and turn the log into a Chrome /
+ * Perfetto trace with tools/TraceToChrome.c.
+ */
+// #define G8RTOS_TRACE
+
+/*********************************************** Sizes and Limits *********************************************************************/
+#define TRACE_RECORDS       256     // records kept, oldest overwritten first (power of 2)
+#define TRACE_THREAD_IDLE   0xFF    // thread slot of the kernel's fallback idle thread
+#define TRACE_THREAD_NONE   0xFE    // thread slot before G8RTOS_Launch_Priority
+/*********************************************** Sizes and Limits *********************************************************************/
+
+
+/*********************************************** Data Structure Definitions ***********************************************************/
+
+/*
+ * What a trace record is about. The values are part of the dump
+ * format, so only add new ones at the end.
+ */
+typedef enum
+{
+    TRACE_SWITCH        = 0,    // thread switched in, arg = slot switched out
+    TRACE_SEM_WAIT      = 1,    // arg = semaphore address
+    TRACE_SEM_SIGNAL    = 2,    // arg = semaphore address
+    TRACE_SLEEP         = 3,    // arg = ms until wake up
+    TRACE_THREAD_ADD    = 4,    // arg = slot of the new thread
+    TRACE_THREAD_KILL   = 5,    // arg = slot of the killed thread
+    TRACE_ISR_ENTER     = 6,    // arg = exception number (IRQn + 16)
+    TRACE_ISR_EXIT      = 7     // arg = exception number (IRQn + 16)
+} trace_event_t;
+
+/*
+ * One trace record, 12 bytes
+ *  - "thread" is the tcb slot running when the event happened. An ISR
+ *    is charged to the thread it interrupted.
+ */
+typedef struct
+{
+    uint32_t timestamp;     // cycle counter
+    uint32_t arg;           // depends on type
+    uint8_t thread;         // tcb slot, TRACE_THREAD_IDLE or TRACE_THREAD_NONE
+    uint8_t type;           // trace_event_t
+    uint16_t reserved;
+} trace_record_t;
+
+/*********************************************** Data Structure Definitions ***********************************************************/
+
+
+/*********************************************** Kernel Hooks *************************************************************************/
+
+#ifdef G8RTOS_HOST
+#define TRACE_EXCEPTION()   G8RTOS_HostActiveException()
+#else
+#define TRACE_EXCEPTION()   (SCB->ICSR & SCB_ICSR_VECTACTIVE_Msk)
+#endif
+
+#ifdef G8RTOS_TRACE
+#define TRACE(type, arg)    G8RTOS_TraceRecord((type), (uint32_t)(uintptr_t)(arg))
+#define TRACE_ISR_ENTER()   G8RTOS_TraceRecord(TRACE_ISR_ENTER, TRACE_EXCEPTION())
+#define TRACE_ISR_EXIT()    G8RTOS_TraceRecord(TRACE_ISR_EXIT, TRACE_EXCEPTION())
+#else
+#define TRACE(type, arg)
+#define TRACE_ISR_ENTER()
+#define TRACE_ISR_EXIT()
+#endif
+
+/*********************************************** Kernel Hooks *************************************************************************/
+
+
+/*********************************************** Public Functions *********************************************************************/
+
+/*
+ * Clears the trace ring and starts recording
+ */
+void G8RTOS_InitTrace(void);
+
+/*
+ * Adds one record to the trace ring. Safe from threads and from
+ * interrupts that may call the kernel. Use the TRACE() macros instead
+ * so the call disappears when G8RTOS_TRACE is off.
+ * Param "type": trace_event_t
+ * Param "arg": event argument, see trace_event_t
+ */
+void G8RTOS_TraceRecord(uint8_t type, uint32_t arg);
+
+/*
+ * Remembers the name of the thread added to a slot. Only the last name
+ * per slot is kept, so if a slot is reused while its old records are
+ * still in the ring, the dump labels them with the new thread's name.
+ * TRACE_THREAD_ADD records show where in the ring a slot was reused.
+ * Param "slot": tcb slot
+ * Param "name": thread name, MAX_NAME_LENGTH characters
+ */
+void G8RTOS_TraceNameThread(uint8_t slot, const char *name);
+
+/*
+ * Prints the thread names and every record, oldest first, over the back
+ * channel UART, then clears the ring. Recording is paused while the UART
+ * drains it, so call it from a low priority thread, e.g. after a late frame.
+ */
+void G8RTOS_TraceDump(void);
+
+/*********************************************** Public Functions *********************************************************************/
+
+#endif /* G8RTOS_G8RTOS_TRACE_H_ */
@@ -0,0 +1,183 @@
+/*
+ * G8RTOS_WorkerPool.c
+ */
+
+/*********************************************** Dependencies and Externs *************************************************************/
+#include "G8RTOS_WorkerPool.h"
+#include "G8RTOS_CriticalSection.h"
+
+/*********************************************** Dependencies and Externs *************************************************************/
+
+
+/*********************************************** Data Structures Used *****************************************************************/
+
+/*
+ * Job queue shared by every worker
+ *  - ring buffer of job functions and the priority each runs at, read
+ *    at head and written at tail
+ *  - "count" is the number of jobs in the ring
+ *  - "pending" signals workers that a job was queued. A cancelled job
+ *    leaves its signal behind, so a worker may wake to an empty queue.
+ *  - "busy" counts workers between taking a job and finishing it
+ */
+static job_t JobQueue[JOB_QUEUE_SIZE];
+static uint8_t JobPriority[JOB_QUEUE_SIZE];
+static uint8_t PoolPriority;
+static uint32_t JobHead;
+static uint32_t JobTail;
+static uint32_t JobCount;
+static semaphore_t JobsPending;
+static uint32_t WorkersBusy;
+
+/*********************************************** Data Structures Used *****************************************************************/
+
+
+/*********************************************** Private Functions ********************************************************************/
+
+/*
+ * Moves the calling worker to a new priority. The permanent priority
+ * changes too, so releasing a mutex or aging drops back to it and not
+ * to the pool's.
+ */
+static void SetWorkerPriority(uint8_t priority)
+{
+    uint32_t primask = StartCriticalSection();
+    CurrentlyRunningThread->priority_perm = priority;
+    G8RTOS_ChangePriority(CurrentlyRunningThread, priority);
+    EndCriticalSection(primask);
+    __enable_interrupts();
+}
+
+/*
+ * Worker thread. Waits for a job, runs it, and goes back to waiting
+ * instead of dying, so a job costs no thread creation or stack allocation.
+ */
+static void Worker(void)
+{
+    G8RTOS_MakePersistent();
+
+    while(1)
+    {
+        G8RTOS_WaitSemaphore(&JobsPending);
+
+        uint32_t primask = StartCriticalSection();
+        if ( JobCount == 0 )
+        {
+            EndCriticalSection(primask);
+            __enable_interrupts();
+            continue;
+        }
+
+        job_t job = JobQueue[JobHead];
+        uint8_t priority = JobPriority[JobHead];
+        JobHead = (JobHead + 1) % JOB_QUEUE_SIZE;
+        JobCount--;
+        WorkersBusy++;
+        EndCriticalSection(primask);
+        __enable_interrupts();
+
+        if ( priority != PoolPriority )
+        {
+            SetWorkerPriority(priority);
+            job();
+            SetWorkerPriority(PoolPriority);
+        }
+        else
+            job();
+
+        primask = StartCriticalSection();
+        WorkersBusy--;
+        EndCriticalSection(primask);
+        __enable_interrupts();
+    }
+}
+
+/*********************************************** Private Functions ********************************************************************/
+
+
+/*********************************************** Public Functions *********************************************************************/
+
+/*
+ * Adds the worker threads and clears the job queue
+ */
+sched_err_code_t G8RTOS_InitWorkerPool(uint32_t workers, uint8_t priority, uint32_t stackSize)
+{
+    JobHead = 0;
+    JobTail = 0;
+    JobCount = 0;
+    WorkersBusy = 0;
+    PoolPriority = priority;
+    G8RTOS_InitSemaphore(&JobsPending, 0);
+
+    if ( workers > MAX_WORKERS )
+        workers = MAX_WORKERS;
+
+    for (uint32_t i = 0; i < workers; i++)
+    {
+        sched_err_code_t err = G8RTOS_AddThread( &Worker, priority, 0xFFFFFFFF, stackSize, "WORKER__________" );
+        if ( err != NO_ERROR )
+            return err;
+    }
+
+    return NO_ERROR;
+}
+
+/*
+ * Queues a job for the next free worker
+ */
+int G8RTOS_SubmitJob(job_t job)
+{
+    return G8RTOS_SubmitJob_Priority(job, PoolPriority);
+}
+
+/*
+ * Queues a job that runs at its own priority
+ */
+int G8RTOS_SubmitJob_Priority(job_t job, uint8_t priority)
+{
+    uint32_t primask = StartCriticalSection();
+
+    if ( JobCount >= JOB_QUEUE_SIZE )
+    {
+        EndCriticalSection(primask);
+        __enable_interrupts();
+        return -1;
+    }
+
+    JobQueue[JobTail] = job;
+    JobPriority[JobTail] = priority;
+    JobTail = (JobTail + 1) % JOB_QUEUE_SIZE;
+    JobCount++;
+    EndCriticalSection(primask);
+    __enable_interrupts();
+
+    // wakes a worker, which preempts the caller if it has a higher priority
+    G8RTOS_SignalSemaphore(&JobsPending);
+    return 0;
+}
+
+/*
+ * Drops every queued job no worker has taken yet
+ */
+uint32_t G8RTOS_CancelJobs(void)
+{
+    uint32_t primask = StartCriticalSection();
+    uint32_t dropped = JobCount;
+
+    JobHead = JobTail;
+    JobCount = 0;
+    EndCriticalSection(primask);
+    __enable_interrupts();
+
+    return dropped;
+}
+
+/*
+ * Returns the number of workers running a job right now
+ */
+uint32_t G8RTOS_WorkersBusy(void)
+{
+    return WorkersBusy;
+}
+
+/*********************************************** Public Functions *********************************************************************/
@@ -0,0 +1,76 @@
+/*
+ * G8RTOS_WorkerPool.h
+ */
+
+#ifndef G8RTOS_G8RTOS_WORKERPOOL_H_
+#define G8RTOS_G8RTOS_WORKERPOOL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "G8RTOS_Structures.h"
+#include "G8RTOS_Semaphores.h"
+#include "G8RTOS_Scheduler.h"
+
+/*********************************************** Sizes and Limits *********************************************************************/
+#define MAX_WORKERS     12      // most worker threads one pool can have
+#define JOB_QUEUE_SIZE  16      // jobs that can wait for a free worker
+/*********************************************** Sizes and Limits *********************************************************************/
+
+
+/*********************************************** Data Structure Definitions ***********************************************************/
+
+/*
+ * A job is a function run to completion by one worker thread.
+ * It may sleep, block and take mutexes like any thread. It must
+ * return instead of calling G8RTOS_KillSelf.
+ */
+typedef void (*job_t)(void);
+
+/*********************************************** Data Structure Definitions ***********************************************************/
+
+
+/*********************************************** Public Functions *********************************************************************/
+
+/*
+ * Adds the worker threads and clears the job queue. Workers are
+ * persistent, so G8RTOS_KillAllOthers leaves them waiting for jobs.
+ * Call once, before or after G8RTOS_Launch_Priority.
+ * Param "workers": number of worker threads (at most MAX_WORKERS)
+ * Param "priority": priority every job runs at
+ * Param "stackSize": stack of each worker in words, sized for the largest job
+ * Returns: error code from G8RTOS_AddThread, NO_ERROR if every worker was added
+ */
+sched_err_code_t G8RTOS_InitWorkerPool(uint32_t workers, uint8_t priority, uint32_t stackSize);
+
+/*
+ * Queues a job for the next free worker. Never blocks, so it can be
+ * called from threads and periodic events.
+ * Param "job": function to run
+ * Returns: 0 if queued, -1 if the job queue is full
+ */
+int G8RTOS_SubmitJob(job_t job);
+
+/*
+ * Queues a job that runs at its own priority instead of the pool's.
+ * The worker returns to the pool's priority when the job returns.
+ * Param "job": function to run
+ * Param "priority": priority the job runs at
+ * Returns: 0 if queued, -1 if the job queue is full
+ */
+int G8RTOS_SubmitJob_Priority(job_t job, uint8_t priority);
+
+/*
+ * Drops every queued job no worker has taken yet. Jobs already running
+ * are not affected.
+ * Returns: number of jobs dropped
+ */
+uint32_t G8RTOS_CancelJobs(void);
+
+/*
+ * Returns: number of workers running a job right now
+ */
+uint32_t G8RTOS_WorkersBusy(void);
+
+/*********************************************** Public Functions *********************************************************************/
+
+#endif /* G8RTOS_G8RTOS_WORKERPOOL_H_ */
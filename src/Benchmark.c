@@ -0,0 +1,612 @@
+/*
+ * Benchmark.c
+ *
+ *  Kernel timing workloads. See Benchmark.h for how to run them.
+ */
+
+#include "Benchmark.h"
+
+// ======================       GLOBALS            ==========================
+
+#ifdef BENCH_TICK
+// thread counts (reporter and idle included) measured by the tick benchmark, in order
+static const uint8_t TickThreadCounts[] = { 2, 8, BENCH_THREADS };
+#endif
+
+#ifdef BENCH_MUTEX
+// cycles from the high priority thread asking for the lock to getting it
+static cycle_stat_t LockBlockCycles;
+#endif
+
+#ifdef BENCH_IPC
+// cycles to send or receive one message through each IPC path
+static cycle_stat_t FifoWriteCycles;
+static cycle_stat_t FifoReadCycles;
+static cycle_stat_t RingWriteCycles;
+static cycle_stat_t RingReadCycles;
+
+static uint8_t BenchRingBuffer[BENCH_RING_SIZE];
+static ring_t BenchRing;
+#endif
+
+#ifdef BENCH_IRQ_LATENCY
+// cycles from Timer32 reaching zero to its handler running
+static cycle_stat_t IrqLatencyCycles;
+#endif
+
+#ifdef BENCH_KILL
+// threads the last G8RTOS_KillAllOthers call killed
+static uint32_t KillVictims;
+#endif
+
+#ifdef BENCH_FAIRNESS
+// thread accounting read by the reporter, too big for its stack
+static thread_stats_t FairStats[MAX_THREADS + 1];
+#endif
+
+#ifdef BENCH_SWITCH
+// cycles from a ping signalling its pong to the pong running
+static cycle_stat_t SwitchIntCycles;
+static cycle_stat_t SwitchFpuCycles;
+
+static uint32_t SwitchIntStart;
+static uint32_t SwitchFpuStart;
+
+// float work kept live so the compiler has to use the FPU registers
+static volatile float SwitchFpuValue = 1.0f;
+#endif
+
+// ======================      SEMAPHORES          ==========================
+
+// never signalled. Threads waiting on it stay blocked for the whole run.
+semaphore_t BENCH_NEVER;
+
+#ifdef BENCH_MUTEX
+// the lock fought over by the priority inversion threads
+#ifdef BENCH_MUTEX_AS_SEMAPHORE
+semaphore_t BENCH_LOCK;
+#define BenchLockInit()     G8RTOS_InitSemaphore(&BENCH_LOCK, 1)
+#define BenchLockTake()     G8RTOS_WaitSemaphore(&BENCH_LOCK)
+#define BenchLockGive()     G8RTOS_SignalSemaphore(&BENCH_LOCK)
+#else
+mutex_t BENCH_LOCK;
+#define BenchLockInit()     G8RTOS_InitMutex(&BENCH_LOCK)
+#define BenchLockTake()     G8RTOS_AcquireMutex(&BENCH_LOCK)
+#define BenchLockGive()     G8RTOS_ReleaseMutex(&BENCH_LOCK)
+#endif
+#endif
+
+#ifdef BENCH_SWITCH
+// signalled by each ping to wake its pong
+semaphore_t BENCH_PONG_INT;
+semaphore_t BENCH_PONG_FPU;
+#endif
+
+// ======================   BENCHMARK THREADS      ==========================
+
+/*
+ * Sleeps for a thread dependent 2 - 35 ms forever, like the game threads.
+ * Sleeping threads are what the ORIG and OPT schedulers have to walk past
+ * on every switch and what SysTick used to scan on every tick.
+ */
+void BenchSleeper()
+{
+    uint32_t period = THREAD_ID_SLOT(G8RTOS_GetThreadId()) * 33 / (MAX_THREADS - 1) + 2;
+
+    while(1)
+    {
+        sleep(period);
+    }
+}
+
+/*
+ * Blocks on a semaphore that is never signalled.
+ */
+void BenchBlocker()
+{
+    G8RTOS_WaitSemaphore(&BENCH_NEVER);
+    while(1);
+}
+
+/*
+ * Lowest priority thread. Lets the CPU sleep when nothing else can run.
+ */
+void BenchIdle()
+{
+    while(1)
+    {
+        G8RTOS_Idle();
+    }
+}
+
+/*
+ * Low priority busy thread. Two or more of these force the scheduler
+ * to round robin inside one priority level.
+ */
+void BenchSpinner()
+{
+    while(1);
+}
+
+#ifdef BENCH_MUTEX
+/*
+ * Burns roughly "ms" milliseconds of this thread's own CPU time.
+ * A loop count is used instead of SystemTime so time spent
+ * preempted does not count toward the work.
+ */
+static void BenchBusy(uint32_t ms)
+{
+    for (volatile uint32_t i = 0; i < ms * BENCH_LOOPS_PER_MS; i++);
+}
+
+/*
+ * High priority lock user. Records how long it waits for the lock.
+ */
+void BenchLockHigh()
+{
+    while(1)
+    {
+        sleep(7);
+
+        uint32_t start = G8RTOS_CYCLES();
+        BenchLockTake();
+        G8RTOS_RecordCycleStat(&LockBlockCycles, G8RTOS_CYCLES() - start);
+        BenchLockGive();
+    }
+}
+
+/*
+ * Medium priority thread that never touches the lock. Without
+ * priority inheritance it preempts the lock owner.
+ */
+void BenchLockMedium()
+{
+    while(1)
+    {
+        sleep(11);
+        BenchBusy(BENCH_MEDIUM_BUSY_MS);
+    }
+}
+
+/*
+ * Low priority lock user. Holds the lock most of the time.
+ */
+void BenchLockLow()
+{
+    while(1)
+    {
+        BenchLockTake();
+        BenchBusy(BENCH_LOCK_HOLD_MS);
+        BenchLockGive();
+        sleep(1);
+    }
+}
+#endif
+
+#ifdef BENCH_IPC
+/*
+ * Sends the same message through FIFO 0 and the ring every ms
+ */
+void BenchIpcProducer()
+{
+    uint32_t msg[BENCH_IPC_WORDS] = { 0 };
+
+    while(1)
+    {
+        sleep(1);
+        msg[0]++;
+
+        uint32_t start = G8RTOS_CYCLES();
+        for (int i = 0; i < BENCH_IPC_WORDS; i++)
+            writeFIFO(0, msg[i]);
+        G8RTOS_RecordCycleStat(&FifoWriteCycles, G8RTOS_CYCLES() - start);
+
+        start = G8RTOS_CYCLES();
+        G8RTOS_RingWrite(&BenchRing, msg, sizeof(msg));
+        G8RTOS_RecordCycleStat(&RingWriteCycles, G8RTOS_CYCLES() - start);
+    }
+}
+
+/*
+ * Reads each message back from both paths. The producer outranks this
+ * thread and writes the FIFO first, so once the ring has a record the
+ * FIFO reads never block and only the copy cost is timed.
+ */
+void BenchIpcConsumer()
+{
+    uint32_t msg[BENCH_IPC_WORDS];
+
+    while(1)
+    {
+        if ( G8RTOS_RingUsed(&BenchRing) == 0 )
+        {
+            sleep(1);
+            continue;
+        }
+
+        uint32_t start = G8RTOS_CYCLES();
+        for (int i = 0; i < BENCH_IPC_WORDS; i++)
+            msg[i] = readFIFO(0);
+        G8RTOS_RecordCycleStat(&FifoReadCycles, G8RTOS_CYCLES() - start);
+
+        start = G8RTOS_CYCLES();
+        G8RTOS_RingRead(&BenchRing, msg, sizeof(msg));
+        G8RTOS_RecordCycleStat(&RingReadCycles, G8RTOS_CYCLES() - start);
+    }
+}
+#endif
+
+#ifdef BENCH_DEFERRED
+/*
+ * Bottom half with a little work, about the size of the button handler
+ */
+void BenchBottomHalf(uint32_t arg)
+{
+    for (volatile uint32_t i = 0; i < arg; i++);
+}
+
+/*
+ * Top half. Only posts the bottom half.
+ */
+void BenchTopHalf(void)
+{
+    uint32_t start = G8RTOS_CYCLES();
+
+    G8RTOS_DeferWork(&BenchBottomHalf, 50);
+
+    G8RTOS_RecordIsrCycles(start);
+}
+
+/*
+ * Raises the benchmark interrupt every ms
+ */
+void BenchInterrupter()
+{
+    while(1)
+    {
+        sleep(1);
+        NVIC_SetPendingIRQ(BENCH_DEFERRED_IRQn);
+    }
+}
+#endif
+
+#ifdef BENCH_IRQ_LATENCY
+/*
+ * Timer32 1 handler. Runs at priority 0, so with KERNEL_BASEPRI it is
+ * never masked by the kernel and must not call it.
+ */
+void BenchLatencyIsr(void)
+{
+    uint32_t latency = (BENCH_IRQ_PERIOD - 1) - TIMER32_1->VALUE;
+    TIMER32_1->INTCLR = 0;
+
+    G8RTOS_RecordCycleStat(&IrqLatencyCycles, latency);
+}
+
+/*
+ * Dies right away. Adding and killing it runs the longest kernel paths.
+ */
+void BenchShortLived()
+{
+    G8RTOS_KillSelf();
+}
+
+/*
+ * Adds a few short lived threads every ms
+ */
+void BenchChurn()
+{
+    while(1)
+    {
+        for (int i = 0; i < BENCH_CHURN_THREADS; i++)
+            G8RTOS_AddThread( &BenchShortLived, 200, 0xFFFFFFFF, BENCH_STACKSIZE, "BENCH_SHORT_LIVE" );
+
+        sleep(1);
+    }
+}
+#endif
+
+#ifdef BENCH_SWITCH
+/*
+ * Integer only pair. Neither thread ever has FPU state to save.
+ */
+void BenchPingInt()
+{
+    while(1)
+    {
+        sleep(1);
+        SwitchIntStart = G8RTOS_CYCLES();
+        G8RTOS_SignalSemaphore(&BENCH_PONG_INT);
+    }
+}
+
+void BenchPongInt()
+{
+    while(1)
+    {
+        G8RTOS_WaitSemaphore(&BENCH_PONG_INT);
+        G8RTOS_RecordCycleStat(&SwitchIntCycles, G8RTOS_CYCLES() - SwitchIntStart);
+    }
+}
+
+/*
+ * FPU pair. Both threads use the FPU right before switching, so the
+ * switch out saves and the switch in restores the FPU registers.
+ */
+void BenchPingFpu()
+{
+    while(1)
+    {
+        sleep(1);
+        SwitchFpuValue = SwitchFpuValue * 1.0001f + 0.5f;
+        SwitchFpuStart = G8RTOS_CYCLES();
+        G8RTOS_SignalSemaphore(&BENCH_PONG_FPU);
+    }
+}
+
+void BenchPongFpu()
+{
+    while(1)
+    {
+        SwitchFpuValue = SwitchFpuValue * 0.9999f - 0.5f;
+        G8RTOS_WaitSemaphore(&BENCH_PONG_FPU);
+        G8RTOS_RecordCycleStat(&SwitchFpuCycles, G8RTOS_CYCLES() - SwitchFpuStart);
+    }
+}
+#endif
+
+#ifdef BENCH_KILL
+/*
+ * Fills every free tcb slot with sleepers and blockers, gives them time
+ * to go to sleep or block, then kills them all at once, like the end of
+ * a round of the game. The kernel records how long G8RTOS_KillAllOthers
+ * keeps interrupts masked.
+ */
+void BenchKiller()
+{
+    while(1)
+    {
+        uint32_t victims = 0;
+        while ( G8RTOS_AddThread( (victims % 3 == 0) ? &BenchBlocker : &BenchSleeper, 20 + victims,
+                                  0xFFFFFFFF, BENCH_STACKSIZE, "BENCH_VICTIM____" ) == NO_ERROR )
+            victims++;
+
+        sleep(BENCH_KILL_PERIOD);
+
+        G8RTOS_KillAllOthers();
+        KillVictims = victims;
+    }
+}
+#endif
+
+/*
+ * Prints every enabled statistic, then clears it for the next period.
+ */
+void BenchReporter()
+{
+#ifdef BENCH_TICK
+    uint32_t phase = 0;
+    uint32_t threads = TickThreadCounts[0];
+#endif
+
+    cpu_usage_t usage;
+
+#ifdef BENCH_KILL
+    G8RTOS_MakePersistent();
+#endif
+
+    while(1)
+    {
+        sleep(BENCH_REPORT_PERIOD);
+
+        // share of the last period the CPU spent stopped in G8RTOS_Idle
+        G8RTOS_GetCpuUsage(&usage);
+        BackChannelPrintIntVariable("IDLE_PERCENT",
+                (int32_t)(usage.idle_cycles * 100 / (usage.idle_cycles + usage.busy_cycles + 1)));
+        BackChannelPrintIntVariable("SUPPRESSED_TICKS", usage.suppressed_ticks);
+        G8RTOS_ResetCpuUsage();
+
+#ifdef BENCH_PRINT_THREADS
+        G8RTOS_PrintThreadStats();
+        G8RTOS_ResetThreadStats();
+#endif
+
+#ifdef BENCH_TICK
+        // report the tick cost for the current thread count, then add
+        // sleepers until the next count in the table is reached
+        BackChannelPrintIntVariable("TICK_THREADS", threads);
+        G8RTOS_PrintCycleStat("TICK", &TickCycles);
+
+        if ( phase < sizeof(TickThreadCounts) - 1 )
+        {
+            phase++;
+            for ( ; threads < TickThreadCounts[phase]; threads++ )
+                G8RTOS_AddThread( &BenchSleeper, 1, 0xFFFFFFFF, BENCH_STACKSIZE, "BENCH_SLEEPER___" );
+        }
+
+        G8RTOS_ResetCycleStat(&TickCycles);
+#endif
+
+#ifdef BENCH_SCHEDULER
+        G8RTOS_PrintCycleStat("SCHEDULER", &SchedulerCycles);
+        G8RTOS_ResetCycleStat(&SchedulerCycles);
+#endif
+
+#ifdef BENCH_PERIODIC
+        G8RTOS_PrintPeriodicStats();
+        G8RTOS_ResetPeriodicStats();
+#endif
+
+#ifdef BENCH_MUTEX
+        G8RTOS_PrintCycleStat("LOCK_BLOCK", &LockBlockCycles);
+        G8RTOS_ResetCycleStat(&LockBlockCycles);
+#endif
+
+#ifdef BENCH_IPC
+        G8RTOS_PrintCycleStat("FIFO_WRITE", &FifoWriteCycles);
+        G8RTOS_PrintCycleStat("FIFO_READ", &FifoReadCycles);
+        G8RTOS_PrintCycleStat("RING_WRITE", &RingWriteCycles);
+        G8RTOS_PrintCycleStat("RING_READ", &RingReadCycles);
+        G8RTOS_ResetCycleStat(&FifoWriteCycles);
+        G8RTOS_ResetCycleStat(&FifoReadCycles);
+        G8RTOS_ResetCycleStat(&RingWriteCycles);
+        G8RTOS_ResetCycleStat(&RingReadCycles);
+#endif
+
+#ifdef BENCH_DEFERRED
+        G8RTOS_PrintDeferredStats();
+        G8RTOS_ResetDeferredStats();
+#endif
+
+#ifdef BENCH_IRQ_LATENCY
+        // the handler is not masked by kernel critical sections, so take a copy with PRIMASK
+        uint32_t primask = (StartCriticalSection)();
+        cycle_stat_t latency = IrqLatencyCycles;
+        G8RTOS_ResetCycleStat(&IrqLatencyCycles);
+        (EndCriticalSection)(primask);
+
+#ifdef KERNEL_BASEPRI
+        BackChannelPrintIntVariable("KERNEL_BASEPRI", 1);
+#else
+        BackChannelPrintIntVariable("KERNEL_BASEPRI", 0);
+#endif
+        G8RTOS_PrintCycleStat("IRQ_LATENCY", &latency);
+#endif
+
+#ifdef G8RTOS_TRACE
+        // timeline of the end of the period, for tools/TraceToChrome
+        G8RTOS_TraceDump();
+#endif
+
+#ifdef BENCH_KILL
+        BackChannelPrintIntVariable("KILL_VICTIMS", KillVictims);
+        G8RTOS_PrintCycleStat("KILL_ALL_MASKED", &KillAllCycles);
+        G8RTOS_ResetCycleStat(&KillAllCycles);
+#endif
+
+#ifdef BENCH_FAIRNESS
+        // every thread between the hogs and the idle threads
+        uint32_t fairCount = G8RTOS_GetThreadStats(FairStats, MAX_THREADS + 1);
+        for (int i = 0; i < fairCount; i++)
+        {
+            if ( FairStats[i].priority > BENCH_FAIR_HOG_PRIORITY && FairStats[i].priority < 255 )
+            {
+                BackChannelPrint(FairStats[i].name, BackChannel_Info);
+                BackChannelPrintIntVariable("MAX_WAIT_MS", FairStats[i].max_wait);
+            }
+        }
+        G8RTOS_ResetThreadStats();
+#endif
+
+#ifdef BENCH_SWITCH
+        G8RTOS_PrintCycleStat("SWITCH_INT", &SwitchIntCycles);
+        G8RTOS_PrintCycleStat("SWITCH_FPU", &SwitchFpuCycles);
+        G8RTOS_ResetCycleStat(&SwitchIntCycles);
+        G8RTOS_ResetCycleStat(&SwitchFpuCycles);
+#endif
+    }
+}
+
+#ifdef BENCH_PERIODIC
+/*
+ * Periodic event with a little work, about the size of a joystick read
+ */
+void BenchPeriodic()
+{
+    for (volatile uint32_t i = 0; i < 50; i++);
+}
+#endif
+
+// ======================   PUBLIC FUNCTIONS       ==========================
+
+/*
+ * Adds the threads for every enabled benchmark
+ */
+void Benchmark_Init(void)
+{
+    G8RTOS_InitSemaphore(&BENCH_NEVER, 0);
+    G8RTOS_AddThread( &BenchReporter, 0, 0xFFFFFFFF, STACKSIZE, "BENCH_REPORTER__" );
+    G8RTOS_AddThread( &BenchIdle, 255, 0xFFFFFFFF, BENCH_STACKSIZE, "BENCH_IDLE______" );
+
+#ifdef BENCH_SCHEDULER
+    // the high priority threads are the ones the list walk has to skip.
+    // every third one is blocked, the rest sleep.
+    for (int i = 1; i < BENCH_THREADS - BENCH_SPINNERS; i++)
+    {
+        if ( i % 3 == 0 )
+            G8RTOS_AddThread( &BenchBlocker, i, 0xFFFFFFFF, BENCH_STACKSIZE, "BENCH_BLOCKER___" );
+        else
+            G8RTOS_AddThread( &BenchSleeper, i, 0xFFFFFFFF, BENCH_STACKSIZE, "BENCH_SLEEPER___" );
+    }
+
+    for (int i = 0; i < BENCH_SPINNERS; i++)
+    {
+        G8RTOS_AddThread( &BenchSpinner, 200, 0xFFFFFFFF, BENCH_STACKSIZE, "BENCH_SPINNER___" );
+    }
+#endif
+
+#ifdef BENCH_PERIODIC
+    for (int i = 1; i <= BENCH_PERIODIC_EVENTS; i++)
+        G8RTOS_AddPeriodicEvent( &BenchPeriodic, i );
+#endif
+
+#ifdef BENCH_MUTEX
+    BenchLockInit();
+    G8RTOS_ResetCycleStat(&LockBlockCycles);
+    G8RTOS_AddThread( &BenchLockHigh, 2, 0xFFFFFFFF, BENCH_STACKSIZE, "BENCH_LOCK_HIGH_" );
+    G8RTOS_AddThread( &BenchLockMedium, 3, 0xFFFFFFFF, BENCH_STACKSIZE, "BENCH_LOCK_MED__" );
+    G8RTOS_AddThread( &BenchLockLow, 4, 0xFFFFFFFF, BENCH_STACKSIZE, "BENCH_LOCK_LOW__" );
+#endif
+
+#ifdef BENCH_IPC
+    G8RTOS_InitFIFO(0);
+    G8RTOS_InitRing(&BenchRing, BenchRingBuffer, BENCH_RING_SIZE);
+    G8RTOS_AddThread( &BenchIpcProducer, 5, 0xFFFFFFFF, BENCH_STACKSIZE, "BENCH_IPC_PROD__" );
+    G8RTOS_AddThread( &BenchIpcConsumer, 6, 0xFFFFFFFF, BENCH_STACKSIZE, "BENCH_IPC_CONS__" );
+#endif
+
+#ifdef BENCH_DEFERRED
+    G8RTOS_InitDeferredWork();
+    G8RTOS_AddAperiodicEvent_Priority( &BenchTopHalf, KERNEL_IRQ_PRIORITY, BENCH_DEFERRED_IRQn );
+    G8RTOS_AddThread( &BenchInterrupter, 7, 0xFFFFFFFF, BENCH_STACKSIZE, "BENCH_INTERRUPT_" );
+#endif
+
+#ifdef BENCH_IRQ_LATENCY
+    G8RTOS_AddThread( &BenchChurn, 8, 0xFFFFFFFF, BENCH_STACKSIZE, "BENCH_CHURN_____" );
+    G8RTOS_AddThread( &BenchChurn, 9, 0xFFFFFFFF, BENCH_STACKSIZE, "BENCH_CHURN_____" );
+
+    // not an aperiodic event: it sits above KERNEL_IRQ_PRIORITY on purpose
+    __NVIC_SetVector(T32_INT1_IRQn, (uint32_t)&BenchLatencyIsr);
+    __NVIC_SetPriority(T32_INT1_IRQn, 0);
+    __NVIC_EnableIRQ(T32_INT1_IRQn);
+
+    // free running 32 bit periodic timer on MCLK, the same clock as the cycle counter
+    TIMER32_1->LOAD = BENCH_IRQ_PERIOD - 1;
+    TIMER32_1->CONTROL = TIMER32_CONTROL_SIZE | TIMER32_CONTROL_MODE | TIMER32_CONTROL_IE | TIMER32_CONTROL_ENABLE;
+#endif
+
+#ifdef BENCH_SWITCH
+    G8RTOS_InitSemaphore(&BENCH_PONG_INT, 0);
+    G8RTOS_InitSemaphore(&BENCH_PONG_FPU, 0);
+    G8RTOS_ResetCycleStat(&SwitchIntCycles);
+    G8RTOS_ResetCycleStat(&SwitchFpuCycles);
+    G8RTOS_AddThread( &BenchPongInt, 3, 0xFFFFFFFF, BENCH_STACKSIZE, "BENCH_PONG_INT__" );
+    G8RTOS_AddThread( &BenchPingInt, 4, 0xFFFFFFFF, BENCH_STACKSIZE, "BENCH_PING_INT__" );
+    G8RTOS_AddThread( &BenchPongFpu, 5, 0xFFFFFFFF, BENCH_STACKSIZE, "BENCH_PONG_FPU__" );
+    G8RTOS_AddThread( &BenchPingFpu, 6, 0xFFFFFFFF, BENCH_STACKSIZE, "BENCH_PING_FPU__" );
+#endif
+
+#ifdef BENCH_KILL
+    G8RTOS_AddThread( &BenchKiller, 1, 0xFFFFFFFF, BENCH_STACKSIZE, "BENCH_KILLER____" );
+#endif
+
+#ifdef BENCH_FAIRNESS
+    G8RTOS_SetQuantum( BENCH_FAIR_HOG_PRIORITY, BENCH_FAIR_QUANTUM );
+    for (int i = 0; i < BENCH_SPINNERS; i++)
+        G8RTOS_AddThread( &BenchSpinner, BENCH_FAIR_HOG_PRIORITY, 0xFFFFFFFF, BENCH_STACKSIZE, "BENCH_HOG_______" );
+
+    for (int i = 1; i <= BENCH_FAIR_AGED; i++)
+        G8RTOS_AddThread( &BenchSleeper, BENCH_FAIR_HOG_PRIORITY + i, BENCH_FAIR_AGE, BENCH_STACKSIZE, "BENCH_FAIR_AGED_" );
+    G8RTOS_AddThread( &BenchSleeper, BENCH_FAIR_HOG_PRIORITY + BENCH_FAIR_AGED + 1, 0xFFFFFFFF, BENCH_STACKSIZE, "BENCH_FAIR_NEVER" );
+#endif
+}
@@ -30,49 +30,270 @@
  */
 
 #include "Game.h"
+#include "Physics.h"
 
 // ======================       GLOBALS            ==========================
 GameState_t gamestate;
 GameState_t packet;
 SpecificPlayerInfo_t client_player;
 uint8_t playerCount = 2;
-uint8_t ballCount = 0;
+uint16_t ballCount = 0;
 PrevBall_t previousBalls[MAX_NUM_OF_BALLS];
 gameNextState nextState = NA;   // set next game state to NA
 int16_t displacement = 160;
-playerType  myPlayerType = None;
+volatile playerType myPlayerType = None;    // set by the button interrupt while main waits on it
 uint8_t     GameInitMode = 1;
+threadId_t  LEDThreadId = 0;        // MoveLEDs of the current round, notified on score changes
+uint8_t     ClientInputBuffer[CLIENT_INPUT_RING_SIZE];
+ring_t      ClientInputRing;        // client input records, ReceiveDataFromClient -> ReadJoystickHost
+uint32_t    PacketPoolStorage[MEM_POOL_WORDS(sizeof(GameState_t), PACKET_BUFFERS)];
+mem_pool_t  PacketPool;             // client: buffers packets from the host are received into
+void *      PacketQueueSlots[PACKET_BUFFERS];
+ptr_queue_t PacketQueue;            // client: received packets, ReceiveDataFromHost -> DrawObjects
+uint8_t     RoundGeneration = 0;    // bumped when a round ends so leftover ball jobs return
+bool        EndOfGameQueued = false;// end of game work already started for this round
+
+#ifdef PHYSICS_ENGINE
+ball_store_t Balls;                 // host: every ball, stepped by PhysicsEngine
+GameState_t  Snapshots[2];          // host: gamestate as of the last two published ticks
+volatile uint32_t SnapshotSeq = 0;  // host: publish count, Snapshots[SnapshotSeq & 1] is the newest
+GameState_t  HostFrame;             // host: DrawObjects' copy of the snapshot
+uint8_t      KillTicks[MAX_NUM_OF_BALLS];   // ticks until a dead ball's slot is free again
+uint32_t     NextSpawnTick;         // tick GenerateBall's rule starts the next ball at
+uint32_t     SimDroppedTicks = 0;   // ticks skipped because the simulation fell too far behind
+#endif
+
+#ifdef BENCH_PHYSICS
+cycle_stat_t PhysicsStepCycles[MAX_NUM_OF_BALLS + 1];  // step cost by live ball count
+#endif
+
+#ifdef BENCH_COLLISIONS
+uint32_t     CollisionSteps[MAX_NUM_OF_BALLS + 1];  // steps by live ball count
+uint32_t     CollisionPairs[MAX_NUM_OF_BALLS + 1];  // ball pairs the grid tested in them
+#endif
+
+#ifdef BENCH_BALL_STRESS
+cycle_stat_t StressFrameCycles;     // host: one DrawObjects frame
+cycle_stat_t StressTickCycles;      // one simulation tick
+uint32_t     StressLateFrames = 0;  // frames that ran past the start of the next one
+#endif
+
+#ifdef BENCH_ROUND_RESTART
+uint32_t     RestartStart;          // G8RTOS_CYCLES when the end of game was detected
+cycle_stat_t RestartTeardownCycles; // detection until the old round's threads and jobs are gone
+cycle_stat_t RestartSetupCycles;    // adding the new round's threads
+#endif
+
+// Ball lifetimes and the end of game run as worker pool jobs with
+// WORKER_POOL and as their own threads without it. Both end with EndJob().
+#ifdef WORKER_POOL
+#define EndJob()    return
+#else
+#define EndJob()    G8RTOS_KillSelf()
+#endif
 
 
 // ======================      SEMAPHORES          ==========================
-semaphore_t CC3100_SEMAPHORE;
-semaphore_t GAMESTATE_SEMAPHORE;
-semaphore_t LCDREADY;
-semaphore_t LEDREADY;
+mutex_t CC3100_SEMAPHORE;
+mutex_t GAMESTATE_SEMAPHORE;
+mutex_t LCDREADY;
+mutex_t LEDREADY;
+event_group_t GameEvents;
 
 // ======================     GAME FUNCTIONS       ==========================
 
 void addHostThreads(){
-    G8RTOS_AddThread( &GenerateBall, 20, 0xFFFFFFFF,          "GENERATE_BALL___" );
-    G8RTOS_AddThread( &DrawObjects, 10, 0xFFFFFFFF,           "DRAW_OBJECTS____" );
-    G8RTOS_AddThread( &ReadJoystickHost, 20, 0xFFFFFFFF,      "READ_JOYSTICK___" );
-    G8RTOS_AddThread( &MoveLEDs, 20, 0xFFFFFFFF,              "MOVE_LEDS_______" );
-    G8RTOS_AddThread( &IdleThread, 255, 0xFFFFFFFF,           "IDLE____________" );
+    G8RTOS_InitRing( &ClientInputRing, ClientInputBuffer, CLIENT_INPUT_RING_SIZE );
+
+#ifdef PHYSICS_ENGINE
+    G8RTOS_AddThread( &PhysicsEngine, 10, 0xFFFFFFFF, LARGE_STACK,         "PHYSICS_ENGINE__" );
+#else
+    G8RTOS_AddThread( &GenerateBall, 20, DONT_STARVE_AGE, SMALL_STACK,     "GENERATE_BALL___" );
+#endif
+    G8RTOS_AddThread( &DrawObjects, 10, 0xFFFFFFFF, LARGE_STACK,           "DRAW_OBJECTS____" );
+    G8RTOS_AddThread( &MoveLEDs, 20, DONT_STARVE_AGE, LARGE_STACK,         "MOVE_LEDS_______" );
+    G8RTOS_AddThread( &IdleThread, 255, 0xFFFFFFFF, SMALL_STACK,           "IDLE____________" );
+#ifndef PHYSICS_ENGINE
+    G8RTOS_AddPeriodicEvent( &ReadJoystickHost, JOYSTICK_PERIOD_HOST );
+#endif
 
     #ifdef MULTI
-    G8RTOS_AddThread( &ReceiveDataFromClient, DEFAULT_PRIORITY, 0xFFFFFFFF, "RECEIVE_DATA____" );
-    G8RTOS_AddThread( &SendDataToClient, DEFAULT_PRIORITY, 0xFFFFFFFF,      "SEND_DATA_______" );
+    G8RTOS_AddThread( &ReceiveDataFromClient, DEFAULT_PRIORITY, 0xFFFFFFFF, LARGE_STACK, "RECEIVE_DATA____" );
+    G8RTOS_AddThread( &SendDataToClient, DEFAULT_PRIORITY, 0xFFFFFFFF, LARGE_STACK,      "SEND_DATA_______" );
     #endif
 }
 
 void addClientThreads(){
-    G8RTOS_AddThread( &ReadJoystickClient, DEFAULT_PRIORITY, 0xFFFFFFFF,    "READ_JOYSTICK___" );
-    G8RTOS_AddThread( &SendDataToHost, DEFAULT_PRIORITY, 0xFFFFFFFF,        "SEND_DATA_______" );
-    G8RTOS_AddThread( &ReceiveDataFromHost, DEFAULT_PRIORITY, 0xFFFFFFFF,   "RECEIVE_DATA____" );
-    G8RTOS_AddThread( &DrawObjects, 10, 0xFFFFFFFF,                         "DRAW_OBJECTS____" );
-    G8RTOS_AddThread( &MoveLEDs, 20, 0xFFFFFFFF,                            "MOVE_LEDS_______" );
-    G8RTOS_AddThread( &IdleThread, 255, 0xFFFFFFFF,                         "IDLE____________" );
+    // every buffer from the last round is free again
+    G8RTOS_InitPool( &PacketPool, PacketPoolStorage, sizeof(GameState_t), PACKET_BUFFERS );
+    G8RTOS_InitQueue( &PacketQueue, PacketQueueSlots, PACKET_BUFFERS );
+
+    G8RTOS_AddThread( &SendDataToHost, DEFAULT_PRIORITY, 0xFFFFFFFF, LARGE_STACK,        "SEND_DATA_______" );
+    G8RTOS_AddThread( &ReceiveDataFromHost, DEFAULT_PRIORITY, 0xFFFFFFFF, LARGE_STACK,   "RECEIVE_DATA____" );
+    G8RTOS_AddThread( &DrawObjects, 10, 0xFFFFFFFF, LARGE_STACK,                         "DRAW_OBJECTS____" );
+    G8RTOS_AddThread( &MoveLEDs, 20, DONT_STARVE_AGE, LARGE_STACK,                       "MOVE_LEDS_______" );
+    G8RTOS_AddThread( &IdleThread, 255, 0xFFFFFFFF, SMALL_STACK,                         "IDLE____________" );
+    G8RTOS_AddPeriodicEvent( &ReadJoystickClient, JOYSTICK_PERIOD_CLIENT );
+}
+
+/*
+ * Starts the end of game work once per round. The network threads see
+ * gameDone on every pass, so later calls do nothing until the next round.
+ * It runs at priority 1 either way, so it isn't round robined with the
+ * game threads while it takes their mutexes and tears the round down.
+ */
+static void QueueEndOfGame(void (*endOfGame)(void), char * name)
+{
+    if ( EndOfGameQueued )
+        return;
+
+#ifdef BENCH_ROUND_RESTART
+    RestartStart = G8RTOS_CYCLES();
+#endif
+
+#ifdef WORKER_POOL
+    (void)name;
+    EndOfGameQueued = ( G8RTOS_SubmitJob_Priority(endOfGame, 1) == 0 );
+#else
+    EndOfGameQueued = ( G8RTOS_AddThread(endOfGame, 1, 0xFFFFFFFF, LARGE_STACK, name) == NO_ERROR );
+#endif
+}
+
+/*
+ * Wakes MoveLEDs if the scores changed since the last call. A stale
+ * LEDThreadId from the last round is not a live thread and is ignored.
+ */
+static void NotifyScoreChange(void)
+{
+    static uint8_t lastScores[MAX_NUM_OF_PLAYERS];
+
+    if ( lastScores[0] != gamestate.LEDScores[0] || lastScores[1] != gamestate.LEDScores[1] )
+    {
+        lastScores[0] = gamestate.LEDScores[0];
+        lastScores[1] = gamestate.LEDScores[1];
+        G8RTOS_NotifyThread(LEDThreadId, LED_NOTIFY_SCORE);
+    }
+}
+
+/*
+ * Scores a ball that left the arena. Only a ball a paddle has touched
+ * (colored) scores, for the player on the other side. The round ends
+ * when either player reaches 8.
+ * Param "bottom": true if the ball left past the host's paddle
+ */
+static void ScoreBall(bool bottom, uint16_t color)
+{
+    if ( bottom && (color == LCD_BLUE || color == LCD_RED) )
+        gamestate.LEDScores[1] += 1;
+    else if ( color == LCD_BLUE || color == LCD_RED )
+        gamestate.LEDScores[0] += 1;
+
+    NotifyScoreChange();
+
+    if ( gamestate.LEDScores[0] == 8 || gamestate.LEDScores[1] == 8 )
+    {
+#ifdef SINGLE
+        QueueEndOfGame(&EndOfGameHost, "END_OF_GAME_HOST");
+#endif
+        gamestate.gameDone = true;
+    }
+}
+
+#ifdef PHYSICS_ENGINE
+/*
+ * Starts a ball in a slot from the store's free stack
+ * Returns: false if every slot is taken
+ */
+static bool SpawnBall(void)
+{
+    int32_t i = Physics_AddBall(&Balls);
+    if ( i < 0 )
+        return false;
+
+    previousBalls[i].CenterX = 0;
+    previousBalls[i].CenterY = 120;
+    gamestate.balls[i].currentCenterX = PHYSICS_TO_PIXEL(Balls.x[i]);
+    gamestate.balls[i].currentCenterY = PHYSICS_TO_PIXEL(Balls.y[i]);
+    gamestate.balls[i].color = Balls.color[i];
+    gamestate.balls[i].kill = 0;
+    gamestate.balls[i].alive = 1;
+    gamestate.ballMask[i >> 5] |= BALL_BIT(i);
+    return true;
+}
+
+/*
+ * Copies the gamestate into the older snapshot, then makes it the newest.
+ * Only the flip is masked. The copy goes into the buffer no reader started
+ * on since the last flip, and ReadSnapshot retries if it loses the race.
+ */
+static void PublishSnapshot(void)
+{
+    uint32_t seq = SnapshotSeq;
+
+    Snapshots[(seq + 1) & 1] = gamestate;
+    __DMB();
+
+    int32_t primask = StartCriticalSection();
+    SnapshotSeq = seq + 1;
+    EndCriticalSection(primask);
+}
+
+/*
+ * Copies the newest snapshot. A publish during the copy may be writing
+ * into the buffer being copied, so the copy is taken again until the
+ * sequence is the same before and after it.
+ * Returns: the tick it is from
+ */
+static uint32_t ReadSnapshot(GameState_t * frame)
+{
+    uint32_t seq;
+
+    do
+    {
+        seq = SnapshotSeq;
+        __DMB();
+        *frame = Snapshots[seq & 1];
+        __DMB();
+    } while ( SnapshotSeq != seq );
+
+    return frame->tick;
+}
+#endif
+
+/*
+ * Client: returns the newest packet in the packet queue, freeing the
+ * frame it replaces and any older packets. Returns the current frame
+ * if nothing new arrived.
+ */
+static GameState_t * NewestPacket(GameState_t * frame)
+{
+    GameState_t * received;
+
+    while ( (received = G8RTOS_QueueTryReceive(&PacketQueue)) != 0 )
+    {
+        if ( frame != &gamestate )
+            G8RTOS_PoolFree(&PacketPool, frame);
+        frame = received;
+    }
+
+    return frame;
+}
+
+#ifdef BENCH_ROUND_RESTART
+/*
+ * Prints the restart timing once the new round's threads are added
+ */
+static void PrintRoundRestart(uint32_t setupStart)
+{
+    G8RTOS_RecordCycleStat(&RestartSetupCycles, G8RTOS_CYCLES() - setupStart);
+    G8RTOS_PrintCycleStat("RESTART_TEARDOWN", &RestartTeardownCycles);
+    G8RTOS_PrintCycleStat("RESTART_SETUP", &RestartSetupCycles);
+#ifdef BENCH_KILL
+    // interrupts masked while EndOfGame killed the old round's threads
+    G8RTOS_PrintCycleStat("RESTART_KILL_MASKED", &KillAllCycles);
+#endif
 }
+#endif
 
 // This function copies over a gamestate into a new
 // packet to be sent over Wi-Fi.
@@ -91,7 +312,12 @@ void fillPacket ( GameState_t * gs, GameState_t * packet )
         packet->players[i] = gs->players[i];
     }
 
-    for (int i = 0; i < MAX_NUM_OF_BALLS; i++)
+    for (int i = 0; i < BALL_MASK_WORDS; i++)
+    {
+        packet->ballMask[i] = gs->ballMask[i];
+    }
+
+    for (int32_t i = Physics_NextBall(gs->ballMask, -1); i >= 0; i = Physics_NextBall(gs->ballMask, i))
     {
         packet->balls[i] = gs->balls[i];
     }
@@ -116,7 +342,7 @@ void buttons_init(void)
     P4->REN |= BIT4 | BIT5;         // Pull-up resister
     P4->OUT |= BIT4 | BIT5;         // Sets res to pull-up
     NVIC_EnableIRQ(PORT4_IRQn);     // enable interrupts on PORT4
-    __NVIC_SetPriority(PORT4_IRQn, 0);
+    __NVIC_SetPriority(PORT4_IRQn, KERNEL_IRQ_PRIORITY);
 
     // B2 = P5.4, B3 = P5.5
     P5->DIR &= ~(BIT4 | BIT5);
@@ -126,7 +352,7 @@ void buttons_init(void)
     P5->REN |= BIT4 | BIT5;         // Pull-up resister
     P5->OUT |= BIT4 | BIT5;         // Sets res to pull-up
     NVIC_EnableIRQ(PORT5_IRQn);     // enable interrupts on PORT4
-    NVIC_SetPriority(PORT5_IRQn, 0);
+    NVIC_SetPriority(PORT5_IRQn, KERNEL_IRQ_PRIORITY);
 }
 
 // Any animations or text used for the main menu is displayed with this function
@@ -143,13 +369,13 @@ void writeGameMenuHost( uint16_t Color )
     LCD_Clear(LCD_BLACK);
 
     // signal semaphore
-    G8RTOS_WaitSemaphore(&LCDREADY);
+    G8RTOS_AcquireMutex(&LCDREADY);
 
     LCD_Text(MAX_SCREEN_X/2 - 7*8, MAX_SCREEN_Y/2-8, "B0 -> Next Game", Color);
     // LCD_Text(MAX_SCREEN_X/2 - 7*8, MAX_SCREEN_Y/2+8, "B2 -> End Game", Color);
 
     // signal semaphore
-    G8RTOS_SignalSemaphore(&LCDREADY);
+    G8RTOS_ReleaseMutex(&LCDREADY);
 }
 
 // Any animations or text used for the game menu is displayed with this function
@@ -158,12 +384,12 @@ void writeGameMenuClient( uint16_t Color )
     LCD_Clear(LCD_BLACK);
 
     // signal semaphore
-    G8RTOS_WaitSemaphore(&LCDREADY);
+    G8RTOS_AcquireMutex(&LCDREADY);
 
     LCD_Text(MAX_SCREEN_X/2 - 8*8, MAX_SCREEN_Y/2-4, "Waiting for Host", Color);
 
     // signal semaphore
-    G8RTOS_SignalSemaphore(&LCDREADY);
+    G8RTOS_ReleaseMutex(&LCDREADY);
 }
 
 /*
@@ -186,12 +412,12 @@ void DrawPlayer(GeneralPlayerInfo_t * player)
     if (player->position == BOTTOM) yCenter = ARENA_MAX_Y - PADDLE_WID_D2 - PADDLE_OFFSET;
     if (player->position == TOP)    yCenter = ARENA_MIN_Y + PADDLE_WID_D2 + PADDLE_OFFSET;
   
-    G8RTOS_WaitSemaphore(&LCDREADY);
+    G8RTOS_AcquireMutex(&LCDREADY);
 
     LCD_DrawRectangle(player->currentCenter - PADDLE_LEN_D2, player->currentCenter + PADDLE_LEN_D2,
                       yCenter - PADDLE_WID_D2, yCenter + PADDLE_WID_D2, player->color);
 
-    G8RTOS_SignalSemaphore(&LCDREADY);
+    G8RTOS_ReleaseMutex(&LCDREADY);
 }
 
 /*
@@ -238,7 +464,7 @@ void UpdatePlayerOnScreen(PrevPlayer_t * prevPlayerIn, GeneralPlayerInfo_t * out
             starting_new_data_window = outPlayer->currentCenter - PADDLE_LEN_D2;
         }
 
-        G8RTOS_WaitSemaphore(&LCDREADY);
+        G8RTOS_AcquireMutex(&LCDREADY);
       
         // erase the UNCOMMON old player position first
         LCD_DrawRectangle(starting_old_data_window, starting_old_data_window + center_diff,
@@ -252,7 +478,7 @@ void UpdatePlayerOnScreen(PrevPlayer_t * prevPlayerIn, GeneralPlayerInfo_t * out
         // before erasing the original
         prevPlayerIn->Center = outPlayer->currentCenter;
 
-        G8RTOS_SignalSemaphore(&LCDREADY);
+        G8RTOS_ReleaseMutex(&LCDREADY);
     }
 }
 
@@ -262,7 +488,7 @@ void UpdatePlayerOnScreen(PrevPlayer_t * prevPlayerIn, GeneralPlayerInfo_t * out
 void UpdateBallOnScreen(PrevBall_t * previousBall, Ball_t * currentBall, uint16_t outColor)
 {
 
-    G8RTOS_WaitSemaphore(&LCDREADY);
+    G8RTOS_AcquireMutex(&LCDREADY);
 
     // erase the old ball first
     LCD_DrawRectangle(previousBall->CenterX, previousBall->CenterX + BALL_SIZE,
@@ -278,32 +504,53 @@ void UpdateBallOnScreen(PrevBall_t * previousBall, Ball_t * currentBall, uint16_
     // wrapping the data update doesn't allow the balls to update twice
 
 
-    G8RTOS_SignalSemaphore(&LCDREADY);
+    G8RTOS_ReleaseMutex(&LCDREADY);
 }
 
 
+/*
+ * Takes every ball out of play. Only the slots in the ball mask are
+ * touched, so it costs the balls in play. Without PHYSICS_ENGINE any slot
+ * can hold a ball thread's ball, so the mask stays full.
+ */
+static void ClearBalls(void)
+{
+    for (int32_t i = Physics_NextBall(gamestate.ballMask, -1); i >= 0; i = Physics_NextBall(gamestate.ballMask, i))
+    {
+        gamestate.balls[i].alive = 0;
+        gamestate.balls[i].kill = 0;
+    }
+
+#ifdef PHYSICS_ENGINE
+    for (int i = 0; i < BALL_MASK_WORDS; i++)
+        gamestate.ballMask[i] = 0;
+    Physics_Reset(&Balls);
+#else
+    for (int i = 0; i < MAX_NUM_OF_BALLS; i++)
+        gamestate.ballMask[i >> 5] |= BALL_BIT(i);
+#endif
+
+    ballCount = 0;
+}
+
 /*
  * Initializes and prints initial game state
  */
 void InitBoardState()
 {
     // initialize balls
-    Ball_t * tempBall;
-    for (int i = 0; i < MAX_NUM_OF_BALLS; i++)
-    {
-        tempBall = &gamestate.balls[i];
-        tempBall->alive = 0;
-        tempBall->color = LCD_WHITE;
-        tempBall->currentCenterX = 0;
-        tempBall->currentCenterY = 0;
-    }
+    ClearBalls();
 
     // initialize game states
     gamestate.gameDone = 0;
     gamestate.numberOfBalls = 0;
     gamestate.winner = 0;
     playerCount = 2;
-    ballCount = 0;
+#ifdef PHYSICS_ENGINE
+    gamestate.tick = 0;
+    NextSpawnTick = 0;
+    PublishSnapshot();
+#endif
   
     // draw the map boundaries
     // This is the only thread running, so semaphores are not required.
@@ -414,6 +661,10 @@ void CreateGame()
 
     GREEN_ON; // use LED to indicate WiFi connection as HOST
 
+#ifdef PHYSICS_ENGINE
+    Physics_Init(&Balls);
+#endif
+
     // 5. Initialize the board (draw arena, players, scores)
     InitBoardState();
 
@@ -432,40 +683,60 @@ void SendDataToClient()
 {
 #ifdef PACKETS
 
+    uint32_t nextSend = SystemTime;
+
     while(1)
     {
         // 1. Fill packet for client
         fillPacket(&gamestate, &packet);
 
         // 2. Send packet
-        G8RTOS_WaitSemaphore(&CC3100_SEMAPHORE);
+        G8RTOS_AcquireMutex(&CC3100_SEMAPHORE);
         SendData( (uint8_t*)&packet, packet.player.IP_address, sizeof(packet) );
-        G8RTOS_SignalSemaphore(&CC3100_SEMAPHORE);
+        G8RTOS_ReleaseMutex(&CC3100_SEMAPHORE);
 
-        // 3. Check if the game is done. Add endofgamehost thread if done.
+        // 3. Check if the game is done. Start the end of game work if done.
         if ( gamestate.gameDone == true )
-            G8RTOS_AddThread(EndOfGameHost, 0, 0xFFFFFFFF, "END_OF_GAME_HOST");
+            QueueEndOfGame(&EndOfGameHost, "END_OF_GAME_HOST");
 
-        sleep(5);
+        // fixed 5 ms send period, not 5 ms plus the time spent sending
+        nextSend += 5;
+        sleep_until(nextSend);
     }
 #endif
 #ifdef GAMESTATE
+    uint32_t nextSend = SystemTime;
+
+    // the state that gets sent. With PHYSICS_ENGINE it is a whole tick's
+    // snapshot, never a gamestate the simulation is halfway through.
+#ifdef PHYSICS_ENGINE
+    GameState_t * sent = &packet;
+#else
+    GameState_t * sent = &gamestate;
+#endif
+
     while(1)
     {
+#ifdef PHYSICS_ENGINE
+        // 1. Take the newest snapshot
+        ReadSnapshot(sent);
+#endif
 
         // 2. Send packet
-        G8RTOS_WaitSemaphore(&CC3100_SEMAPHORE);
-        SendData( (uint8_t*)&gamestate, gamestate.player.IP_address, sizeof(gamestate) );
-        G8RTOS_SignalSemaphore(&CC3100_SEMAPHORE);
+        G8RTOS_AcquireMutex(&CC3100_SEMAPHORE);
+        SendData( (uint8_t*)sent, gamestate.player.IP_address, sizeof(*sent) );
+        G8RTOS_ReleaseMutex(&CC3100_SEMAPHORE);
 
-        // 3. Check if the game is done. Add endofgamehost thread if done.
+        // 3. Check if the game is done. Start the end of game work if done.
         // This has to be wrapped in the semaphores because the gameDone
         // could otherwise be changed immediately after the data transfer
         // and the client wouldn't know the game ended.
-        if ( gamestate.gameDone == true )
-            G8RTOS_AddThread(EndOfGameHost, 0, 0xFFFFFFFF, "END_OF_GAME_HOST");
+        if ( sent->gameDone == true )
+            QueueEndOfGame(&EndOfGameHost, "END_OF_GAME_HOST");
 
-        sleep(5);
+        // fixed 5 ms send period, not 5 ms plus the time spent sending
+        nextSend += 5;
+        sleep_until(nextSend);
     }
 #endif
 }
@@ -484,9 +755,9 @@ void ReceiveDataFromClient()
         // thread is put to sleep to avoid deadlock.
         do
         {
-            G8RTOS_WaitSemaphore(&CC3100_SEMAPHORE);
+            G8RTOS_AcquireMutex(&CC3100_SEMAPHORE);
             result = ReceiveData( (uint8_t*)&packet.player, sizeof(packet.player));
-            G8RTOS_SignalSemaphore(&CC3100_SEMAPHORE);
+            G8RTOS_ReleaseMutex(&CC3100_SEMAPHORE);
             sleep(1); // avoid deadlock
 
         } while ( result < 0 );
@@ -502,14 +773,22 @@ void ReceiveDataFromClient()
     }
 #endif
 #ifdef GAMESTATE
+    SpecificPlayerInfo_t input;
+
     while(1)
     {
-        // if the response is greater than 0, valid data was returned
-        // to the gamestate. If not, no valid data was returned and
+        // if the response is not negative, valid data was returned
+        // to the input. If not, no valid data was returned and
         // thread is put to sleep to avoid deadlock.
-        G8RTOS_WaitSemaphore(&CC3100_SEMAPHORE);
-        ReceiveData( (uint8_t*)&gamestate.player, sizeof(gamestate.player));
-        G8RTOS_SignalSemaphore(&CC3100_SEMAPHORE);
+        G8RTOS_AcquireMutex(&CC3100_SEMAPHORE);
+        int32_t result = ReceiveData( (uint8_t*)&input, sizeof(input));
+        G8RTOS_ReleaseMutex(&CC3100_SEMAPHORE);
+
+        // pass the whole record to ReadJoystickHost. It runs in SysTick
+        // (or the simulation thread) and could otherwise see a half
+        // written displacement.
+        if ( result >= 0 )
+            G8RTOS_RingWrite(&ClientInputRing, &input, sizeof(input));
 
         sleep(2);
     }
@@ -519,8 +798,8 @@ void ReceiveDataFromClient()
 /*
  * Generate Ball thread
  */
-// Adds another ball thread. Sleeps proportional to the number of balls
-// currently in play.
+// Adds another ball thread (or ball job with WORKER_POOL). Sleeps
+// proportional to the number of balls currently in play.
 void GenerateBall()
 {
     while(1)
@@ -529,87 +808,79 @@ void GenerateBall()
         // the max number of balls have not been generated.
         if ( ballCount < MAX_NUM_OF_BALLS )
         {
-            G8RTOS_AddThread(&MoveBall, 10, 0xFFFFFFFF, "MOVE_BALL_______");
-            ballCount++;
+#ifdef WORKER_POOL
+            if ( G8RTOS_SubmitJob(&MoveBall) == 0 )
+                ballCount++;
+#else
+            if ( G8RTOS_AddThread(&MoveBall, 10, 0xFFFFFFFF, SMALL_STACK, "MOVE_BALL_______") == NO_ERROR )
+                ballCount++;
+#endif
         }
         sleep(ballCount * BALL_GEN_SLEEP);
     }
 }
 
 /*
- * Thread to read host's joystick
+ * Periodic event that reads the host's joystick every JOYSTICK_PERIOD_HOST ms
+ * Runs inside SysTick_Handler, so it must never block or sleep. With
+ * PHYSICS_ENGINE the simulation calls it every PADDLE_STEP_TICKS instead.
+ * The paddle moves by the previous sample's displacement. That keeps
+ * the one period of lag the old sleep(10) added to make it fair for client.
  */
 void ReadJoystickHost()
 {
-    int16_t avg = 0;
+    static int16_t avg = 0;
+    static int16_t displacement = 0;
     int16_t joystick_x = 0;
     int16_t joystick_y = 0;
-    int16_t displacement = 0;
 
-    while(1)
-    {
-        // moving average of the joystick inputs
-        GetJoystickCoordinates(&joystick_x, &joystick_y);
-        avg = (avg + joystick_x + JOYSTICK_BIAS_HOST) >> 1;
-
-        // use the joystick controls to increase and decrease
-        // the player velocity
-//        switch(avg) {
-//        case -10000 ... -6000   : displacement = 10;   break;
-//        case -5999 ... -4000    : displacement = 5;    break;
-//        case -3999 ... -2000    : displacement = 3;    break;
-//        case -1999 ... -750     : displacement = 1;    break;
-//        case -749  ... 750      : displacement = 0;     break;
-//        case 751   ... 2000     : displacement = -1;     break;
-//        case 2001  ... 4000     : displacement = -3;     break;
-//        case 4001  ... 6000     : displacement = -5;     break;
-//        case 6001  ... 10000    : displacement = -10;    break;
-//        default                 : displacement = 0;     break;
-//        }
-
-        // The switch statement was causing about 500 ms of lag
-        displacement = -(avg >> 9);
-        sleep(10);  // sleep before updating host's position to make it fair for client
-
-        // UPDATE JOYSTICK HOST ----------------------------------------------
-        // move the player's center
-        gamestate.players[0].currentCenter += displacement;
-
-        // player center is too far to the left - limit it.
-        if ( gamestate.players[0].currentCenter - PADDLE_LEN_D2 <= ARENA_MIN_X )
-        {
-            gamestate.players[0].currentCenter = ARENA_MIN_X + PADDLE_LEN_D2 + 1;
-        }
+    // UPDATE JOYSTICK HOST ----------------------------------------------
+    // move the player's center
+    gamestate.players[0].currentCenter += displacement;
 
-        // player center is too far to the right - limit it.
-        else if ( gamestate.players[0].currentCenter + PADDLE_LEN_D2 > ARENA_MAX_X - 1 )
-        {
-            gamestate.players[0].currentCenter = ARENA_MAX_X - PADDLE_LEN_D2 - 1;
-        }
+    // player center is too far to the left - limit it.
+    if ( gamestate.players[0].currentCenter - PADDLE_LEN_D2 <= ARENA_MIN_X )
+    {
+        gamestate.players[0].currentCenter = ARENA_MIN_X + PADDLE_LEN_D2 + 1;
+    }
 
+    // player center is too far to the right - limit it.
+    else if ( gamestate.players[0].currentCenter + PADDLE_LEN_D2 > ARENA_MAX_X - 1 )
+    {
+        gamestate.players[0].currentCenter = ARENA_MAX_X - PADDLE_LEN_D2 - 1;
+    }
 
-        // UPDATE JOYSTICK CLIENT --------------------------------------------
-        // Once the host receives valid data from the client, it is allowed to
-        // increment the player position.
-        // G8RTOS_WaitSemaphore(&GAMESTATE_SEMAPHORE);
-        // update the player's center
-        gamestate.players[1].currentCenter += gamestate.player.displacement;
 
-        // player center is too far to the left - limit it.
-        if ( gamestate.players[1].currentCenter - PADDLE_LEN_D2 <= ARENA_MIN_X )
-        {
-            gamestate.players[1].currentCenter = ARENA_MIN_X + PADDLE_LEN_D2 + 1;
-        }
+    // UPDATE JOYSTICK CLIENT --------------------------------------------
+    // Once the host receives valid data from the client, it is allowed to
+    // increment the player position. Only the newest record matters, and
+    // the last one keeps applying until another arrives.
+#ifdef GAMESTATE
+    while ( G8RTOS_RingRead(&ClientInputRing, &gamestate.player, sizeof(gamestate.player)) > 0 );
+#endif
+    // update the player's center
+    gamestate.players[1].currentCenter += gamestate.player.displacement;
 
-        // player center is too far to the right - limit it.
-        else if ( gamestate.players[1].currentCenter + PADDLE_LEN_D2 > ARENA_MAX_X - 1 )
-        {
-            gamestate.players[1].currentCenter = ARENA_MAX_X - PADDLE_LEN_D2 - 1;
-        }
-        // G8RTOS_SignalSemaphore(&GAMESTATE_SEMAPHORE);
+    // player center is too far to the left - limit it.
+    if ( gamestate.players[1].currentCenter - PADDLE_LEN_D2 <= ARENA_MIN_X )
+    {
+        gamestate.players[1].currentCenter = ARENA_MIN_X + PADDLE_LEN_D2 + 1;
+    }
 
-        sleep(5);
+    // player center is too far to the right - limit it.
+    else if ( gamestate.players[1].currentCenter + PADDLE_LEN_D2 > ARENA_MAX_X - 1 )
+    {
+        gamestate.players[1].currentCenter = ARENA_MAX_X - PADDLE_LEN_D2 - 1;
     }
+
+    // SAMPLE FOR THE NEXT PERIOD ----------------------------------------
+    // moving average of the joystick inputs
+    GetJoystickCoordinates(&joystick_x, &joystick_y);
+    avg = (avg + joystick_x + JOYSTICK_BIAS_HOST) >> 1;
+
+    // The switch statement that used to map avg to a displacement
+    // was causing about 500 ms of lag
+    displacement = -(avg >> 9);
 }
 
 /*
@@ -675,6 +946,7 @@ void MoveBall()
 #ifdef JAKES_VERSION
     Ball_t * ball;
     PrevBall_t * previousBall;
+    uint8_t ballRound = RoundGeneration;
 
     for (int i = 0; i < MAX_NUM_OF_BALLS; i++)
     {
@@ -702,6 +974,10 @@ void MoveBall()
 
     while(1){
 
+        // a job left over from a round that already ended
+        if ( ballRound != RoundGeneration )
+            EndJob();
+
         // test if hitting the right or left side wall
         if((xvel > 0 && ball->currentCenterX + xvel + BALL_SIZE + 1 >= ARENA_MAX_X) ||
            (xvel < 0 && ball->currentCenterX + xvel - 1 <= ARENA_MIN_X)){
@@ -777,25 +1053,10 @@ void MoveBall()
             // kill this ball, and score the point
             // set ball to dead
             ball->alive = 1;
-
-            // score points
-            if(yvel > 0 && (ball->color == LCD_BLUE || ball->color == LCD_RED)){
-                gamestate.LEDScores[1] += 1;
-            }
-            else if(ball->color == LCD_BLUE || ball->color == LCD_RED){
-                gamestate.LEDScores[0] += 1;
-            }
-            if(gamestate.LEDScores[0] == 8 || gamestate.LEDScores[1] == 8){
-              
-   #ifdef SINGLE
-                G8RTOS_AddThread( &EndOfGameHost, 0, 0xFFFFFFFF,          "KillAll___" );
-   #endif
-              gamestate.gameDone = true;
-            }
-
+            ScoreBall(yvel > 0, ball->color);
             ball->kill = 1;
 
-            G8RTOS_KillSelf();
+            EndJob();
 
         }
 
@@ -810,23 +1071,243 @@ void MoveBall()
 }
 
 
+#ifdef PHYSICS_ENGINE
+#ifdef BENCH_COLLISIONS
+/*
+ * Records the pairs the last step tested and prints the average for
+ * every ball count next to the n(n-1)/2 pairs a test of all of them
+ * would take, every PHYSICS_REPORT_STEPS steps
+ */
+static void RecordCollisions(void)
+{
+    static uint32_t steps = 0;
+
+    CollisionSteps[Balls.numAlive]++;
+    CollisionPairs[Balls.numAlive] += Balls.pairsTested;
+
+    if ( ++steps == PHYSICS_REPORT_STEPS )
+    {
+        steps = 0;
+        for (int i = 0; i <= MAX_NUM_OF_BALLS; i++)
+        {
+            if ( CollisionSteps[i] == 0 )
+                continue;
+            BackChannelPrintIntVariable("COLLIDE_BALLS", i);
+            BackChannelPrintIntVariable("PAIRS_TESTED", CollisionPairs[i] / CollisionSteps[i]);
+            BackChannelPrintIntVariable("PAIRS_ALL", i * (i - 1) / 2);
+        }
+    }
+}
+#endif
+
+/*
+ * One simulation tick. Everything the host's game does happens here, at
+ * a tick count rather than a wall clock time, so the same inputs give
+ * the same game however late the thread runs:
+ *  - every PADDLE_STEP_TICKS: sample the joysticks and move the paddles
+ *  - at NextSpawnTick: start a ball, the next one ballCount*BALL_GEN_SLEEP later
+ *  - every BALL_STEP_TICKS: step the balls and score the ones that left
+ *  - every tick: free slots whose balls have been held dead long enough
+ */
+static void SimulateTick(void)
+{
+#ifdef BENCH_PHYSICS
+    static uint32_t steps = 0;
+#endif
+
+    uint32_t tick = ++gamestate.tick;
+
+    // input sampling point
+    if ( tick % PADDLE_STEP_TICKS == 0 )
+        ReadJoystickHost();
+
+    if ( tick >= NextSpawnTick )
+    {
+        if ( ballCount < MAX_NUM_OF_BALLS && SpawnBall() )
+            ballCount++;
+#ifdef BENCH_BALL_STRESS
+        NextSpawnTick = tick + 1;
+#else
+        NextSpawnTick = tick + ballCount * BALL_GEN_SLEEP / SIM_TICK_MS;
+#endif
+    }
+
+    if ( tick % BALL_STEP_TICKS == 0 )
+    {
+#ifdef BENCH_PHYSICS
+        uint32_t live = Balls.numAlive;
+        uint32_t start = G8RTOS_CYCLES();
+#endif
+
+        // both paddles are read once so every ball sees the same ones
+        Physics_Step(&Balls, gamestate.players[0].currentCenter, gamestate.players[1].currentCenter);
+#ifdef BENCH_COLLISIONS
+        RecordCollisions();
+#endif
+
+        for (int32_t i = Physics_NextBall(Balls.alive, -1); i >= 0; i = Physics_NextBall(Balls.alive, i))
+        {
+            gamestate.balls[i].currentCenterX = PHYSICS_TO_PIXEL(Balls.x[i]);
+            gamestate.balls[i].currentCenterY = PHYSICS_TO_PIXEL(Balls.y[i]);
+            gamestate.balls[i].color = Balls.color[i];
+        }
+
+        for (int i = 0; i < Balls.numExits; i++)
+        {
+            uint16_t slot = Balls.exits[i];
+#ifndef BENCH_BALL_STRESS
+            ScoreBall(Balls.exited[slot] == EXIT_BOTTOM, Balls.color[slot]);
+#endif
+            gamestate.balls[slot].kill = 1;
+            KillTicks[slot] = KILL_HOLD_TICKS;
+        }
+
+#ifdef BENCH_PHYSICS
+        G8RTOS_RecordCycleStat(&PhysicsStepCycles[live], G8RTOS_CYCLES() - start);
+
+        if ( ++steps == PHYSICS_REPORT_STEPS )
+        {
+            steps = 0;
+            BackChannelPrintIntVariable("SIM_TICK", tick);
+            BackChannelPrintIntVariable("SIM_DROPPED_TICKS", SimDroppedTicks);
+            for (int i = 0; i <= MAX_NUM_OF_BALLS; i++)
+            {
+                if ( PhysicsStepCycles[i].count == 0 )
+                    continue;
+                BackChannelPrintIntVariable("PHYSICS_BALLS", i);
+                G8RTOS_PrintCycleStat("PHYSICS_STEP", &PhysicsStepCycles[i]);
+            }
+        }
+#endif
+    }
+
+    // dead balls stay alive && kill for a while so DrawObjects on both
+    // boards sees them and erases them. Then the slot is free again.
+    for (int32_t i = Physics_NextBall(gamestate.ballMask, -1); i >= 0; i = Physics_NextBall(gamestate.ballMask, i))
+    {
+        if ( gamestate.balls[i].kill && --KillTicks[i] == 0 )
+        {
+            gamestate.balls[i].alive = 0;
+            gamestate.balls[i].kill = 0;
+            gamestate.ballMask[i >> 5] &= ~BALL_BIT(i);
+            Physics_FreeBall(&Balls, i);
+            ballCount--;
+        }
+    }
+}
+
+/*
+ * SUMMARY: Thread that runs the host's game
+ *
+ * DESCRIPTION: Fixed timestep loop. The time since the last wake goes
+ *              into an accumulator and whole SIM_TICK_MS ticks are run
+ *              out of it, so a late wake runs the missed ticks instead
+ *              of taking bigger steps. After SIM_MAX_CATCHUP ticks the
+ *              rest is dropped and counted in SimDroppedTicks. The state
+ *              after the last tick is published as the snapshot that
+ *              DrawObjects and SendDataToClient read.
+ */
+void PhysicsEngine()
+{
+    uint32_t lastTime = SystemTime;
+    uint32_t accumulator = 0;
+
+    while(1)
+    {
+        uint32_t now = SystemTime;
+        uint32_t ran = 0;
+
+        accumulator += now - lastTime;
+        lastTime = now;
+
+        while ( accumulator >= SIM_TICK_MS && ran < SIM_MAX_CATCHUP )
+        {
+#ifdef BENCH_BALL_STRESS
+            uint32_t start = G8RTOS_CYCLES();
+            SimulateTick();
+            G8RTOS_RecordCycleStat(&StressTickCycles, G8RTOS_CYCLES() - start);
+#else
+            SimulateTick();
+#endif
+            accumulator -= SIM_TICK_MS;
+            ran++;
+        }
+
+        if ( accumulator >= SIM_TICK_MS )
+        {
+            SimDroppedTicks += accumulator / SIM_TICK_MS;
+            accumulator %= SIM_TICK_MS;
+        }
+
+        if ( ran > 0 )
+            PublishSnapshot();
+
+        sleep_until(now + SIM_TICK_MS - accumulator);
+    }
+}
+
+#ifdef BENCH_BALL_STRESS
+/*
+ * Records one of the host's frames and prints the stress results every
+ * STRESS_REPORT_FRAMES frames
+ * Param "start": G8RTOS_CYCLES when the frame started
+ * Param "deadline": SystemTime the next frame starts at
+ */
+static void RecordStressFrame(uint32_t start, uint32_t deadline)
+{
+    static uint32_t frames = 0;
+
+    G8RTOS_RecordCycleStat(&StressFrameCycles, G8RTOS_CYCLES() - start);
+    if ( SystemTime > deadline )
+        StressLateFrames++;
+
+    if ( ++frames == STRESS_REPORT_FRAMES )
+    {
+        frames = 0;
+        BackChannelPrintIntVariable("STRESS_BALLS", ballCount);
+        G8RTOS_PrintCycleStat("STRESS_FRAME", &StressFrameCycles);
+        G8RTOS_PrintCycleStat("STRESS_SIM_TICK", &StressTickCycles);
+        BackChannelPrintIntVariable("STRESS_LATE_FRAMES", StressLateFrames);
+        BackChannelPrintIntVariable("SIM_DROPPED_TICKS", SimDroppedTicks);
+    }
+}
+#endif
+#endif
+
 /*
  * End of game for the host
  */
 void EndOfGameHost()
 {
     // wait for semaphores
-    G8RTOS_WaitSemaphore(&LCDREADY);
-    G8RTOS_WaitSemaphore(&LEDREADY);
-    G8RTOS_WaitSemaphore(&CC3100_SEMAPHORE);
+    G8RTOS_AcquireMutex(&LCDREADY);
+    G8RTOS_AcquireMutex(&LEDREADY);
+    G8RTOS_AcquireMutex(&CC3100_SEMAPHORE);
 
     G8RTOS_KillAllOthers();
+#ifndef PHYSICS_ENGINE
+    G8RTOS_KillPeriodicEvent(&ReadJoystickHost);
+#endif
+    RoundGeneration++;
   
-    // force semaphores to reset here..
-    // shouldn't be required, but fixes semaphore block bug
-    G8RTOS_InitSemaphore(&LCDREADY, 1);
-    G8RTOS_InitSemaphore(&LEDREADY, 1);
-    G8RTOS_InitSemaphore(&CC3100_SEMAPHORE, 1);
+    // killed threads that were waiting on the mutexes gave up their
+    // place, so releasing them leaves them free for the next round
+    G8RTOS_ReleaseMutex(&LCDREADY);
+    G8RTOS_ReleaseMutex(&LEDREADY);
+    G8RTOS_ReleaseMutex(&CC3100_SEMAPHORE);
+
+#ifdef WORKER_POOL
+    // ball jobs survive KillAllOthers. Queued ones are dropped, running
+    // ones see the new RoundGeneration and return within one MoveBall
+    // step.
+    G8RTOS_CancelJobs();
+    while ( G8RTOS_WorkersBusy() > 1 )
+        sleep(1);
+#endif
+
+#ifdef BENCH_ROUND_RESTART
+    G8RTOS_RecordCycleStat(&RestartTeardownCycles, G8RTOS_CYCLES() - RestartStart);
+#endif
 
     // determine winner
     if(gamestate.LEDScores[0] == 8){
@@ -841,12 +1322,7 @@ void EndOfGameHost()
     }
     gamestate.LEDScores[0] = 0;
     gamestate.LEDScores[1] = 0;
-    for(int i = 0; i < MAX_NUM_OF_BALLS; i++){
-        gamestate.balls[i].alive = 0;
-        gamestate.balls[i].kill = 0;
-    }
-
-    ballCount = 0;
+    ClearBalls();
     playerCount = 2;
 
     // 1. Initialize players' general parameters
@@ -871,8 +1347,12 @@ void EndOfGameHost()
 
     writeGameMenuHost(LCD_WHITE);
     nextState = NA;   // set next game state to NA
+    G8RTOS_ClearEvents(&GameEvents, BUTTON_EVENT);
     buttons_init();
-    while(nextState == NA);
+
+    // block until ButtonPress picks the next state instead of spinning
+    while(nextState == NA)
+        G8RTOS_WaitEvents(&GameEvents, BUTTON_EVENT, EVENTS_CLEAR);
 
     // send response to the client
     gamestate.gameDone = false;
@@ -883,7 +1363,7 @@ void EndOfGameHost()
         // reset leds on board
         gamestate.winner = true;    // this notifies client kill all threads
         SendData((uint8_t*)&gamestate, gamestate.player.IP_address, sizeof(gamestate));
-        G8RTOS_KillSelf();
+        EndJob();
     }
     else // if the game shouldn't end here, notify the client to restart
     {
@@ -899,10 +1379,17 @@ void EndOfGameHost()
 
     // 6. Add GenerateBall, DrawObjects, ReadJoystickHost, SendDataToClient
     //      ReceiveDataFromClient, MoveLEDs (low priority), Idle
+    EndOfGameQueued = false;
+#ifdef BENCH_ROUND_RESTART
+    uint32_t setupStart = G8RTOS_CYCLES();
+    addHostThreads();
+    PrintRoundRestart(setupStart);
+#else
     addHostThreads();
+#endif
 
-    // 7. Kill self.
-    G8RTOS_KillSelf();
+    // 7. Kill self (or return to the worker pool).
+    EndJob();
 }
 
 // ==================== CLIENT CLIENT CLIENT CLIENT ==========================
@@ -1002,36 +1489,65 @@ void ReceiveDataFromHost()
         do
         {
             // 1. Receive packet from the host
-            G8RTOS_WaitSemaphore(&CC3100_SEMAPHORE);
+            G8RTOS_AcquireMutex(&CC3100_SEMAPHORE);
             result = ReceiveData( (_u8*)&packet, sizeof(packet));
-            G8RTOS_SignalSemaphore(&CC3100_SEMAPHORE);
+            G8RTOS_ReleaseMutex(&CC3100_SEMAPHORE);
         } while ( result < 0 );
 
         // 2. Update the gamestate information if it is not being
         //      used by another thread currently.
         emptyPacket(&gamestate, &packet);
 
-        // 3. Check if the game is done. Add EndOfGameHost thread if done.
+        NotifyScoreChange();
+
+        // 3. Check if the game is done. Start the end of game work if done.
         if ( gamestate.gameDone == true )
-            G8RTOS_AddThread(EndOfGameClient, 0, 0xFFFFFFFF, "END_GAME_CLIENT_");
+            QueueEndOfGame(&EndOfGameClient, "END_GAME_CLIENT_");
 
         // allows update draw thread to run and update previous balls and players
         sleep(5);
     }
 #endif
 #ifdef GAMESTATE
+    GameState_t * received = 0;
 
     while(1)
     {
+        // 1. Receive packet from the host into a pool buffer. The buffer
+        //      is kept for the next try if nothing arrived.
+        if ( received == 0 )
+            received = G8RTOS_PoolAlloc(&PacketPool);
 
-        // 1. Receive packet from the host
-        G8RTOS_WaitSemaphore(&CC3100_SEMAPHORE);
-        ReceiveData( (_u8*)&gamestate, sizeof(gamestate));
-        G8RTOS_SignalSemaphore(&CC3100_SEMAPHORE);
+        if ( received != 0 )
+        {
+            G8RTOS_AcquireMutex(&CC3100_SEMAPHORE);
+            int32_t result = ReceiveData( (_u8*)received, sizeof(*received));
+            G8RTOS_ReleaseMutex(&CC3100_SEMAPHORE);
+
+            if ( result >= 0 )
+            {
+                // 2. Only the fields other threads poll are copied into gamestate.
+                //      DrawObjects draws from the buffer itself.
+                gamestate.gameDone = received->gameDone;
+                gamestate.winner = received->winner;
+                for (int i = 0; i < MAX_NUM_OF_PLAYERS; i++)
+                {
+                    gamestate.LEDScores[i] = received->LEDScores[i];
+                    gamestate.overallScores[i] = received->overallScores[i];
+                }
+
+                // a full queue means DrawObjects is behind. Receive the next
+                // packet over this one instead.
+                if ( G8RTOS_QueueSend(&PacketQueue, received) == 0 )
+                    received = 0;
+            }
+        }
+
+        NotifyScoreChange();
 
-        // 3. Check if the game is done. Add EndOfGameHost thread if done.
+        // 3. Check if the game is done. Start the end of game work if done.
         if ( gamestate.gameDone == true )
-            G8RTOS_AddThread(EndOfGameClient, 0, 0xFFFFFFFF, "END_GAME_CLIENT_");
+            QueueEndOfGame(&EndOfGameClient, "END_GAME_CLIENT_");
 
         sleep(2);
     }
@@ -1051,9 +1567,9 @@ void SendDataToHost()
 
         // Send data to host in this order. Corrects issue with
         // Host receiving displacement inside of IP_address.
-        G8RTOS_WaitSemaphore(&CC3100_SEMAPHORE);
+        G8RTOS_AcquireMutex(&CC3100_SEMAPHORE);
         SendData( (_u8*)&packet.player, HOST_IP_ADDR, sizeof(packet.player));  // forcing order
-        G8RTOS_SignalSemaphore(&CC3100_SEMAPHORE);
+        G8RTOS_ReleaseMutex(&CC3100_SEMAPHORE);
 
         sleep(2);
     }
@@ -1062,9 +1578,9 @@ void SendDataToHost()
 
     while(1)
     {
-        G8RTOS_WaitSemaphore(&CC3100_SEMAPHORE);
+        G8RTOS_AcquireMutex(&CC3100_SEMAPHORE);
         SendData( (_u8*)&client_player, HOST_IP_ADDR, sizeof(client_player) );
-        G8RTOS_SignalSemaphore(&CC3100_SEMAPHORE);
+        G8RTOS_ReleaseMutex(&CC3100_SEMAPHORE);
 
         sleep(5);
     }
@@ -1072,43 +1588,25 @@ void SendDataToHost()
 }
 
 /*
- * Thread to read client's joystick
+ * Periodic event that reads the client's joystick every JOYSTICK_PERIOD_CLIENT ms
+ * Runs inside SysTick_Handler, so it must never block or sleep.
  */
 void ReadJoystickClient()
 {
-    int16_t avg = 0;
+    static int16_t avg = 0;
     int16_t joystick_x = 0;
     int16_t joystick_y = 0;
 
-    while(1)
-    {
-        // moving average of the joystick inputs
-        GetJoystickCoordinates(&joystick_x, &joystick_y);
-        avg = (avg + joystick_x + JOYSTICK_BIAS_CLIENT) >> 1;
-
-        // use the joystick controls to increase and decrease
-        // the player velocity
-        // switch(avg) {
-        // case -10000 ... -6000   : displacement = 3;   break;
-        // case -5999 ... -4000    : displacement = 2;    break;
-        // case -3999 ... -2000    : displacement = 1;    break;
-        // case -1999 ... -750     : displacement = 1;    break;
-        // case -749  ... 750      : displacement = 0;     break;
-        // case 751   ... 2000     : displacement = -1;     break;
-        // case 2001  ... 4000     : displacement = -1;     break;
-        // case 4001  ... 6000     : displacement = -2;     break;
-        // case 6001  ... 10000    : displacement = -3;    break;
-        // default                 : displacement = 0;     break;
-        // }
-
-        // The switch statement was causing about 500 ms of lag
-        displacement = -(avg >> 9);
-
-        // move the player's center
-        client_player.displacement = displacement;
-
-        sleep(10);
-    }
+    // moving average of the joystick inputs
+    GetJoystickCoordinates(&joystick_x, &joystick_y);
+    avg = (avg + joystick_x + JOYSTICK_BIAS_CLIENT) >> 1;
+
+    // The switch statement that used to map avg to a displacement
+    // was causing about 500 ms of lag
+    displacement = -(avg >> 9);
+
+    // move the player's center
+    client_player.displacement = displacement;
 }
 
 /*
@@ -1119,15 +1617,21 @@ void EndOfGameClient()
     while(1)
     {
         // wait for semaphores
-        G8RTOS_WaitSemaphore(&LCDREADY);
-        G8RTOS_WaitSemaphore(&LEDREADY);
-        G8RTOS_WaitSemaphore(&CC3100_SEMAPHORE);
+        G8RTOS_AcquireMutex(&LCDREADY);
+        G8RTOS_AcquireMutex(&LEDREADY);
+        G8RTOS_AcquireMutex(&CC3100_SEMAPHORE);
 
         G8RTOS_KillAllOthers();
+        G8RTOS_KillPeriodicEvent(&ReadJoystickClient);
+        RoundGeneration++;
 
-        G8RTOS_InitSemaphore(&LEDREADY, 1);
-        G8RTOS_InitSemaphore(&LCDREADY, 1);
-        G8RTOS_InitSemaphore(&CC3100_SEMAPHORE, 1);
+        G8RTOS_ReleaseMutex(&LEDREADY);
+        G8RTOS_ReleaseMutex(&LCDREADY);
+        G8RTOS_ReleaseMutex(&CC3100_SEMAPHORE);
+
+#ifdef BENCH_ROUND_RESTART
+        G8RTOS_RecordCycleStat(&RestartTeardownCycles, G8RTOS_CYCLES() - RestartStart);
+#endif
 
         // determine winner
         if(gamestate.LEDScores[0] == 8){
@@ -1142,12 +1646,7 @@ void EndOfGameClient()
         }
         gamestate.LEDScores[0] = 0;
         gamestate.LEDScores[1] = 0;
-        for(int i = 0; i < MAX_NUM_OF_BALLS; i++){
-            gamestate.balls[i].alive = 0;
-            gamestate.balls[i].kill = 0;
-        }
-
-        ballCount = 0;
+        ClearBalls();
         playerCount = 2;
 
         setLedMode_lp3943( RED, 0x0000);
@@ -1172,7 +1671,7 @@ void EndOfGameClient()
 
             // thanks for playing
             // reset leds on board
-            G8RTOS_KillSelf();
+            EndJob();
         }
 
 
@@ -1183,10 +1682,17 @@ void EndOfGameClient()
 
         // 6. Add GenerateBall, DrawObjects, ReadJoystickHost, SendDataToClient
         //      ReceiveDataFromClient, MoveLEDs (low priority), Idle
+        EndOfGameQueued = false;
+#ifdef BENCH_ROUND_RESTART
+        uint32_t setupStart = G8RTOS_CYCLES();
         addClientThreads();
+        PrintRoundRestart(setupStart);
+#else
+        addClientThreads();
+#endif
 
-        // 7. Kill self.
-        G8RTOS_KillSelf();
+        // 7. Kill self (or return to the worker pool).
+        EndJob();
     }
 }
 
@@ -1204,30 +1710,53 @@ void DrawObjects()
         prevPlayers[i].Center = -1; // load fake values to determine first run
     }
 
+    uint32_t nextFrame = SystemTime;
+
+    // the host draws its own gamestate. The client draws the newest
+    // packet from the host straight out of its pool buffer.
+    GameState_t * frame = &gamestate;
+
     while(1)
     {
+#ifdef BENCH_BALL_STRESS
+        uint32_t frameStart = G8RTOS_CYCLES();
+#endif
+#ifdef GAMESTATE
+        if ( myPlayerType == Client )
+            frame = NewestPacket(frame);
+#endif
+#ifdef PHYSICS_ENGINE
+        // the host draws the last tick's snapshot. The simulation frees
+        // dead ball slots itself, so this copy is free to change.
+        if ( myPlayerType == Host )
+        {
+            ReadSnapshot(&HostFrame);
+            frame = &HostFrame;
+        }
+#endif
+
         // Draw players --------------------
         for (int i = 0; i < playerCount; i++)
         {
             // This player is on its first run. Draw
             // the entire paddle.
             if ( prevPlayers[i].Center == -1 ) {
-                DrawPlayer( &gamestate.players[i] );
-                prevPlayers[i].Center = gamestate.players[i].currentCenter;
+                DrawPlayer( &frame->players[i] );
+                prevPlayers[i].Center = frame->players[i].currentCenter;
             }
             // if this player has already been drawn, only
             // update the parts that need to be redrawn.
             else
             {
-                // G8RTOS_WaitSemaphore(&GAMESTATE_SEMAPHORE);
-                UpdatePlayerOnScreen( &prevPlayers[i], &gamestate.players[i]);
-                // G8RTOS_SignalSemaphore(&GAMESTATE_SEMAPHORE);
+                // G8RTOS_AcquireMutex(&GAMESTATE_SEMAPHORE);
+                UpdatePlayerOnScreen( &prevPlayers[i], &frame->players[i]);
+                // G8RTOS_ReleaseMutex(&GAMESTATE_SEMAPHORE);
             }
         }
 
         // Draw the ping pong balls ----------
-        // STATE MACHINE..
-        for(int i = 0; i < MAX_NUM_OF_BALLS; i++){
+        // STATE MACHINE.. only over the slots in the ball mask
+        for(int32_t i = Physics_NextBall(frame->ballMask, -1); i >= 0; i = Physics_NextBall(frame->ballMask, i)){
 
             // IF AT ORIGIN, THEN OFFSET Y TO NON OCCUPIED SPACE
             if(previousBalls[i].CenterX < ARENA_MIN_X){
@@ -1235,15 +1764,17 @@ void DrawObjects()
             }
 
             // ALIVE && !KILL = REDRAW STATE
-            if(gamestate.balls[i].alive && !gamestate.balls[i].kill){
-                UpdateBallOnScreen(&previousBalls[i], &gamestate.balls[i], gamestate.balls[i].color);
+            if(frame->balls[i].alive && !frame->balls[i].kill){
+                UpdateBallOnScreen(&previousBalls[i], &frame->balls[i], frame->balls[i].color);
             }
 
             // ALIVE && KILL = KILL HOST STATE
-            else if(gamestate.balls[i].alive && gamestate.balls[i].kill){
-                UpdateBallOnScreen(&previousBalls[i], &gamestate.balls[i], LCD_BLACK);
-                gamestate.balls[i].alive = 0;
+            else if(frame->balls[i].alive && frame->balls[i].kill){
+                UpdateBallOnScreen(&previousBalls[i], &frame->balls[i], LCD_BLACK);
+                frame->balls[i].alive = 0;
+#ifndef PHYSICS_ENGINE
                 ballCount--;
+#endif
             }
 
             // !ALIVE && KILL = KILL CLIENT STATE
@@ -1251,18 +1782,25 @@ void DrawObjects()
             // doesn't run again before the packet is sent. This allows the
             // client to enter this state before the host enters this state
             // and delete the ball on the client side.
-            else if ( !gamestate.balls[i].alive && gamestate.balls[i].kill )
+            else if ( !frame->balls[i].alive && frame->balls[i].kill )
             {
-                UpdateBallOnScreen(&previousBalls[i], &gamestate.balls[i], LCD_BLACK);
-                gamestate.balls[i].kill = 0;
+                UpdateBallOnScreen(&previousBalls[i], &frame->balls[i], LCD_BLACK);
+                frame->balls[i].kill = 0;
             }
 
             // !ALIVE && !KILL = NULL STATE
             // else do nothing .. (ALL 4 STATES ARE USED WITH THESE 2 BOOLEANS)
         }
 
+#ifdef BENCH_BALL_STRESS
+        if ( myPlayerType == Host )
+            RecordStressFrame(frameStart, nextFrame + 25);
+#endif
+
         // Refresh rate --------------------
-        sleep(25);
+        // wake on a fixed 25 ms grid so drawing time doesn't stretch the period
+        nextFrame += 25;
+        sleep_until(nextFrame);
     }
 }
 
@@ -1271,6 +1809,8 @@ void DrawObjects()
  */
 void MoveLEDs()
 {
+    LEDThreadId = G8RTOS_GetThreadId();
+
     setLedPwm_lp3943( RED, 0xFF );
     setLedPwm_lp3943( BLUE, 0xFF );
 
@@ -1288,37 +1828,73 @@ void MoveLEDs()
         uint16_t REDdata = (hostLEDS<<8);
         uint16_t BLUEdata = clientLEDS;
 
-        G8RTOS_WaitSemaphore(&LEDREADY);
+        G8RTOS_AcquireMutex(&LEDREADY);
 
         setLedMode_lp3943( RED, REDdata);
         setLedMode_lp3943( BLUE, BLUEdata);
 
-        G8RTOS_SignalSemaphore(&LEDREADY);
+        G8RTOS_ReleaseMutex(&LEDREADY);
 
-        sleep(100);
+        // the LEDs only change when someone scores
+        G8RTOS_WaitNotify();
     }
 }
 
 /*
- * Idle thread to avoid deadlocks and RTOS end
+ * Idle thread to avoid deadlocks and RTOS end.
+ * Stops the CPU until something else can run.
  */
-void IdleThread() { while(1); }
+void IdleThread()
+{
+    while(1)
+    {
+        G8RTOS_Idle();
+    }
+}
 
 /* ===================== APERIODIC APERIODIC APERIODIC ====================== */
+/*
+ * Top half of the button interrupt (ports 4 and 5). Reads and clears the
+ * flags and leaves the game logic to ButtonPressDeferred. Before launch
+ * (the main menu) there is no deferred work thread, so it runs here.
+ */
 void ButtonPress ( void )
 {
+    uint32_t start = G8RTOS_CYCLES();
+    TRACE_ISR_ENTER();
+    uint32_t flags = (P4->IFG & (BIT4 | BIT5)) | ((P5->IFG & (BIT4 | BIT5)) << 8);
+
+    P4->IFG &= ~(BIT4 | BIT5);
+    P5->IFG &= ~(BIT4 | BIT5);
+
+    if ( G8RTOS_DeferWork(&ButtonPressDeferred, flags) != 0 )
+        ButtonPressDeferred(flags);
+
+    TRACE_ISR_EXIT();
+    G8RTOS_RecordIsrCycles(start);
+}
+
+/*
+ * Bottom half of the button interrupt
+ * Param "flags": port 4 flags in bits 0-7, port 5 flags in bits 8-15
+ */
+void ButtonPressDeferred ( uint32_t flags )
+{
+    uint8_t p4 = flags & 0xFF;
+    uint8_t p5 = (flags >> 8) & 0xFF;
+
     // PORT 4 INTERRUPT ROUTINES ---------------------------------
     // Daughter board buttons B2, B3 need to be resoldered.
     // Until then, use this configuration...
     // B0 = UP (BIT4), B1 = RIGHT (BIT5) -------------------------
-    if ( (P4->IFG & BIT4) && GameInitMode == 1 )
+    if ( (p4 & BIT4) && GameInitMode == 1 )
     {
         NVIC_DisableIRQ(PORT4_IRQn);
         NVIC_DisableIRQ(PORT5_IRQn);
         myPlayerType = Host;
         GameInitMode = 0;
     }
-    else if ( (P4->IFG & BIT5) && GameInitMode == 1 )
+    else if ( (p4 & BIT5) && GameInitMode == 1 )
     {
         NVIC_DisableIRQ(PORT4_IRQn);
         NVIC_DisableIRQ(PORT5_IRQn);
@@ -1327,26 +1903,26 @@ void ButtonPress ( void )
     }
 
     // determine the next game mode
-    else if ( (P4->IFG & BIT4))
+    else if ( (p4 & BIT4))
     {
         NVIC_DisableIRQ(PORT4_IRQn);
         NVIC_DisableIRQ(PORT5_IRQn);
         nextState = NextGame;
+        G8RTOS_SetEvents(&GameEvents, BUTTON_EVENT);
     }
-    else if ( (P4->IFG & BIT5))
+    else if ( (p4 & BIT5))
     {
         NVIC_DisableIRQ(PORT4_IRQn);
         NVIC_DisableIRQ(PORT5_IRQn);
         nextState = EndGame;
+        G8RTOS_SetEvents(&GameEvents, BUTTON_EVENT);
     }
 
     // B0 = UP (BIT4), B1 = RIGHT (BIT5) --------------------------
 
-    P4->IFG &= ~(BIT4 | BIT5);
-
     // PORT 5 INTERRUPT ROUTINE ---------------------------------------
     // MAIN MENU NAVIGATION MODE --------------------------------------
-    if ( (P5->IFG & BIT4 || P5->IFG & BIT5) && GameInitMode == 1 )
+    if ( (p5 & BIT4 || p5 & BIT5) && GameInitMode == 1 )
     {
         NVIC_DisableIRQ(PORT5_IRQn);
         NVIC_DisableIRQ(PORT4_IRQn);
@@ -1355,6 +1931,4 @@ void ButtonPress ( void )
     }
 
     // B2 = DOWN (BIT4), B3 = LEFT (BIT5) ------------------------
-
-    P5->IFG &= ~(BIT4 | BIT5);
 }
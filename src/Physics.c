@@ -0,0 +1,418 @@
+/*
+ * Physics.c
+ *
+ *  Batched ball physics. See Physics.h.
+ */
+
+#include "Physics.h"
+
+/*********************************************** Sizes and Limits *********************************************************************/
+
+/* Lines the top left corner of a ball can't cross. The side walls keep
+ * the 1 pixel gap MoveBall left. The paddle lines are where the ball
+ * touches the paddle, from the Minkowski sum of the two. */
+#define BALL_MIN_X          PHYSICS_FROM_PIXEL(ARENA_MIN_X + 1)
+#define BALL_MAX_X          PHYSICS_FROM_PIXEL(ARENA_MAX_X - BALL_SIZE - 1)
+#define BALL_MIN_Y          PHYSICS_FROM_PIXEL(TOP_PLAYER_CENTER_Y + HEIGHT_TOP_OR_BOTTOM - BALL_SIZE_D2)
+#define BALL_MAX_Y          PHYSICS_FROM_PIXEL(BOTTOM_PLAYER_CENTER_Y - HEIGHT_TOP_OR_BOTTOM - BALL_SIZE_D2)
+
+#define NEVER               INT32_MAX   // time to a line the ball isn't moving toward
+
+/*********************************************** Sizes and Limits *********************************************************************/
+
+// ======================   PRIVATE FUNCTIONS      ==========================
+
+/*
+ * Paddle bounce. Reverses yvel and steers the ball by where it hit:
+ * a ball whose center is on the outer quarter of a paddle is pushed
+ * outward and changes its speed, the middle half only reverses it.
+ * Param "x": pixel the ball was at when it hit
+ */
+static void BouncePaddle(ball_store_t *store, int32_t i, int16_t x, int16_t hostCenter, int16_t clientCenter)
+{
+    int16_t xvel = store->xvel[i];
+    int16_t yvel = -store->yvel[i];
+    int16_t ballCenter = x + BALL_SIZE_D2;
+
+    // bounced off the client's paddle (now going down)
+    if ( yvel > 0 )
+    {
+        store->color[i] = PLAYER_BLUE;
+        if ( ballCenter < clientCenter - (PADDLE_LEN_D2 >> 1) )
+        {
+            // left 1/4 of client side
+            xvel -= 1;
+            yvel += (xvel > 0) ? 1 : -1;
+        }
+        else if ( ballCenter > clientCenter + (PADDLE_LEN_D2 >> 1) )
+        {
+            // right 1/4 of client side
+            xvel += 1;
+            yvel += (xvel < 0) ? 1 : -1;
+        }
+        if ( yvel == 0 ) yvel = 1;
+    }
+
+    // bounced off the host's paddle (now going up)
+    else
+    {
+        store->color[i] = PLAYER_RED;
+        if ( ballCenter < hostCenter - (PADDLE_LEN_D2 >> 1) )
+        {
+            // left 1/4 of host side
+            xvel += 1;
+            yvel += (xvel > 0) ? 1 : -1;
+        }
+        else if ( ballCenter > hostCenter + (PADDLE_LEN_D2 >> 1) )
+        {
+            // right 1/4 of host side
+            xvel -= 1;
+            yvel += (xvel < 0) ? 1 : -1;
+        }
+        if ( yvel == 0 ) yvel = -1;
+    }
+
+    store->xvel[i] = xvel;
+    store->yvel[i] = yvel;
+}
+
+/*
+ * Returns true if a ball at x (fixed point) touches the paddle centered
+ * at center: its center is inside the paddle grown by half a ball.
+ */
+static inline bool OverPaddle(int32_t x, int16_t center)
+{
+    int32_t offset = x + PHYSICS_FROM_PIXEL(BALL_SIZE_D2) - PHYSICS_FROM_PIXEL(center);
+    return offset >= -PHYSICS_FROM_PIXEL(WIDTH_TOP_OR_BOTTOM)
+        && offset <= PHYSICS_FROM_PIXEL(WIDTH_TOP_OR_BOTTOM);
+}
+
+/*
+ * Time until a ball at pos moving vel per step reaches min or max
+ * Returns: fixed point fraction of a step, rounded down so the ball
+ *          stops short of the line rather than past it. 0 if it is
+ *          already on or past the line, NEVER if it isn't moving.
+ */
+static inline int32_t TimeToLine(int32_t pos, int16_t vel, int32_t min, int32_t max)
+{
+    int32_t distance;
+
+    if ( vel > 0 )
+        distance = max - pos;
+    else if ( vel < 0 )
+        distance = min - pos;
+    else
+        return NEVER;
+
+    // distance and vel have the same sign unless the ball is past the line
+    if ( (distance > 0) != (vel > 0) )
+        return 0;
+
+    return distance / vel;
+}
+
+#ifdef BALL_COLLISIONS
+/*
+ * Keeps a ball pushed by a collision inside the lines it can't cross
+ */
+static inline int32_t Clamp(int32_t pos, int32_t min, int32_t max)
+{
+    if ( pos < min ) return min;
+    if ( pos > max ) return max;
+    return pos;
+}
+
+/*
+ * Separates two overlapping balls on one axis and swaps their velocities
+ * on it if they were moving together. "before" is j's offset from i at
+ * the start of the step, so balls fast enough to cross in one step are
+ * put back on their own sides.
+ */
+static void BounceAxis(int32_t *pos_i, int32_t *pos_j, int16_t *vel_i, int16_t *vel_j,
+                       int32_t before, int32_t min, int32_t max)
+{
+    int32_t side = (before < 0) ? -1 : 1;
+
+    if ( (*vel_j - *vel_i) * side < 0 )
+    {
+        int16_t vel = *vel_i;
+        *vel_i = *vel_j;
+        *vel_j = vel;
+    }
+
+    // touching, around the middle of the two
+    int32_t middle = (*pos_i + *pos_j) >> 1;
+    *pos_i = Clamp(middle - side * PHYSICS_FROM_PIXEL(BALL_SIZE_D2), min, max);
+    *pos_j = Clamp(middle + side * PHYSICS_FROM_PIXEL(BALL_SIZE_D2), min, max);
+}
+
+/*
+ * Bounces two balls off each other if they overlap. The balls are
+ * squares of equal mass, so they bounce on the axis they came together
+ * on: the one they were apart on before the step, or the one they
+ * overlap least on if that doesn't tell.
+ */
+static void CollidePair(ball_store_t *store, int32_t i, int32_t j)
+{
+    int32_t dx = store->x[j] - store->x[i];
+    int32_t dy = store->y[j] - store->y[i];
+    int32_t overlapX = PHYSICS_FROM_PIXEL(BALL_SIZE) - ((dx < 0) ? -dx : dx);
+    int32_t overlapY = PHYSICS_FROM_PIXEL(BALL_SIZE) - ((dy < 0) ? -dy : dy);
+
+    if ( overlapX <= 0 || overlapY <= 0 )
+        return;
+
+    int32_t beforeX = dx - PHYSICS_FROM_PIXEL(store->xvel[j] - store->xvel[i]);
+    int32_t beforeY = dy - PHYSICS_FROM_PIXEL(store->yvel[j] - store->yvel[i]);
+    bool apartX = beforeX >= PHYSICS_FROM_PIXEL(BALL_SIZE) || beforeX <= -PHYSICS_FROM_PIXEL(BALL_SIZE);
+    bool apartY = beforeY >= PHYSICS_FROM_PIXEL(BALL_SIZE) || beforeY <= -PHYSICS_FROM_PIXEL(BALL_SIZE);
+    bool onX = (apartX != apartY) ? apartX : (overlapX < overlapY);
+
+    if ( onX )
+        BounceAxis(&store->x[i], &store->x[j], &store->xvel[i], &store->xvel[j],
+                   apartX ? beforeX : dx, BALL_MIN_X, BALL_MAX_X);
+    else
+        BounceAxis(&store->y[i], &store->y[j], &store->yvel[i], &store->yvel[j],
+                   apartY ? beforeY : dy, BALL_MIN_Y, BALL_MAX_Y);
+}
+
+/*
+ * Tests a ball against every ball in the list starting at j
+ * Returns: number of pairs tested
+ */
+static inline uint32_t CollideList(ball_store_t *store, int32_t i, int32_t j)
+{
+    uint32_t pairs = 0;
+
+    for ( ; j >= 0; j = store->cellNext[j] )
+    {
+        CollidePair(store, i, j);
+        pairs++;
+    }
+
+    return pairs;
+}
+
+/*
+ * Broad phase. Bins every live ball into the grid, then tests each ball
+ * against the rest of its own cell and the cells east, south west, south
+ * and south east of it, so every neighbouring pair is tested once. Only
+ * the cells that were used are emptied again.
+ */
+static void CollideBalls(ball_store_t *store)
+{
+    uint32_t pairs = 0;
+    int32_t i;
+
+    for (i = Physics_NextBall(store->alive, -1); i >= 0; i = Physics_NextBall(store->alive, i))
+    {
+        uint32_t col = (PHYSICS_TO_PIXEL(store->x[i]) - ARENA_MIN_X) >> GRID_CELL_SHIFT;
+        uint32_t row = (PHYSICS_TO_PIXEL(store->y[i]) - ARENA_MIN_Y) >> GRID_CELL_SHIFT;
+        uint16_t cell = row * GRID_COLS + col;
+
+        store->cell[i] = cell;
+        store->cellNext[i] = store->cellHead[cell];
+        store->cellHead[cell] = i;
+    }
+
+    for (i = Physics_NextBall(store->alive, -1); i >= 0; i = Physics_NextBall(store->alive, i))
+    {
+        uint32_t col = store->cell[i] % GRID_COLS;
+        uint32_t row = store->cell[i] / GRID_COLS;
+
+        pairs += CollideList(store, i, store->cellNext[i]);
+
+        if ( col + 1 < GRID_COLS )
+            pairs += CollideList(store, i, store->cellHead[store->cell[i] + 1]);
+
+        if ( row + 1 < GRID_ROWS )
+        {
+            if ( col > 0 )
+                pairs += CollideList(store, i, store->cellHead[store->cell[i] + GRID_COLS - 1]);
+            pairs += CollideList(store, i, store->cellHead[store->cell[i] + GRID_COLS]);
+            if ( col + 1 < GRID_COLS )
+                pairs += CollideList(store, i, store->cellHead[store->cell[i] + GRID_COLS + 1]);
+        }
+    }
+
+    for (i = Physics_NextBall(store->alive, -1); i >= 0; i = Physics_NextBall(store->alive, i))
+        store->cellHead[store->cell[i]] = -1;
+
+    store->pairsTested = pairs;
+}
+#endif
+
+// ======================   PUBLIC FUNCTIONS       ==========================
+
+void Physics_Init(ball_store_t *store)
+{
+    for (int i = 0; i < BALL_MASK_WORDS; i++)
+    {
+        store->alive[i] = 0;
+        store->used[i] = 0;
+    }
+
+    // slot 0 on top, so balls fill the store from the front
+    for (int i = 0; i < MAX_NUM_OF_BALLS; i++)
+        store->freeSlots[i] = MAX_NUM_OF_BALLS - 1 - i;
+
+    store->numFree = MAX_NUM_OF_BALLS;
+    store->numAlive = 0;
+    store->numExits = 0;
+
+#ifdef BALL_COLLISIONS
+    for (int i = 0; i < GRID_CELLS; i++)
+        store->cellHead[i] = -1;
+    store->pairsTested = 0;
+#endif
+}
+
+void Physics_Reset(ball_store_t *store)
+{
+    for (int32_t i = Physics_NextBall(store->used, -1); i >= 0; i = Physics_NextBall(store->used, i))
+        store->freeSlots[store->numFree++] = i;
+
+    for (int i = 0; i < BALL_MASK_WORDS; i++)
+    {
+        store->alive[i] = 0;
+        store->used[i] = 0;
+    }
+
+    store->numAlive = 0;
+    store->numExits = 0;
+}
+
+int32_t Physics_AddBall(ball_store_t *store)
+{
+    if ( store->numFree == 0 )
+        return -1;
+
+    int32_t slot = store->freeSlots[--store->numFree];
+
+    store->x[slot] = PHYSICS_FROM_PIXEL(BALL_SIZE * (rand() % ((ARENA_MAX_X - ARENA_MIN_X - BALL_SIZE)/BALL_SIZE)) + ARENA_MIN_X + 1);
+    store->y[slot] = PHYSICS_FROM_PIXEL(BALL_SIZE * (rand() % (((ARENA_MAX_Y - 80 - ARENA_MIN_Y)/BALL_SIZE)) + 10));
+    store->xvel[slot] = rand() % MAX_BALL_SPEED + 1;
+    store->yvel[slot] = rand() % MAX_BALL_SPEED + 1;
+    store->color[slot] = LCD_WHITE;
+    store->exited[slot] = EXIT_NONE;
+
+    // balls in the lower half start toward the client
+    if ( store->y[slot] > PHYSICS_FROM_PIXEL(120) )
+        store->yvel[slot] = -store->yvel[slot];
+
+    store->alive[slot >> 5] |= BALL_BIT(slot);
+    store->used[slot >> 5] |= BALL_BIT(slot);
+    store->numAlive++;
+    return slot;
+}
+
+void Physics_FreeBall(ball_store_t *store, uint32_t slot)
+{
+    if ( (store->used[slot >> 5] & BALL_BIT(slot)) == 0 )
+        return;
+
+    // a live ball is killed first
+    if ( store->alive[slot >> 5] & BALL_BIT(slot) )
+    {
+        store->alive[slot >> 5] &= ~BALL_BIT(slot);
+        store->numAlive--;
+    }
+
+    store->used[slot >> 5] &= ~BALL_BIT(slot);
+    store->exited[slot] = EXIT_NONE;
+    store->freeSlots[store->numFree++] = slot;
+}
+
+int32_t Physics_NextBall(const uint32_t *mask, int32_t after)
+{
+    int32_t slot = after + 1;
+    int32_t word = slot >> 5;
+
+    if ( word >= BALL_MASK_WORDS )
+        return -1;
+
+    // drop the bits up to "after" in its word
+    uint32_t bits = mask[word] & (0xFFFFFFFF >> (slot & 31));
+
+    while ( bits == 0 )
+    {
+        if ( ++word == BALL_MASK_WORDS )
+            return -1;
+        bits = mask[word];
+    }
+
+    return (word << 5) | __CLZ(bits);
+}
+
+uint32_t Physics_Step(ball_store_t *store, int16_t hostCenter, int16_t clientCenter)
+{
+    store->numExits = 0;
+
+    for (int32_t i = Physics_NextBall(store->alive, -1); i >= 0; i = Physics_NextBall(store->alive, i))
+    {
+        int32_t x = store->x[i];
+        int32_t y = store->y[i];
+        int32_t left = PHYSICS_ONE;     // time left in this step
+
+        // move to each impact in turn and reflect there. A ball in a
+        // corner hits a wall and a paddle line at the same time.
+        for (int hit = 0; hit < PHYSICS_MAX_HITS; hit++)
+        {
+            int16_t xvel = store->xvel[i];
+            int16_t yvel = store->yvel[i];
+            int32_t tx = TimeToLine(x, xvel, BALL_MIN_X, BALL_MAX_X);
+            int32_t ty = TimeToLine(y, yvel, BALL_MIN_Y, BALL_MAX_Y);
+            int32_t t = (tx < ty) ? tx : ty;
+
+            if ( t >= left )
+                break;
+
+            x += xvel * t;
+            y += yvel * t;
+            left -= t;
+
+            // side wall
+            if ( tx == t )
+                store->xvel[i] = -xvel;
+
+            // bottom (host) or top (client) paddle line
+            if ( ty == t )
+            {
+                int16_t center = (yvel > 0) ? hostCenter : clientCenter;
+
+                // missed the paddle. The ball dies on its line.
+                if ( !OverPaddle(x, center) )
+                {
+                    store->alive[i >> 5] &= ~BALL_BIT(i);
+                    store->numAlive--;
+                    store->exited[i] = (yvel > 0) ? EXIT_BOTTOM : EXIT_TOP;
+                    store->exits[store->numExits++] = i;
+                    break;
+                }
+
+                BouncePaddle(store, i, PHYSICS_TO_PIXEL(x), hostCenter, clientCenter);
+            }
+        }
+
+        if ( store->exited[i] == EXIT_NONE )
+        {
+            x += store->xvel[i] * left;
+            y += store->yvel[i] * left;
+
+            // only reachable after PHYSICS_MAX_HITS impacts in one step
+            if ( x < BALL_MIN_X ) x = BALL_MIN_X;
+            if ( x > BALL_MAX_X ) x = BALL_MAX_X;
+            if ( y < BALL_MIN_Y ) y = BALL_MIN_Y;
+            if ( y > BALL_MAX_Y ) y = BALL_MAX_Y;
+        }
+
+        store->x[i] = x;
+        store->y[i] = y;
+    }
+
+#ifdef BALL_COLLISIONS
+    CollideBalls(store);
+#endif
+
+    return store->numExits;
+}
@@ -1,6 +1,10 @@
 #define MAIN
 #define BUTTON_BUG
 
+// MAIN      : Runs the game.
+// BENCHMARK : Runs the kernel benchmarks enabled in G8RTOS_Scheduler.h
+//             instead of the game (see Benchmark.h).
+
 // To run game with different routers, go to the
 // cc3100_usage.h and sl_common.h header files and
 // adjust the preprocessor directive.
@@ -24,6 +28,7 @@
 #include "cc3100_usage.h"
 #include "LCD_empty.h"
 #include "Game.h"
+#include "Benchmark.h"
 
 // MACROS --------------------------------------------
 #define TP_ENABLE   1
@@ -43,17 +48,21 @@ void main(void)
     buttons_init();
     LCD_Init(TP_DISABLE);
 
-    G8RTOS_AddAperiodicEvent_Priority(&ButtonPress, 0, PORT4_IRQn);
-    G8RTOS_AddAperiodicEvent_Priority(&ButtonPress, 0, PORT5_IRQn);
+    G8RTOS_AddAperiodicEvent_Priority(&ButtonPress, KERNEL_IRQ_PRIORITY, PORT4_IRQn);
+    G8RTOS_AddAperiodicEvent_Priority(&ButtonPress, KERNEL_IRQ_PRIORITY, PORT5_IRQn);
 
     // write the menu text
     writeMainMenu(MENU_TEXT_COLOR);
 
     // Initialize semaphores
-    G8RTOS_InitSemaphore(&CC3100_SEMAPHORE, 1);
-    G8RTOS_InitSemaphore(&GAMESTATE_SEMAPHORE, 1);
-	G8RTOS_InitSemaphore(&LCDREADY, 1);
-    G8RTOS_InitSemaphore(&LEDREADY, 1);    
+    G8RTOS_InitMutex(&CC3100_SEMAPHORE);
+    G8RTOS_InitMutex(&GAMESTATE_SEMAPHORE);
+	G8RTOS_InitMutex(&LCDREADY);
+    G8RTOS_InitMutex(&LEDREADY);    
+    G8RTOS_InitEventGroup(&GameEvents);
+
+    // button and CC3100 interrupt bottom halves run on this thread
+    G8RTOS_InitDeferredWork();
   
     // write the menu text
     writeMainMenu(MENU_TEXT_COLOR);
@@ -65,14 +74,20 @@ void main(void)
         if (myPlayerType == Host)
         {
             // Initialize HOST-side threads
-            G8RTOS_AddThread( &CreateGame, 0, 0xFFFFFFFF, "CREATE_GAME_____" ); // lowest priority
+            G8RTOS_AddThread( &CreateGame, 1, 0xFFFFFFFF, LARGE_STACK, "CREATE_GAME_____" ); // below the deferred work thread only
+#ifdef WORKER_POOL
+            G8RTOS_InitWorkerPool( HOST_WORKERS, WORKER_PRIORITY, LARGE_STACK );
+#endif
             break;
         }
 
         else if ( myPlayerType == Client )
         {
             // Initialize CLIENT-side threads
-            G8RTOS_AddThread( &JoinGame, 0, 0xFFFFFFFF, "JOIN_GAME_______" ); // lowest priority
+            G8RTOS_AddThread( &JoinGame, 1, 0xFFFFFFFF, LARGE_STACK, "JOIN_GAME_______" ); // below the deferred work thread only
+#ifdef WORKER_POOL
+            G8RTOS_InitWorkerPool( CLIENT_WORKERS, WORKER_PRIORITY, LARGE_STACK );
+#endif
             break;
         }
     }
@@ -85,3 +100,17 @@ void main(void)
 }
 
 #endif
+
+#ifdef BENCHMARK
+
+// =============================== BENCHMARK PROGRAM ============================
+void main(void)
+{
+    WDT_A->CTL = WDT_A_CTL_PW | WDT_A_CTL_HOLD;     // stop watchdog timer
+
+    G8RTOS_Init();
+    Benchmark_Init();
+    G8RTOS_Launch_Priority();
+}
+
+#endif
@@ -0,0 +1,246 @@
+/*
+ * PhysicsTest.c
+ *
+ * Host side checks of the swept ball physics (src/Physics.c). Each case
+ * puts one ball on a tricky trajectory, runs one Physics_Step and
+ * compares the exact fixed point result with the one worked out by hand
+ * in the case's comment. Lines the top left corner of a ball can't cross:
+ * x 41..275 (side walls), y 4 (client paddle) and 232 (host paddle).
+ * WIDTH_TOP_OR_BOTTOM is 34, so a ball touches a paddle while its center
+ * (x + 2) is within 34 pixels of the paddle's center.
+ *
+ * Build:   gcc -O2 -fcommon -DG8RTOS_HOST -Ihost -Irtos -Iinc -Idrivers \
+ *              -o PhysicsTest tools/PhysicsTest.c src/Physics.c
+ * Use:     PhysicsTest     (prints the failed checks, exits 1 if any)
+ */
+
+#include <stdio.h>
+#include "Physics.h"
+
+/*********************************************** Data Structures Used *****************************************************************/
+
+static ball_store_t Store;
+static int32_t Slot;
+static uint32_t Failures;
+
+/*********************************************** Data Structures Used *****************************************************************/
+
+
+/*********************************************** Private Functions ********************************************************************/
+
+/*
+ * Fixed point position of a pixel. Fractions in the cases are added in
+ * 1/PHYSICS_ONE units.
+ */
+#define PX(pixel)               PHYSICS_FROM_PIXEL(pixel)
+
+#define CHECK(name, got, want)  Check(name, #got, (int32_t)(got), (int32_t)(want))
+
+static void Check(const char *name, const char *what, int32_t got, int32_t want)
+{
+    if ( got != want )
+    {
+        printf("FAIL %s: %s is %d, expected %d\n", name, what, got, want);
+        Failures++;
+    }
+}
+
+/*
+ * Empties the store and puts one white ball in it
+ * Param "x", "y": top left corner in pixels
+ */
+static void SetBall(int16_t x, int16_t y, int16_t xvel, int16_t yvel)
+{
+    Physics_Init(&Store);
+    Slot = Physics_AddBall(&Store);
+    Store.x[Slot] = PHYSICS_FROM_PIXEL(x);
+    Store.y[Slot] = PHYSICS_FROM_PIXEL(y);
+    Store.xvel[Slot] = xvel;
+    Store.yvel[Slot] = yvel;
+}
+
+/*
+ * Checks where a ball that is still in play ended up
+ */
+static void CheckBall(const char *name, int32_t x, int32_t y, int16_t xvel, int16_t yvel)
+{
+    CHECK(name, (Store.alive[Slot >> 5] & BALL_BIT(Slot)) != 0, 1);
+    CHECK(name, Store.x[Slot], x);
+    CHECK(name, Store.y[Slot], y);
+    CHECK(name, Store.xvel[Slot], xvel);
+    CHECK(name, Store.yvel[Slot], yvel);
+}
+
+/*
+ * Checks that a ball died on a paddle line
+ */
+static void CheckExit(const char *name, uint32_t exits, int32_t x, int32_t y, uint8_t exited)
+{
+    CHECK(name, exits, 1);
+    CHECK(name, (Store.alive[Slot >> 5] & BALL_BIT(Slot)) != 0, 0);
+    CHECK(name, Store.exited[Slot], exited);
+    CHECK(name, Store.exits[0], Slot);
+    CHECK(name, Store.x[Slot], x);
+    CHECK(name, Store.y[Slot], y);
+}
+
+/*
+ * Right wall at 1/4 of the step, host paddle line at 1/2: two impacts.
+ * Wall at t=64: x=275 y=230, xvel -8. Paddle at t=128: x=273 y=232,
+ * center 275 is 25 from 250, a hit, and right of 250+16, the paddle's
+ * right quarter. The host bounce gives xvel -9 and yvel -8+1=-7 for the
+ * last 128.
+ */
+static void TestCorner(void)
+{
+    SetBall(273, 228, 8, 8);
+    Physics_Step(&Store, 250, 160);
+    CheckBall("corner right", PX(273) - 9 * 128, PX(232) - 7 * 128, -9, -7);
+}
+
+/*
+ * The same off the left wall onto the left quarter of a paddle at 72.
+ * Wall at t=64: x=41 y=230, xvel 8. Paddle at t=128: x=43 y=232, center
+ * 45 is 27 from 72 and left of 72-16, so xvel 9 and yvel -7.
+ */
+static void TestCornerLeft(void)
+{
+    SetBall(43, 228, -8, 8);
+    Physics_Step(&Store, 72, 160);
+    CheckBall("corner left", PX(43) + 9 * 128, PX(232) - 7 * 128, 9, -7);
+}
+
+/*
+ * Straight down or up onto a paddle at 160, reaching the line at t=128.
+ * Its quarters end at 144 and 176.
+ *  - ends: the ball's center is exactly WIDTH_TOP_OR_BOTTOM from the
+ *    paddle's (x=124 or x=192). It is pushed outward, 1 across, and
+ *    loses 1 of its speed down or up.
+ *  - middle: x=158 (center 160) only reverses
+ *  - quarter edges: center 144 (x=142) is still the middle half,
+ *    center 143 (x=141) is the left quarter
+ */
+static void TestPaddleHits(void)
+{
+    SetBall(124, 228, 0, 8);
+    Physics_Step(&Store, 160, 160);
+    CheckBall("host left end", PX(124) + 128, PX(232) - 7 * 128, 1, -7);
+
+    SetBall(158, 228, 0, 8);
+    Physics_Step(&Store, 160, 160);
+    CheckBall("host middle", PX(158), PX(232) - 8 * 128, 0, -8);
+
+    SetBall(192, 228, 0, 8);
+    Physics_Step(&Store, 160, 160);
+    CheckBall("host right end", PX(192) - 128, PX(232) - 7 * 128, -1, -7);
+
+    SetBall(142, 228, 0, 8);
+    Physics_Step(&Store, 160, 160);
+    CheckBall("host quarter edge in", PX(142), PX(232) - 8 * 128, 0, -8);
+
+    SetBall(141, 228, 0, 8);
+    Physics_Step(&Store, 160, 160);
+    CheckBall("host quarter edge out", PX(141) + 128, PX(232) - 7 * 128, 1, -7);
+
+    SetBall(124, 8, 0, -8);
+    Physics_Step(&Store, 160, 160);
+    CheckBall("client left end", PX(124) - 128, PX(4) + 7 * 128, -1, 7);
+
+    SetBall(158, 8, 0, -8);
+    Physics_Step(&Store, 160, 160);
+    CheckBall("client middle", PX(158), PX(4) + 8 * 128, 0, 8);
+
+    SetBall(192, 8, 0, -8);
+    Physics_Step(&Store, 160, 160);
+    CheckBall("client right end", PX(192) + 128, PX(4) + 7 * 128, 1, 7);
+}
+
+/*
+ * The same paths one pixel further out (center 35 away) miss, and the
+ * ball dies on the line at t=128
+ */
+static void TestNearMisses(void)
+{
+    SetBall(123, 228, 0, 8);
+    CheckExit("miss host left", Physics_Step(&Store, 160, 160), PX(123), PX(232), EXIT_BOTTOM);
+
+    SetBall(193, 228, 0, 8);
+    CheckExit("miss host right", Physics_Step(&Store, 160, 160), PX(193), PX(232), EXIT_BOTTOM);
+
+    SetBall(123, 8, 0, -8);
+    CheckExit("miss client left", Physics_Step(&Store, 160, 160), PX(123), PX(4), EXIT_TOP);
+
+    SetBall(193, 8, 0, -8);
+    CheckExit("miss client right", Physics_Step(&Store, 160, 160), PX(193), PX(4), EXIT_TOP);
+}
+
+/*
+ * A ball at MAX_BALL_SPEED across, and faster than that down after a
+ * few bounces, starts left of the paddle (MoveBall's test at x=118
+ * misses) and ends the step past its line. It reaches the line at
+ * t=32*256/40=204, at x=118+8*204/256: center 126.375, a hit on the
+ * left quarter, so xvel 9 and yvel -39 for the last 52.
+ */
+static void TestFastBall(void)
+{
+    SetBall(118, 200, MAX_BALL_SPEED, 40);
+    Physics_Step(&Store, 160, 160);
+    CheckBall("fast ball", PX(118) + 8 * 204 + 9 * 52, PX(200) + 40 * 204 - 39 * 52, 9, -39);
+}
+
+/*
+ * Balls that start on a line they are moving toward bounce at t=0
+ */
+static void TestStartOnLine(void)
+{
+    // host paddle line, over the paddle's middle: yvel -4 for the whole step
+    SetBall(158, 232, 0, 4);
+    Physics_Step(&Store, 160, 160);
+    CheckBall("on paddle line", PX(158), PX(228), 0, -4);
+
+    // right wall
+    SetBall(275, 100, 3, 1);
+    Physics_Step(&Store, 160, 160);
+    CheckBall("on wall", PX(272), PX(101), -3, 1);
+
+    // host paddle line, off the paddle: dies where it is
+    SetBall(60, 232, 0, 4);
+    CheckExit("on line off paddle", Physics_Step(&Store, 160, 160), PX(60), PX(232), EXIT_BOTTOM);
+}
+
+/*
+ * 1500 pixels a step hits a side wall 6 times. Walls at t=29, 68, 107
+ * and 146 use up PHYSICS_MAX_HITS, and the last 110 would go past the
+ * right wall, so the ball is clamped to it still moving right. Without
+ * the cap it would bounce twice more and end at x=228.9. y moves the
+ * whole step.
+ */
+static void TestHitCap(void)
+{
+    SetBall(100, 100, 1500, 1);
+    Physics_Step(&Store, 160, 160);
+    CheckBall("hit cap", PX(275), PX(101), 1500, 1);
+}
+
+/*********************************************** Private Functions ********************************************************************/
+
+
+int main(void)
+{
+    TestCorner();
+    TestCornerLeft();
+    TestPaddleHits();
+    TestNearMisses();
+    TestFastBall();
+    TestStartOnLine();
+    TestHitCap();
+
+    if ( Failures != 0 )
+    {
+        printf("%u checks failed\n", Failures);
+        return 1;
+    }
+
+    printf("all physics checks passed\n");
+    return 0;
+}
@@ -0,0 +1,349 @@
+/*
+ * TraceToChrome.c
+ *
+ * Host side decoder for the G8RTOS kernel trace. Reads a back channel
+ * UART log holding the output of G8RTOS_TraceDump and writes the last
+ * complete dump as Chrome trace JSON, which chrome://tracing and
+ * ui.perfetto.dev can open.
+ *
+ *  - each thread slot is one track. A slice is open while the thread runs.
+ *  - interrupts are slices on their own "Interrupts" track
+ *  - semaphore, sleep, add and kill events are instant events on the
+ *    track of the thread they happened on
+ *
+ * Build:   gcc -O2 -o TraceToChrome tools/TraceToChrome.c
+ * Use:     TraceToChrome < uart.log > trace.json
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*********************************************** Sizes and Limits *********************************************************************/
+#define MAX_RECORDS     65536   // more than any dump holds
+#define MAX_SLOTS       256     // thread slots are one byte
+#define NAME_LENGTH     16
+#define LINE_LENGTH     512
+#define ISR_TRACK       1000    // tid of the interrupt track
+/*********************************************** Sizes and Limits *********************************************************************/
+
+
+/*********************************************** Dump Format (G8RTOS_Trace.h) *********************************************************/
+enum
+{
+    TRACE_SWITCH        = 0,
+    TRACE_SEM_WAIT      = 1,
+    TRACE_SEM_SIGNAL    = 2,
+    TRACE_SLEEP         = 3,
+    TRACE_THREAD_ADD    = 4,
+    TRACE_THREAD_KILL   = 5,
+    TRACE_ISR_ENTER     = 6,
+    TRACE_ISR_EXIT      = 7
+};
+
+#define TRACE_THREAD_IDLE   0xFF
+#define TRACE_THREAD_NONE   0xFE
+/*********************************************** Dump Format (G8RTOS_Trace.h) *********************************************************/
+
+
+/*********************************************** Data Structures Used *****************************************************************/
+
+typedef struct
+{
+    uint32_t timestamp;
+    uint32_t thread;
+    uint32_t type;
+    uint32_t arg;
+} record_t;
+
+/*
+ * One dump, as read from the log
+ */
+typedef struct
+{
+    record_t records[MAX_RECORDS];
+    uint32_t count;
+    uint32_t cycles_per_us;
+    uint32_t lost;
+    char names[MAX_SLOTS][NAME_LENGTH + 1];
+} dump_t;
+
+static dump_t Reading;      // dump between TRACE_BEGIN and TRACE_END
+static dump_t Complete;     // last dump that reached TRACE_END
+static bool HaveComplete;
+
+/*********************************************** Data Structures Used *****************************************************************/
+
+
+/*********************************************** Private Functions ********************************************************************/
+
+/*
+ * Clears a dump before a new TRACE_BEGIN
+ */
+static void ResetDump(dump_t *dump)
+{
+    dump->count = 0;
+    dump->cycles_per_us = 48;
+    dump->lost = 0;
+    memset(dump->names, 0, sizeof(dump->names));
+}
+
+/*
+ * Reads the value of a { "variable" : { "name" : "<name>", "value" : N } } line
+ * Returns: true if the line is that variable
+ */
+static bool ReadVariable(const char *line, const char *name, uint32_t *value)
+{
+    char key[64];
+    snprintf(key, sizeof(key), "\"name\" : \"%s\"", name);
+
+    const char *found = strstr(line, key);
+    if ( found == 0 )
+        return false;
+
+    found = strstr(found, "\"value\" :");
+    if ( found == 0 )
+        return false;
+
+    *value = (uint32_t)strtoul(found + strlen("\"value\" :"), 0, 10);
+    return true;
+}
+
+/*
+ * Handles one line of the log
+ */
+static void ReadLine(const char *line)
+{
+    const char *found;
+    uint32_t value;
+
+    if ( strstr(line, "\"TRACE_BEGIN\"") )
+    {
+        ResetDump(&Reading);
+    }
+    else if ( strstr(line, "\"TRACE_END\"") )
+    {
+        Complete = Reading;
+        HaveComplete = true;
+    }
+    else if ( ReadVariable(line, "TRACE_CYCLES_PER_US", &value) )
+    {
+        if ( value != 0 )
+            Reading.cycles_per_us = value;
+    }
+    else if ( ReadVariable(line, "TRACE_LOST", &value) )
+    {
+        Reading.lost = value;
+    }
+    else if ( (found = strstr(line, "\"trace_thread\"")) != 0 )
+    {
+        unsigned id;
+        char name[NAME_LENGTH + 1];
+
+        if ( sscanf(found, "\"trace_thread\" : { \"id\" : %u, \"name\" : \"%16[^\"]\"", &id, name) == 2
+             && id < MAX_SLOTS )
+            strcpy(Reading.names[id], name);
+    }
+    else if ( (found = strstr(line, "\"trace\"")) != 0 )
+    {
+        record_t record;
+
+        if ( Reading.count < MAX_RECORDS
+             && sscanf(found, "\"trace\" : [ %u, %u, %u, %u ]",
+                       &record.timestamp, &record.thread, &record.type, &record.arg) == 4 )
+            Reading.records[Reading.count++] = record;
+    }
+}
+
+/*
+ * Name of an exception number. The vector table is the MSP432P401R's.
+ */
+static const char * IsrName(uint32_t exception)
+{
+    switch ( exception )
+    {
+        case 14: return "PendSV";
+        case 15: return "SysTick";
+        case 16 + 25: return "T32_INT1";
+        case 16 + 36: return "PORT2 (CC3100)";
+        case 16 + 38: return "PORT4 (buttons)";
+        case 16 + 39: return "PORT5 (buttons)";
+        case 16 + 40: return "PORT6";
+        default: return 0;
+    }
+}
+
+/*
+ * Prints the name of a thread slot into a track title
+ */
+static void SlotName(const dump_t *dump, uint32_t slot, char *out, size_t size)
+{
+    if ( slot == TRACE_THREAD_NONE )
+        snprintf(out, size, "before launch");
+    else if ( slot < MAX_SLOTS && dump->names[slot][0] != 0 )
+        snprintf(out, size, "%u %s", slot, dump->names[slot]);
+    else
+        snprintf(out, size, "%u", slot);
+}
+
+/*
+ * Starts the next event, with a comma after the previous one
+ */
+static void NextEvent(bool *first)
+{
+    printf(*first ? "\n  " : ",\n  ");
+    *first = false;
+}
+
+/*
+ * Writes a dump as Chrome trace JSON
+ */
+static void WriteChrome(const dump_t *dump)
+{
+    bool first = true;
+    bool used[MAX_SLOTS] = { false };
+    bool running[MAX_SLOTS] = { false };
+    uint64_t now = 0;
+    uint32_t last = dump->count ? dump->records[0].timestamp : 0;
+    double us = 0;
+
+    printf("{ \"displayTimeUnit\" : \"ns\", \"otherData\" : { \"lost_records\" : %u },", dump->lost);
+    printf("\n\"traceEvents\" : [");
+
+    NextEvent(&first);
+    printf("{ \"ph\" : \"M\", \"pid\" : 1, \"name\" : \"process_name\", \"args\" : { \"name\" : \"G8RTOS\" } }");
+    NextEvent(&first);
+    printf("{ \"ph\" : \"M\", \"pid\" : 1, \"tid\" : %d, \"name\" : \"thread_name\", \"args\" : { \"name\" : \"Interrupts\" } }", ISR_TRACK);
+
+    for (uint32_t i = 0; i < dump->count; i++)
+    {
+        const record_t *r = &dump->records[i];
+
+        // the cycle counter wraps every 2^32 cycles
+        now += (uint32_t)(r->timestamp - last);
+        last = r->timestamp;
+        us = (double)now / dump->cycles_per_us;
+
+        uint32_t tid = r->thread % MAX_SLOTS;
+        used[tid] = true;
+
+        switch ( r->type )
+        {
+            case TRACE_SWITCH:
+            {
+                uint32_t out = r->arg % MAX_SLOTS;
+                used[out] = true;
+                if ( running[out] )
+                {
+                    NextEvent(&first);
+                    printf("{ \"ph\" : \"E\", \"pid\" : 1, \"tid\" : %u, \"ts\" : %.3f }", out, us);
+                    running[out] = false;
+                }
+                NextEvent(&first);
+                printf("{ \"ph\" : \"B\", \"pid\" : 1, \"tid\" : %u, \"ts\" : %.3f, \"name\" : \"running\" }", tid, us);
+                running[tid] = true;
+                break;
+            }
+
+            case TRACE_ISR_ENTER:
+            case TRACE_ISR_EXIT:
+            {
+                const char *name = IsrName(r->arg);
+                NextEvent(&first);
+                printf("{ \"ph\" : \"%s\", \"pid\" : 1, \"tid\" : %d, \"ts\" : %.3f, ",
+                       r->type == TRACE_ISR_ENTER ? "B" : "E", ISR_TRACK, us);
+                if ( name )
+                    printf("\"name\" : \"%s\" }", name);
+                else
+                    printf("\"name\" : \"exception %u\" }", r->arg);
+                break;
+            }
+
+            case TRACE_SEM_WAIT:
+            case TRACE_SEM_SIGNAL:
+                NextEvent(&first);
+                printf("{ \"ph\" : \"i\", \"s\" : \"t\", \"pid\" : 1, \"tid\" : %u, \"ts\" : %.3f, "
+                       "\"name\" : \"%s\", \"args\" : { \"semaphore\" : \"0x%08X\" } }",
+                       tid, us, r->type == TRACE_SEM_WAIT ? "sem_wait" : "sem_signal", r->arg);
+                break;
+
+            case TRACE_SLEEP:
+                NextEvent(&first);
+                printf("{ \"ph\" : \"i\", \"s\" : \"t\", \"pid\" : 1, \"tid\" : %u, \"ts\" : %.3f, "
+                       "\"name\" : \"sleep\", \"args\" : { \"ms\" : %u } }", tid, us, r->arg);
+                break;
+
+            case TRACE_THREAD_ADD:
+            case TRACE_THREAD_KILL:
+            {
+                char name[64];
+                SlotName(dump, r->arg, name, sizeof(name));
+                NextEvent(&first);
+                printf("{ \"ph\" : \"i\", \"s\" : \"t\", \"pid\" : 1, \"tid\" : %u, \"ts\" : %.3f, "
+                       "\"name\" : \"%s\", \"args\" : { \"thread\" : \"%s\" } }",
+                       tid, us, r->type == TRACE_THREAD_ADD ? "thread_add" : "thread_kill", name);
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
+    // close whatever is still running at the end of the dump
+    for (uint32_t slot = 0; slot < MAX_SLOTS; slot++)
+    {
+        if ( running[slot] )
+        {
+            NextEvent(&first);
+            printf("{ \"ph\" : \"E\", \"pid\" : 1, \"tid\" : %u, \"ts\" : %.3f }", slot, us);
+        }
+    }
+
+    for (uint32_t slot = 0; slot < MAX_SLOTS; slot++)
+    {
+        if ( used[slot] )
+        {
+            char name[64];
+            SlotName(dump, slot, name, sizeof(name));
+            NextEvent(&first);
+            printf("{ \"ph\" : \"M\", \"pid\" : 1, \"tid\" : %u, \"name\" : \"thread_name\", \"args\" : { \"name\" : \"%s\" } }",
+                   slot, name);
+        }
+    }
+
+    printf("\n] }\n");
+}
+
+/*********************************************** Private Functions ********************************************************************/
+
+
+int main(void)
+{
+    char line[LINE_LENGTH];
+
+    ResetDump(&Reading);
+
+    while ( fgets(line, sizeof(line), stdin) )
+        ReadLine(line);
+
+    // a log cut off in the middle of a dump still shows what it has
+    if ( !HaveComplete )
+    {
+        if ( Reading.count == 0 )
+        {
+            fprintf(stderr, "no trace found, is G8RTOS_TRACE defined?\n");
+            return 1;
+        }
+        Complete = Reading;
+        fprintf(stderr, "no TRACE_END, using the incomplete dump\n");
+    }
+
+    if ( Complete.lost != 0 )
+        fprintf(stderr, "%u older records were overwritten before the dump\n", Complete.lost);
+
+    WriteChrome(&Complete);
+    return 0;
+}